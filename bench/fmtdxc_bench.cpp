@@ -0,0 +1,492 @@
+#include <fmtdxc/fmtdxc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#if !defined(NOMINMAX)
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <stdlib.h>
+#include <sys/resource.h>
+#endif
+
+// ---------- allocations ----------
+
+// replaced operators stay out of line, otherwise compilers see malloc and free inlined on one side
+// and operator new or delete on the other and report them as mismatched
+#if defined(_MSC_VER)
+#define BENCH_NOINLINE __declspec(noinline)
+#else
+#define BENCH_NOINLINE __attribute__((noinline))
+#endif
+
+static std::atomic<std::uint64_t> allocation_count { 0 };
+static std::atomic<std::uint64_t> allocation_bytes { 0 };
+
+BENCH_NOINLINE void* operator new(std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* _ptr = std::malloc(size ? size : 1))
+        return _ptr;
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+// std::pmr::new_delete_resource allocates with an alignment
+BENCH_NOINLINE void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::size_t _alignment = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+#if defined(_WIN32)
+    if (void* _ptr = _aligned_malloc(size ? size : 1, _alignment))
+        return _ptr;
+#else
+    void* _ptr = nullptr;
+    if (posix_memalign(&_ptr, _alignment, size ? size : 1) == 0)
+        return _ptr;
+#endif
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::align_val_t) noexcept
+{
+#if defined(_WIN32)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept
+{
+    operator delete(ptr, alignment);
+}
+
+static std::uint64_t peak_rss()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS _counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &_counters, sizeof(_counters)))
+        return _counters.PeakWorkingSetSize;
+    return 0;
+#else
+    struct rusage _usage;
+    if (getrusage(RUSAGE_SELF, &_usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return static_cast<std::uint64_t>(_usage.ru_maxrss);
+#else
+    return static_cast<std::uint64_t>(_usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// ---------- generator ----------
+
+struct bench_config {
+    std::uint32_t seed = 1;
+    std::size_t audio_sequencers = 8;
+    std::size_t midi_sequencers = 16;
+    std::size_t clips = 8; // per sequencer
+    std::size_t notes = 128; // per midi clip
+    std::size_t mixer_tracks = 24;
+    std::size_t routings = 2; // per mixer track
+    std::size_t commits = 32; // per edit script
+    std::size_t repetitions = 5; // of each export and import
+};
+
+static constexpr std::uint64_t clip_ticks = 4 * 4 * 960;
+
+static std::uint32_t pick(std::mt19937& rng, const std::size_t count)
+{
+    return static_cast<std::uint32_t>(rng() % count);
+}
+
+static fmtdxc::project generate_project(const bench_config& config)
+{
+    std::mt19937 _rng(config.seed);
+    fmtdxc::project _project;
+    _project.name = "bench";
+    _project.ppq = 960;
+    _project.master_track_id = 0;
+    const std::size_t _tracks = std::max<std::size_t>(config.mixer_tracks, 1);
+    for (std::uint32_t _track_id = 0; _track_id < _tracks; ++_track_id) {
+        fmtdxc::project::mixer_track& _track = _project.mixer_tracks[_track_id];
+        _track.name = _track_id ? "track " + std::to_string(_track_id) : "master";
+        _track.db = -static_cast<double>(pick(_rng, 120)) / 10.0;
+        _track.pan = (static_cast<double>(pick(_rng, 201)) - 100.0) / 100.0;
+        _track.effects[0].name = "eq";
+        for (std::uint32_t _routing_id = 0; _track_id && _routing_id < config.routings; ++_routing_id) {
+            fmtdxc::project::mixer_routing& _routing = _track.routings[_routing_id];
+            _routing.db = _routing_id ? -12.0 : 0.0;
+            _routing.output = _routing_id ? static_cast<std::uint32_t>(1 + (_track_id + _routing_id) % (_tracks - 1)) : 0;
+        }
+        fmtdxc::touch(_track);
+    }
+    for (std::uint32_t _sequencer_id = 0; _sequencer_id < config.audio_sequencers; ++_sequencer_id) {
+        fmtdxc::project::audio_sequencer& _sequencer = _project.audio_sequencers[_sequencer_id];
+        _sequencer.name = "audio " + std::to_string(_sequencer_id);
+        _sequencer.output = static_cast<std::uint32_t>(_tracks > 1 ? 1 + _sequencer_id % (_tracks - 1) : 0);
+        for (std::uint32_t _clip_id = 0; _clip_id < config.clips; ++_clip_id) {
+            fmtdxc::project::audio_clip& _clip = _sequencer.clips[_clip_id];
+            _clip.name = "take " + std::to_string(_clip_id);
+            _clip.start_tick = _clip_id * clip_ticks + pick(_rng, 960);
+            _clip.length_ticks = clip_ticks - 960;
+            _clip.file = "audio/take_" + std::to_string(pick(_rng, 64)) + ".wav";
+            _clip.file_start_frame = pick(_rng, 48000);
+            _clip.db = -static_cast<double>(pick(_rng, 60)) / 10.0;
+            _clip.is_loop = pick(_rng, 4) == 0;
+            fmtdxc::touch(_clip);
+        }
+        fmtdxc::touch(_sequencer);
+    }
+    for (std::uint32_t _sequencer_id = 0; _sequencer_id < config.midi_sequencers; ++_sequencer_id) {
+        fmtdxc::project::midi_sequencer& _sequencer = _project.midi_sequencers[_sequencer_id];
+        _sequencer.name = "midi " + std::to_string(_sequencer_id);
+        _sequencer.instrument.name = "synth " + std::to_string(pick(_rng, 8));
+        _sequencer.output = static_cast<std::uint32_t>(_tracks > 1 ? 1 + (config.audio_sequencers + _sequencer_id) % (_tracks - 1) : 0);
+        const std::uint16_t _root = static_cast<std::uint16_t>(36 + pick(_rng, 48));
+        for (std::uint32_t _clip_id = 0; _clip_id < config.clips; ++_clip_id) {
+            fmtdxc::project::midi_clip& _clip = _sequencer.clips[_clip_id];
+            _clip.name = "pattern " + std::to_string(_clip_id);
+            _clip.start_tick = _clip_id * clip_ticks;
+            _clip.length_ticks = clip_ticks;
+            const std::uint64_t _step = std::max<std::uint64_t>(clip_ticks / std::max<std::size_t>(config.notes, 1), 1);
+            for (std::uint32_t _note_id = 0; _note_id < config.notes; ++_note_id) {
+                static constexpr std::uint16_t _scale[7] = { 0, 2, 4, 5, 7, 9, 11 };
+                fmtdxc::project::midi_note& _note = _clip.notes[_note_id];
+                _note.start_tick = _note_id * _step;
+                _note.length_ticks = _step * (1 + pick(_rng, 4));
+                _note.pitch = static_cast<std::uint16_t>(_root + 12 * pick(_rng, 2) + _scale[pick(_rng, 7)]);
+                _note.velocity = static_cast<float>(40 + pick(_rng, 88)) / 127.0f;
+                _note.mpe.channel = 1 + pick(_rng, 15);
+                fmtdxc::touch(_note);
+            }
+            fmtdxc::touch(_clip);
+        }
+        fmtdxc::touch(_sequencer);
+    }
+    fmtdxc::touch(_project);
+    return _project;
+}
+
+// ---------- edit scripts ----------
+
+using edit_script = std::function<void(fmtdxc::project&, std::mt19937&)>;
+
+template <typename map_t>
+static typename map_t::iterator pick_entry(map_t& map, std::mt19937& rng)
+{
+    return std::next(map.begin(), pick(rng, map.size()));
+}
+
+static void edit_small(fmtdxc::project& project, std::mt19937& rng)
+{
+    if (project.midi_sequencers.empty())
+        return;
+    fmtdxc::project::midi_sequencer& _sequencer = pick_entry(project.midi_sequencers, rng)->second;
+    if (_sequencer.clips.empty())
+        return;
+    fmtdxc::project::midi_clip& _clip = pick_entry(_sequencer.clips, rng)->second;
+    for (std::uint32_t _index = 1 + pick(rng, 4); _index && !_clip.notes.empty(); --_index) {
+        fmtdxc::project::midi_note& _note = pick_entry(_clip.notes, rng)->second;
+        _note.pitch = static_cast<std::uint16_t>(std::min<std::uint32_t>(_note.pitch + 1, 127));
+        _note.velocity = static_cast<float>(40 + pick(rng, 88)) / 127.0f;
+        fmtdxc::touch(_note);
+    }
+    fmtdxc::touch(_clip);
+    fmtdxc::touch(_sequencer);
+    fmtdxc::touch(project);
+}
+
+static void edit_medium(fmtdxc::project& project, std::mt19937& rng)
+{
+    if (!project.midi_sequencers.empty()) {
+        fmtdxc::project::midi_sequencer& _sequencer = pick_entry(project.midi_sequencers, rng)->second;
+        for (auto& [_clip_id, _clip] : _sequencer.clips) {
+            if (pick(rng, 4) != 0)
+                continue;
+            for (auto& [_note_id, _note] : _clip.notes) {
+                if (pick(rng, 4) == 0) {
+                    _note.start_tick = _note.start_tick + 120;
+                    _note.length_ticks = _note.length_ticks + 60;
+                    fmtdxc::touch(_note);
+                }
+            }
+            const std::uint32_t _next_id = _clip.notes.empty() ? 0 : std::prev(_clip.notes.end())->first + 1;
+            for (std::uint32_t _index = 0; _index < 8; ++_index) {
+                fmtdxc::project::midi_note& _note = _clip.notes[_next_id + _index];
+                _note.start_tick = pick(rng, static_cast<std::size_t>(clip_ticks));
+                _note.length_ticks = 240;
+                _note.pitch = static_cast<std::uint16_t>(48 + pick(rng, 24));
+                _note.velocity = 0.75f;
+                _note.mpe.channel = 1;
+                fmtdxc::touch(_note);
+            }
+            _clip.start_tick = _clip.start_tick + 960;
+            fmtdxc::touch(_clip);
+        }
+        fmtdxc::touch(_sequencer);
+    }
+    if (!project.mixer_tracks.empty()) {
+        fmtdxc::project::mixer_track& _track = pick_entry(project.mixer_tracks, rng)->second;
+        _track.db = -static_cast<double>(pick(rng, 120)) / 10.0;
+        fmtdxc::touch(_track);
+    }
+    fmtdxc::touch(project);
+}
+
+static void edit_wide(fmtdxc::project& project, std::mt19937& rng)
+{
+    for (auto& [_sequencer_id, _sequencer] : project.midi_sequencers) {
+        for (auto& [_clip_id, _clip] : _sequencer.clips) {
+            for (auto& [_note_id, _note] : _clip.notes) {
+                if (pick(rng, 8) == 0) {
+                    _note.velocity = static_cast<float>(40 + pick(rng, 88)) / 127.0f;
+                    fmtdxc::touch(_note);
+                }
+            }
+            _clip.start_tick = _clip.start_tick + 1;
+            fmtdxc::touch(_clip);
+        }
+        fmtdxc::touch(_sequencer);
+    }
+    for (auto& [_sequencer_id, _sequencer] : project.audio_sequencers) {
+        for (auto& [_clip_id, _clip] : _sequencer.clips) {
+            _clip.db = -static_cast<double>(pick(rng, 60)) / 10.0;
+            fmtdxc::touch(_clip);
+        }
+        fmtdxc::touch(_sequencer);
+    }
+    for (auto& [_track_id, _track] : project.mixer_tracks) {
+        _track.pan = (static_cast<double>(pick(rng, 201)) - 100.0) / 100.0;
+        fmtdxc::touch(_track);
+    }
+    fmtdxc::touch(project);
+}
+
+// ---------- measurements ----------
+
+struct bench_result {
+    std::string script;
+    std::string operation;
+    std::vector<double> samples; // nanoseconds
+    std::uint64_t allocations = 0;
+    std::uint64_t allocated_bytes = 0;
+    std::uint64_t processed_bytes = 0;
+    std::uint64_t peak_rss = 0;
+};
+
+template <typename function_t>
+static void measure(bench_result& result, function_t&& function)
+{
+    const std::uint64_t _count = allocation_count.load(std::memory_order_relaxed);
+    const std::uint64_t _bytes = allocation_bytes.load(std::memory_order_relaxed);
+    const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+    function();
+    const std::chrono::steady_clock::time_point _stop = std::chrono::steady_clock::now();
+    result.samples.push_back(std::chrono::duration<double, std::nano>(_stop - _start).count());
+    result.allocations += allocation_count.load(std::memory_order_relaxed) - _count;
+    result.allocated_bytes += allocation_bytes.load(std::memory_order_relaxed) - _bytes;
+    result.peak_rss = peak_rss();
+}
+
+static double percentile(const std::vector<double>& sorted, const double rank)
+{
+    if (sorted.empty())
+        return 0.0;
+    const std::size_t _index = static_cast<std::size_t>(rank * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(_index, sorted.size() - 1)];
+}
+
+static const char* version_name(const fmtdxc::version ver)
+{
+    switch (ver) {
+    case fmtdxc::version::alpha:
+        return "alpha";
+    case fmtdxc::version::alpha_indexed:
+        return "alpha_indexed";
+    case fmtdxc::version::alpha_columnar:
+        return "alpha_columnar";
+    case fmtdxc::version::alpha_interned:
+        return "alpha_interned";
+    }
+    return "unknown";
+}
+
+static void run_script(const bench_config& config, const std::string& name, const edit_script& script, std::vector<bench_result>& results)
+{
+    fmtdxc::project _current = generate_project(config);
+    std::mt19937 _rng(config.seed ^ static_cast<std::uint32_t>(std::hash<std::string>()(name)));
+    fmtdxc::project_container _container(_current);
+    bench_result _diff { name, "diff", {} };
+    bench_result _apply { name, "apply", {} };
+    bench_result _commit { name, "commit", {} };
+    for (std::size_t _index = 0; _index < config.commits; ++_index) {
+        fmtdxc::project _next = _current;
+        script(_next, _rng);
+        fmtdxc::sparse_project _forward;
+        fmtdxc::sparse_project _backward;
+        measure(_diff, [&]() { fmtdxc::diff(_current, _next, _forward, _backward); });
+        measure(_commit, [&]() { _container.commit("edit " + std::to_string(_index), _next); });
+        measure(_apply, [&]() { fmtdxc::apply(_current, std::move(_forward)); });
+        _current = std::move(_next);
+    }
+    bench_result _undo { name, "undo", {} };
+    while (_container.can_undo())
+        measure(_undo, [&]() { _container.undo(); });
+    bench_result _redo { name, "redo", {} };
+    while (_container.can_redo())
+        measure(_redo, [&]() { _container.redo(); });
+    results.push_back(std::move(_diff));
+    results.push_back(std::move(_apply));
+    results.push_back(std::move(_commit));
+    results.push_back(std::move(_undo));
+    results.push_back(std::move(_redo));
+    for (const fmtdxc::version _version : { fmtdxc::version::alpha, fmtdxc::version::alpha_indexed, fmtdxc::version::alpha_columnar, fmtdxc::version::alpha_interned }) {
+        bench_result _export { name, std::string("export_") + version_name(_version), {} };
+        bench_result _import { name, std::string("import_") + version_name(_version), {} };
+        for (std::size_t _repetition = 0; _repetition < config.repetitions; ++_repetition) {
+            std::stringstream _stream;
+            measure(_export, [&]() { fmtdxc::export_container(_stream, _container, _version); });
+            const std::string _bytes = _stream.str();
+            _export.processed_bytes += _bytes.size();
+            fmtdxc::project_container _imported;
+            fmtdxc::version _imported_version;
+            std::istringstream _input(_bytes);
+            measure(_import, [&]() { fmtdxc::import_container(_input, _imported, _imported_version); });
+            _import.processed_bytes += _bytes.size();
+        }
+        results.push_back(std::move(_export));
+        results.push_back(std::move(_import));
+    }
+}
+
+static void write_json(std::ostream& stream, const bench_config& config, std::vector<bench_result>& results)
+{
+    stream << "{\n";
+    stream << "  \"config\": {\"seed\": " << config.seed
+           << ", \"audio_sequencers\": " << config.audio_sequencers
+           << ", \"midi_sequencers\": " << config.midi_sequencers
+           << ", \"clips\": " << config.clips
+           << ", \"notes\": " << config.notes
+           << ", \"mixer_tracks\": " << config.mixer_tracks
+           << ", \"routings\": " << config.routings
+           << ", \"commits\": " << config.commits
+           << ", \"repetitions\": " << config.repetitions << "},\n";
+    stream << "  \"results\": [";
+    for (std::size_t _index = 0; _index < results.size(); ++_index) {
+        bench_result& _result = results[_index];
+        std::sort(_result.samples.begin(), _result.samples.end());
+        double _total = 0.0;
+        for (const double _sample : _result.samples)
+            _total += _sample;
+        const double _count = static_cast<double>(std::max<std::size_t>(_result.samples.size(), 1));
+        const double _seconds = _total / 1e9;
+        stream << (_index ? ",\n" : "\n");
+        stream << "    {\"script\": \"" << _result.script << "\""
+               << ", \"operation\": \"" << _result.operation << "\""
+               << ", \"samples\": " << _result.samples.size()
+               << ", \"total_ms\": " << _total / 1e6
+               << ", \"ops_per_second\": " << (_seconds > 0.0 ? static_cast<double>(_result.samples.size()) / _seconds : 0.0);
+        if (_result.processed_bytes)
+            stream << ", \"bytes_per_op\": " << static_cast<double>(_result.processed_bytes) / _count
+                   << ", \"bytes_per_second\": " << (_seconds > 0.0 ? static_cast<double>(_result.processed_bytes) / _seconds : 0.0);
+        stream << ", \"p50_us\": " << percentile(_result.samples, 0.50) / 1e3
+               << ", \"p90_us\": " << percentile(_result.samples, 0.90) / 1e3
+               << ", \"p99_us\": " << percentile(_result.samples, 0.99) / 1e3
+               << ", \"max_us\": " << (_result.samples.empty() ? 0.0 : _result.samples.back() / 1e3)
+               << ", \"allocations_per_op\": " << static_cast<double>(_result.allocations) / _count
+               << ", \"allocated_bytes_per_op\": " << static_cast<double>(_result.allocated_bytes) / _count
+               << ", \"peak_rss_bytes\": " << _result.peak_rss << "}";
+    }
+    stream << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    bench_config _config;
+    std::string _output;
+    for (int _index = 1; _index < argc; ++_index) {
+        const std::string _arg(argv[_index]);
+        if (_index + 1 >= argc) {
+            std::cerr << "Usage: fmtdxc_bench [--seed N] [--audio-sequencers N] [--midi-sequencers N] [--clips N] [--notes N] [--mixer-tracks N] [--routings N] [--commits N] [--repetitions N] [--output file.json]\n";
+            return 1;
+        }
+        const std::string _value(argv[++_index]);
+        if (_arg == "--output") {
+            _output = _value;
+            continue;
+        }
+        char* _end = nullptr;
+        const unsigned long _number = std::strtoul(_value.c_str(), &_end, 10);
+        if (_value.empty() || *_end != '\0') {
+            std::cerr << "Error: Expected a number after " << _arg << "\n";
+            return 2;
+        }
+        if (_arg == "--seed")
+            _config.seed = static_cast<std::uint32_t>(_number);
+        else if (_arg == "--audio-sequencers")
+            _config.audio_sequencers = _number;
+        else if (_arg == "--midi-sequencers")
+            _config.midi_sequencers = _number;
+        else if (_arg == "--clips")
+            _config.clips = _number;
+        else if (_arg == "--notes")
+            _config.notes = _number;
+        else if (_arg == "--mixer-tracks")
+            _config.mixer_tracks = _number;
+        else if (_arg == "--routings")
+            _config.routings = _number;
+        else if (_arg == "--commits")
+            _config.commits = _number;
+        else if (_arg == "--repetitions")
+            _config.repetitions = _number;
+        else {
+            std::cerr << "Error: Unknown option " << _arg << "\n";
+            return 2;
+        }
+    }
+
+    std::vector<bench_result> _results;
+    run_script(_config, "small", edit_small, _results);
+    run_script(_config, "medium", edit_medium, _results);
+    run_script(_config, "wide", edit_wide, _results);
+
+    if (_output.empty()) {
+        write_json(std::cout, _config, _results);
+        return 0;
+    }
+    std::ofstream _output_stream(_output);
+    if (!_output_stream) {
+        std::cerr << "Error: Cannot open " << _output << "\n";
+        return 3;
+    }
+    write_json(_output_stream, _config, _results);
+    return 0;
+}
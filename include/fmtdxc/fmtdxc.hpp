@@ -1,19 +1,399 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <filesystem>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <variant>
+#include <vector>
+
+#if defined(FMTDXC_PMR)
+#include <memory_resource>
+#endif
 
 namespace fmtdxc {
 
 /// @brief Represents dawxchange version with an enum that will not collide with versions from other DAWs.
 /// dawxchange id is defined as 99. Currently in alpha
 enum struct version : unsigned int {
-    alpha = 90000
+    /// @brief Single binary archive that is decoded all at once
+    alpha = 90000,
+    /// @brief Records behind a commit index so that commits are decoded on demand
+    alpha_indexed = 90001,
+    /// @brief Same records as alpha_indexed with notes written as columns of varints and
+    /// sparse records written with a presence bitmap, several times smaller for note heavy projects
+    alpha_columnar = 90002,
+    /// @brief Same records as alpha_columnar with names and paths written once per container in a string table
+    /// that records refer to by index, smaller for projects that repeat clip names and file references
+    alpha_interned = 90003
+};
+
+#if defined(FMTDXC_PMR)
+
+/// @brief Returns the memory resource that the id maps constructed by the calling thread allocate from,
+/// which is the default resource of std::pmr unless a resource_scope is alive
+[[nodiscard]] std::shared_ptr<std::pmr::memory_resource> get_current_resource();
+
+/// @brief Makes the id maps constructed by the calling thread allocate from a memory resource until it is destroyed.
+/// Maps share ownership of their resource, so that an arena is released when the last map allocated from it is destroyed
+struct resource_scope {
+    resource_scope(std::shared_ptr<std::pmr::memory_resource> resource);
+    resource_scope(const resource_scope& other) = delete;
+    resource_scope& operator=(const resource_scope& other) = delete;
+    ~resource_scope();
+
+private:
+    std::shared_ptr<std::pmr::memory_resource> _previous;
+};
+
+/// @brief Allocator of id maps bound to the memory resource that was current when it was constructed.
+/// Copied maps allocate from the current resource, moved maps keep the resource they were allocated from
+/// @tparam T type of the allocated values
+template <typename T>
+struct resource_allocator {
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::false_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    resource_allocator()
+        : _resource(get_current_resource())
+    {
+    }
+
+    resource_allocator(const resource_allocator& other) noexcept = default;
+
+    template <typename U>
+    resource_allocator(const resource_allocator<U>& other) noexcept
+        : _resource(other.get_resource())
+    {
+    }
+
+    resource_allocator& operator=(const resource_allocator& other) noexcept = default;
+
+    [[nodiscard]] T* allocate(const std::size_t count) { return static_cast<T*>(_resource->allocate(count * sizeof(T), alignof(T))); }
+    void deallocate(T* pointer, const std::size_t count) noexcept { _resource->deallocate(pointer, count * sizeof(T), alignof(T)); }
+    [[nodiscard]] resource_allocator select_on_container_copy_construction() const { return {}; }
+    [[nodiscard]] const std::shared_ptr<std::pmr::memory_resource>& get_resource() const noexcept { return _resource; }
+
+    template <typename U>
+    [[nodiscard]] bool operator==(const resource_allocator<U>& other) const noexcept { return _resource == other.get_resource() || _resource->is_equal(*other.get_resource()); }
+
+    template <typename U>
+    [[nodiscard]] bool operator!=(const resource_allocator<U>& other) const noexcept { return !(*this == other); }
+
+private:
+    std::shared_ptr<std::pmr::memory_resource> _resource;
+};
+
+template <typename T>
+using id_map_allocator = resource_allocator<T>;
+
+#else
+
+template <typename T>
+using id_map_allocator = std::allocator<T>;
+
+#endif
+
+/// @brief Sorted flat vector of entities with the subset of the std::map interface used by dawxchange projects.
+/// Entities are stored contiguously in id order so that iterating is a linear scan.
+/// Insertions in the middle and erasures invalidate iterators and references
+/// @tparam T type of the entities
+template <typename T>
+struct flat_id_map {
+    using key_type = std::uint32_t;
+    using mapped_type = T;
+    using value_type = std::pair<std::uint32_t, T>;
+    using size_type = std::size_t;
+    using allocator_type = id_map_allocator<value_type>;
+    using iterator = typename std::vector<value_type, allocator_type>::iterator;
+    using const_iterator = typename std::vector<value_type, allocator_type>::const_iterator;
+
+    [[nodiscard]] iterator begin() noexcept { return _data.begin(); }
+    [[nodiscard]] iterator end() noexcept { return _data.end(); }
+    [[nodiscard]] const_iterator begin() const noexcept { return _data.begin(); }
+    [[nodiscard]] const_iterator end() const noexcept { return _data.end(); }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return _data.cbegin(); }
+    [[nodiscard]] const_iterator cend() const noexcept { return _data.cend(); }
+    [[nodiscard]] bool empty() const noexcept { return _data.empty(); }
+    [[nodiscard]] size_type size() const noexcept { return _data.size(); }
+    void reserve(const size_type count) { _data.reserve(count); }
+    void clear() noexcept { _data.clear(); }
+    [[nodiscard]] allocator_type get_allocator() const noexcept { return _data.get_allocator(); }
+
+    [[nodiscard]] iterator lower_bound(const key_type key)
+    {
+        return std::lower_bound(_data.begin(), _data.end(), key, [](const value_type& entry, const key_type k) { return entry.first < k; });
+    }
+
+    [[nodiscard]] const_iterator lower_bound(const key_type key) const
+    {
+        return std::lower_bound(_data.begin(), _data.end(), key, [](const value_type& entry, const key_type k) { return entry.first < k; });
+    }
+
+    [[nodiscard]] iterator upper_bound(const key_type key)
+    {
+        return std::upper_bound(_data.begin(), _data.end(), key, [](const key_type k, const value_type& entry) { return k < entry.first; });
+    }
+
+    [[nodiscard]] const_iterator upper_bound(const key_type key) const
+    {
+        return std::upper_bound(_data.begin(), _data.end(), key, [](const key_type k, const value_type& entry) { return k < entry.first; });
+    }
+
+    [[nodiscard]] iterator find(const key_type key)
+    {
+        auto _it = lower_bound(key);
+        return _it != _data.end() && _it->first == key ? _it : _data.end();
+    }
+
+    [[nodiscard]] const_iterator find(const key_type key) const
+    {
+        auto _it = lower_bound(key);
+        return _it != _data.end() && _it->first == key ? _it : _data.end();
+    }
+
+    [[nodiscard]] size_type count(const key_type key) const { return find(key) != end() ? 1 : 0; }
+
+    [[nodiscard]] T& at(const key_type key)
+    {
+        auto _it = find(key);
+        if (_it == _data.end())
+            throw std::out_of_range("fmtdxc::flat_id_map::at");
+        return _it->second;
+    }
+
+    [[nodiscard]] const T& at(const key_type key) const
+    {
+        auto _it = find(key);
+        if (_it == _data.end())
+            throw std::out_of_range("fmtdxc::flat_id_map::at");
+        return _it->second;
+    }
+
+    T& operator[](const key_type key)
+    {
+        return emplace(key).first->second;
+    }
+
+    template <typename... args_t>
+    std::pair<iterator, bool> emplace(const key_type key, args_t&&... args)
+    {
+        auto _it = lower_bound(key);
+        if (_it != _data.end() && _it->first == key)
+            return { _it, false };
+        _it = _data.emplace(_it, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<args_t>(args)...));
+        return { _it, true };
+    }
+
+    /// @brief Appends in constant time when hint is end() and key is greater than all others
+    template <typename... args_t>
+    iterator emplace_hint(const_iterator hint, const key_type key, args_t&&... args)
+    {
+        if (hint == _data.cend() && (_data.empty() || _data.back().first < key)) {
+            _data.emplace_back(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<args_t>(args)...));
+            return std::prev(_data.end());
+        }
+        return emplace(key, std::forward<args_t>(args)...).first;
+    }
+
+    iterator erase(const_iterator position) { return _data.erase(position); }
+
+    size_type erase(const key_type key)
+    {
+        auto _it = find(key);
+        if (_it == _data.end())
+            return 0;
+        _data.erase(_it);
+        return 1;
+    }
+
+    [[nodiscard]] bool operator==(const flat_id_map& other) const { return _data == other._data; }
+    [[nodiscard]] bool operator!=(const flat_id_map& other) const { return _data != other._data; }
+
+private:
+    std::vector<value_type, allocator_type> _data;
+};
+
+/// @brief Sorted flat vector of entities that copies share until one of them is mutated, so that copying a project
+/// takes constant time and mutating an entity only copies the maps on the path from the project to it.
+/// Non const member functions copy the entities first when they are shared with another map, references and
+/// iterators returned by them must not be written through once the map was copied
+/// @tparam T type of the entities
+template <typename T>
+struct cow_id_map {
+    using storage_type = flat_id_map<T>;
+    using key_type = std::uint32_t;
+    using mapped_type = T;
+    using value_type = typename storage_type::value_type;
+    using size_type = std::size_t;
+    using allocator_type = typename storage_type::allocator_type;
+    using iterator = typename storage_type::iterator;
+    using const_iterator = typename storage_type::const_iterator;
+
+    [[nodiscard]] iterator begin() { return _mutable().begin(); }
+    [[nodiscard]] iterator end() { return _mutable().end(); }
+    [[nodiscard]] const_iterator begin() const noexcept { return _get().begin(); }
+    [[nodiscard]] const_iterator end() const noexcept { return _get().end(); }
+    [[nodiscard]] const_iterator cbegin() const noexcept { return _get().cbegin(); }
+    [[nodiscard]] const_iterator cend() const noexcept { return _get().cend(); }
+    [[nodiscard]] bool empty() const noexcept { return _get().empty(); }
+    [[nodiscard]] size_type size() const noexcept { return _get().size(); }
+    void reserve(const size_type count) { _mutable().reserve(count); }
+    void clear() noexcept { _data.reset(); }
+    [[nodiscard]] allocator_type get_allocator() const { return _data ? _data->get_allocator() : allocator_type(); }
+
+    /// @brief Returns whether both maps hold the same entities because one was copied from the other and neither was mutated since
+    [[nodiscard]] bool shares(const cow_id_map& other) const noexcept { return _data == other._data; }
+
+    [[nodiscard]] iterator lower_bound(const key_type key) { return _mutable().lower_bound(key); }
+    [[nodiscard]] const_iterator lower_bound(const key_type key) const { return _get().lower_bound(key); }
+    [[nodiscard]] iterator upper_bound(const key_type key) { return _mutable().upper_bound(key); }
+    [[nodiscard]] const_iterator upper_bound(const key_type key) const { return _get().upper_bound(key); }
+    [[nodiscard]] iterator find(const key_type key) { return _mutable().find(key); }
+    [[nodiscard]] const_iterator find(const key_type key) const { return _get().find(key); }
+    [[nodiscard]] size_type count(const key_type key) const { return _get().count(key); }
+    [[nodiscard]] T& at(const key_type key) { return _mutable().at(key); }
+    [[nodiscard]] const T& at(const key_type key) const { return _get().at(key); }
+    T& operator[](const key_type key) { return _mutable()[key]; }
+
+    template <typename... args_t>
+    std::pair<iterator, bool> emplace(const key_type key, args_t&&... args)
+    {
+        return _mutable().emplace(key, std::forward<args_t>(args)...);
+    }
+
+    /// @brief Appends in constant time when hint is end() and key is greater than all others
+    template <typename... args_t>
+    iterator emplace_hint(const_iterator hint, const key_type key, args_t&&... args)
+    {
+        // the hint may point to entities that are copied first, only whether it is the end is kept
+        const bool _at_end = hint == _get().cend();
+        storage_type& _storage = _mutable();
+        return _storage.emplace_hint(_at_end ? _storage.cend() : _storage.cbegin(), key, std::forward<args_t>(args)...);
+    }
+
+    iterator erase(const_iterator position)
+    {
+        const key_type _key = position->first;
+        storage_type& _storage = _mutable();
+        return _storage.erase(_storage.find(_key));
+    }
+
+    size_type erase(const key_type key) { return _mutable().erase(key); }
+
+    [[nodiscard]] bool operator==(const cow_id_map& other) const { return shares(other) || _get() == other._get(); }
+    [[nodiscard]] bool operator!=(const cow_id_map& other) const { return !(*this == other); }
+
+private:
+    std::shared_ptr<storage_type> _data; // null while empty
+
+    [[nodiscard]] const storage_type& _get() const noexcept { return _data ? *_data : get_empty(); }
+
+    storage_type& _mutable()
+    {
+        if (!_data)
+            _data = std::make_shared<storage_type>();
+        else if (_data.use_count() > 1)
+            _data = std::make_shared<storage_type>(*_data);
+        return *_data;
+    }
+
+    static const storage_type& get_empty()
+    {
+        static const storage_type _empty = []() {
+#if defined(FMTDXC_PMR)
+            // must not keep the resource of the first calling thread alive
+            resource_scope _scope(nullptr);
+#endif
+            return storage_type();
+        }();
+        return _empty;
+    }
+};
+
+/// @brief SHA-256 digest identifying the content of a blob stored in a project container
+struct blob_digest {
+    std::array<std::uint8_t, 32> bytes {};
+
+    bool operator==(const blob_digest& other) const { return bytes == other.bytes; }
+    bool operator!=(const blob_digest& other) const { return bytes != other.bytes; }
+    bool operator<(const blob_digest& other) const { return bytes < other.bytes; }
+};
+
+/// @brief Returns the pooled copy of a string, equal strings return the same copy.
+/// Pooled values are never released and can be interned from several threads
+/// @param value String to intern
+[[nodiscard]] const std::string& intern(const std::string& value);
+
+/// @brief Returns the pooled copy of a path, paths that compare equal return the same copy
+/// @param value Path to intern
+[[nodiscard]] const std::filesystem::path& intern(const std::filesystem::path& value);
+
+/// @brief Handle to a value pooled with intern, so that copies and equality checks cost a pointer.
+/// Constructing a handle from a value looks the value up in the pool
+/// @tparam T type of the pooled value
+template <typename T>
+struct interned {
+    using value_type = T;
+
+    interned()
+        : _value(&get_empty())
+    {
+    }
+
+    interned(const T& value)
+        : _value(&intern(value))
+    {
+    }
+
+    template <typename U, std::enable_if_t<std::is_constructible_v<T, U&&> && !std::is_same_v<std::decay_t<U>, T> && !std::is_same_v<std::decay_t<U>, interned>, int> = 0>
+    interned(U&& value)
+        : interned(T(std::forward<U>(value)))
+    {
+    }
+
+    [[nodiscard]] const T& get() const noexcept { return *_value; }
+    [[nodiscard]] const T* operator->() const noexcept { return _value; }
+    operator const T&() const noexcept { return *_value; }
+    [[nodiscard]] bool empty() const noexcept { return _value->empty(); }
+
+    [[nodiscard]] bool operator==(const interned& other) const noexcept { return _value == other._value; }
+    [[nodiscard]] bool operator!=(const interned& other) const noexcept { return _value != other._value; }
+    [[nodiscard]] bool operator<(const interned& other) const { return _value != other._value && *_value < *other._value; }
+
+private:
+    const T* _value;
+
+    static const T& get_empty()
+    {
+        static const T& _empty = intern(T());
+        return _empty;
+    }
+};
+
+/// @brief Bulk edit of the midi notes of a clip whose ids are within [first_note, last_note], that sparse
+/// projects apply after the notes they name. Fields wrap around like unsigned integers when deltas are added,
+/// so that negating the deltas always inverts the operation and composing patches never needs the project.
+/// Folding or negating deltas past the range of their type throws std::out_of_range
+struct midi_note_operation {
+    std::uint32_t first_note = 0;
+    std::uint32_t last_note = 0;
+    std::int64_t start_delta = 0; // added to start_tick
+    std::int32_t pitch_delta = 0; // added to pitch
 };
 
 /// @brief Abstract class for dawxchange projects.
@@ -27,39 +407,64 @@ struct basic_project {
     template <typename T>
     using id = std::conditional_t<sparse_t, std::optional<std::uint32_t>, std::uint32_t>;
 
+#if defined(FMTDXC_FLAT_ID_MAP)
+    template <typename T>
+    using id_map = flat_id_map<T>;
+#elif defined(FMTDXC_COW_ID_MAP)
+    template <typename T>
+    using id_map = cow_id_map<T>;
+#else
     template <typename T>
-    using id_map = std::map<std::uint32_t, T>;
+    using id_map = std::map<std::uint32_t, T, std::less<std::uint32_t>, id_map_allocator<std::pair<const std::uint32_t, T>>>;
+#endif
+
+#if defined(FMTDXC_INTERN)
+    using string = interned<std::string>;
+    using path = interned<std::filesystem::path>;
+#else
+    using string = std::string;
+    using path = std::filesystem::path;
+#endif
+
+    /// @brief Generation stamp that editors bump when an entity or anything it owns is mutated.
+    /// Zero means untracked, sparse projects do not carry stamps
+    using generation_stamp = std::conditional_t<sparse_t, std::monostate, std::uint64_t>;
+
+    /// @brief Range operations of sparse midi clips, dense projects do not carry them
+    using note_operations = std::conditional_t<sparse_t, std::vector<midi_note_operation>, std::monostate>;
 
     struct audio_effect {
-        value<std::string> name;
+        value<string> name;
         // placeholder
     };
 
     struct midi_instrument {
-        value<std::string> name;
+        value<string> name;
         // placeholder
     };
 
     struct collected_audio_file {
-        value<std::vector<char>> data;
-        value<std::filesystem::path> collected_relative_path;
+        value<blob_digest> data; // content from project_container::put_blob
+        value<path> collected_relative_path;
+        generation_stamp generation {};
     };
 
     struct audio_clip {
-        value<std::string> name;
+        value<string> name;
         value<std::uint64_t> start_tick;
         value<std::uint64_t> length_ticks;
-        value<std::filesystem::path> file; // replace w std::variant<std::filesystem::path, audio_file>
+        value<path> file; // replace w std::variant<std::filesystem::path, audio_file>
         value<std::uint64_t> file_start_frame;
         value<double> db;
         value<bool> is_loop;
+        generation_stamp generation {};
     };
 
     struct midi_mpe {
-        value<std::uint32_t> channel;
-        value<float> pressure = 0.0f; // Z
-        value<float> slide = 0.0f; // Y
-        value<float> timbre = 0.0f; // X
+        value<std::uint32_t> channel {};
+        value<float> pressure {}; // Z
+        value<float> slide {}; // Y
+        value<float> timbre {}; // X
     };
 
     struct midi_note {
@@ -68,28 +473,33 @@ struct basic_project {
         value<std::uint16_t> pitch;
         value<float> velocity;
         value<midi_mpe> mpe;
+        generation_stamp generation {};
     };
 
     struct midi_clip {
-        value<std::string> name;
+        value<string> name;
         value<std::uint64_t> start_tick;
         value<std::uint64_t> length_ticks;
         id_map<midi_note> notes;
+        note_operations operations; // applied after notes
+        generation_stamp generation {};
     };
 
     struct mixer_track;
 
     struct audio_sequencer {
-        value<std::string> name;
+        value<string> name;
         id_map<audio_clip> clips;
         id<mixer_track> output;
+        generation_stamp generation {};
     };
 
     struct midi_sequencer {
-        value<std::string> name;
+        value<string> name;
         value<midi_instrument> instrument;
         id_map<midi_clip> clips;
         id<mixer_track> output;
+        generation_stamp generation {};
     };
 
     struct mixer_routing {
@@ -98,19 +508,22 @@ struct basic_project {
     };
 
     struct mixer_track {
-        value<std::string> name;
+        value<string> name;
         value<double> db;
         value<double> pan;
         id_map<audio_effect> effects;
         id_map<mixer_routing> routings;
+        generation_stamp generation {};
     };
 
-    value<std::string> name;
+    value<string> name;
     value<std::uint32_t> ppq;
     id_map<audio_sequencer> audio_sequencers;
     id_map<midi_sequencer> midi_sequencers;
     id_map<mixer_track> mixer_tracks;
+    id_map<collected_audio_file> collected_audio_files;
     id<mixer_track> master_track_id;
+    generation_stamp generation {};
 };
 
 /// @brief Represents a dawxchange project
@@ -119,23 +532,247 @@ using project = basic_project<false>;
 /// @brief Represents a sparse dawxchange project for merge operations
 using sparse_project = basic_project<true>;
 
+/// @brief Columnar copy of the notes of a midi clip with one array per field, sorted by note id
+struct midi_note_columns {
+    std::vector<std::uint32_t> ids;
+    std::vector<std::uint64_t> start_ticks;
+    std::vector<std::uint64_t> length_ticks;
+    std::vector<std::uint16_t> pitches;
+    std::vector<float> velocities;
+};
+
+/// @brief Bits of the per note masks computed by compare_note_columns
+struct midi_note_mask {
+    enum : std::uint8_t {
+        start_tick = 1 << 0,
+        length_ticks = 1 << 1,
+        pitch = 1 << 2,
+        velocity = 1 << 3
+    };
+};
+
+/// @brief Gathers the notes of a midi clip into columns
+/// @param clip Midi clip to gather from
+/// @param columns Columns to overwrite
+void to_columns(const project::midi_clip& clip, midi_note_columns& columns);
+
+/// @brief Scatters columns into the notes of a midi clip, adding the notes that are missing
+/// @param columns Columns to scatter from
+/// @param clip Midi clip to scatter to
+void from_columns(const midi_note_columns& columns, project::midi_clip& clip);
+
+/// @brief Compares two note columns holding the same ids in the same order with SSE2 or AVX2 when available.
+/// Fields are compared like diff() does, velocities with an epsilon
+/// @param a Columns to compare from
+/// @param b Columns to compare to
+/// @param masks One midi_note_mask per note with the bits of the fields that changed
+void compare_note_columns(const midi_note_columns& a, const midi_note_columns& b, std::vector<std::uint8_t>& masks);
+
+/// @brief Returns a generation stamp that was never returned before, for editors to mark mutated entities
+std::uint64_t next_generation();
+
+/// @brief Marks an entity of a dawxchange project as mutated. Editors must touch the mutated entity and
+/// all the entities that own it up to the project itself, diffs then skip entities whose stamp did not change
+/// @param entity Entity or project to touch
+template <typename T>
+void touch(T& entity)
+{
+    entity.generation = next_generation();
+}
+
 /// @brief Create a diff from dawxchange projects
 /// @param base Dawxchange project to compare from
 /// @param other Dawxchange project to compare to
 /// @param result Sparse dawxchange project containing diffed fields only
 void diff(const project& base, const project& other, sparse_project& result);
 
+/// @brief Selects what backward patches hold when diffing in both directions
+enum struct backward_mode {
+    /// @brief Backward patch is the complete diff from other to base, including entities only found in base
+    full,
+    /// @brief Backward patch only holds the old values of the fields the forward patch overwrites.
+    /// Entities only found in base are not patched back because forward patches never delete them
+    overwritten
+};
+
+/// @brief Create forward and backward diffs from dawxchange projects in a single traversal
+/// @param base Dawxchange project to compare from
+/// @param other Dawxchange project to compare to
+/// @param forward Sparse dawxchange project containing diffed fields from base to other
+/// @param backward Sparse dawxchange project containing diffed fields from other to base
+/// @param mode Selects what the backward diff holds
+void diff(const project& base, const project& other, sparse_project& forward, sparse_project& backward, const backward_mode mode = backward_mode::full);
+
+/// @brief Runs a batch of independent tasks and returns once all of them completed.
+/// Can wrap any thread pool, the tasks do not depend on each other
+using executor = std::function<void(const std::vector<std::function<void()>>& tasks)>;
+
+/// @brief Fixed set of worker threads that run batches of tasks
+struct thread_pool {
+    thread_pool(const std::size_t thread_count = 0);
+    thread_pool(const thread_pool& other) = delete;
+    thread_pool& operator=(const thread_pool& other) = delete;
+    ~thread_pool();
+
+    [[nodiscard]] std::size_t get_thread_count() const;
+    void run(const std::vector<std::function<void()>>& tasks);
+
+private:
+    struct state;
+    std::unique_ptr<state> _state;
+};
+
+/// @brief Creates an executor that runs batches of tasks on a thread pool
+/// @param pool Thread pool that must outlive the executor
+executor make_executor(thread_pool& pool);
+
+/// @brief Create a diff from dawxchange projects in parallel. The result matches the serial diff exactly
+/// @param base Dawxchange project to compare from
+/// @param other Dawxchange project to compare to
+/// @param result Sparse dawxchange project containing diffed fields only
+/// @param exec Executor running the diff tasks, the diff runs serially if it is empty
+/// @param chunk_size Count of sequencers or tracks diffed by each task
+void diff(const project& base, const project& other, sparse_project& result, const executor& exec, const std::size_t chunk_size = 8);
+
+/// @brief Create forward and backward diffs from dawxchange projects in parallel. The result matches the serial diff exactly
+/// @param base Dawxchange project to compare from
+/// @param other Dawxchange project to compare to
+/// @param forward Sparse dawxchange project containing diffed fields from base to other
+/// @param backward Sparse dawxchange project containing diffed fields from other to base
+/// @param exec Executor running the diff tasks, the diff runs serially if it is empty
+/// @param mode Selects what the backward diff holds
+/// @param chunk_size Count of sequencers or tracks diffed by each task
+void diff(const project& base, const project& other, sparse_project& forward, sparse_project& backward, const executor& exec, const backward_mode mode = backward_mode::full, const std::size_t chunk_size = 8);
+
 /// @brief Applies changes from a sparse dawxchange project to a dawxhange project
 /// @param base Dawxchange project to apply to
 /// @param diffs Sparse dawxchange project to apply from
 /// @param result Dawxchange project with applied changes
 void apply(const project& base, const sparse_project& diffs, project& result);
 
-/// @brief Applies changes inplace from a sparse dawxchange project to a dawxhange project
+/// @brief Applies changes from a sparse dawxchange project to a dawxhange project that is moved from
+/// @param base Dawxchange project to move from and apply to
+/// @param diffs Sparse dawxchange project to apply from
+/// @param result Dawxchange project with applied changes
+void apply(project&& base, const sparse_project& diffs, project& result);
+
+/// @brief Applies changes inplace from a sparse dawxchange project to a dawxhange project.
+/// Only the entities named in diffs are touched
 /// @param base Dawxchange project to inplace apply to
 /// @param diffs Sparse dawxchange project to apply from
 void apply(project& base, const sparse_project& diffs);
 
+/// @brief Applies changes inplace from a sparse dawxchange project that is moved from to a dawxhange project.
+/// Only the entities named in diffs are touched and their values are moved instead of copied
+/// @param base Dawxchange project to inplace apply to
+/// @param diffs Sparse dawxchange project to move from and apply from
+void apply(project& base, sparse_project&& diffs);
+
+/// @brief Composes two sparse dawxchange projects into one that applies like first then second,
+/// without materializing a dawxchange project. Values from second win over values from first
+/// @param first Sparse dawxchange project applied first
+/// @param second Sparse dawxchange project applied second
+/// @param result Sparse dawxchange project to compose to
+void compose(const sparse_project& first, const sparse_project& second, sparse_project& result);
+
+/// @brief Composes inplace a second sparse dawxchange project into a first one
+/// @param first Sparse dawxchange project applied first to inplace compose to
+/// @param second Sparse dawxchange project applied second
+void compose(sparse_project& first, const sparse_project& second);
+
+/// @brief Composes inplace a second sparse dawxchange project that is moved from into a first one
+/// @param first Sparse dawxchange project applied first to inplace compose to
+/// @param second Sparse dawxchange project applied second to move from
+void compose(sparse_project& first, sparse_project&& second);
+
+/// @brief Identifies a clip found by an interval_index query
+struct clip_ref {
+    std::uint32_t sequencer;
+    std::uint32_t clip;
+};
+
+/// @brief Identifies a midi note found by an interval_index query
+struct note_ref {
+    std::uint32_t sequencer;
+    std::uint32_t clip;
+    std::uint32_t note;
+};
+
+/// @brief Index of the audio clips, midi clips and midi notes of a dawxchange project by the ticks they span.
+/// Entities span [start_tick, start_tick + length_ticks), entities of zero length span their start tick only.
+/// Notes are indexed per clip in ticks relative to the start of their clip, so moving a clip does not touch them.
+/// Queries only walk the subtrees that can overlap the queried range and return entities ordered by start tick
+struct interval_index {
+    interval_index();
+    interval_index(const project& value);
+    interval_index(const interval_index& other) = delete;
+    interval_index& operator=(const interval_index& other) = delete;
+    interval_index(interval_index&& other);
+    interval_index& operator=(interval_index&& other);
+    ~interval_index();
+
+    /// @brief Indexes every clip and note of a dawxchange project, replacing what was indexed before
+    /// @param value Dawxchange project to index
+    void build(const project& value);
+
+    /// @brief Reindexes the clips and notes named in a sparse dawxchange project once it was applied
+    /// @param value Dawxchange project that diffs was applied to
+    /// @param diffs Sparse dawxchange project that was applied
+    void update(const project& value, const sparse_project& diffs);
+
+    /// @brief Finds the audio clips that overlap [first, last) in project ticks
+    void find_audio_clips(const std::uint64_t first, const std::uint64_t last, std::vector<clip_ref>& result) const;
+
+    /// @brief Finds the midi clips that overlap [first, last) in project ticks
+    void find_midi_clips(const std::uint64_t first, const std::uint64_t last, std::vector<clip_ref>& result) const;
+
+    /// @brief Finds the midi notes that overlap [first, last) in project ticks, within the midi clips that overlap it
+    void find_midi_notes(const std::uint64_t first, const std::uint64_t last, std::vector<note_ref>& result) const;
+
+private:
+    struct state;
+    std::unique_ptr<state> _state;
+};
+
+/// @brief Applies changes inplace from a sparse dawxchange project to a dawxhange project and reindexes
+/// the clips and notes named in diffs
+/// @param base Dawxchange project to inplace apply to
+/// @param diffs Sparse dawxchange project to apply from
+/// @param index Interval index of base to update
+void apply(project& base, const sparse_project& diffs, interval_index& index);
+
+/// @brief Represents the kind of entity a merge conflict belongs to
+enum struct merge_entity {
+    project,
+    audio_sequencer,
+    audio_clip,
+    midi_sequencer,
+    midi_clip,
+    midi_note,
+    mixer_track,
+    collected_audio_file,
+    audio_effect,
+    mixer_routing
+};
+
+/// @brief Represents a field that both sides of a merge changed to different values
+struct merge_conflict {
+    merge_entity entity;
+    std::vector<std::uint32_t> ids; // ids from the root to the entity, empty for the project itself
+    std::string field;
+};
+
+/// @brief Merges two sparse dawxchange projects that were both diffed from the same base, walking them
+/// side by side so that the cost depends on the size of the changes and not on the size of the project.
+/// Changes to different fields are combined, fields that both sides changed to different values are
+/// reported as conflicts and take the value from ours. Values equal to the base are not changes
+/// @param base Dawxchange project both sides were diffed from, only looked up for the entities they change
+/// @param ours Sparse dawxchange project with our changes
+/// @param theirs Sparse dawxchange project with their changes
+/// @param result Sparse dawxchange project to overwrite with the merged changes, to apply to base
+/// @param conflicts Conflicts to append to
+void merge(const project& base, const sparse_project& ours, const sparse_project& theirs, sparse_project& result, std::vector<merge_conflict>& conflicts);
+
 /// @brief Represents changes to a dawxchange project as optimized data and metadata
 struct project_commit {
     std::string message;
@@ -144,8 +781,66 @@ struct project_commit {
     sparse_project backward;
 };
 
+struct project_container;
+
+/// @brief Read only view over the commits of a project container, commits are decoded when they are accessed.
+/// Views, iterators and references are invalidated when the container commits, squashes or is imported to
+struct commit_range {
+    struct iterator {
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = project_commit;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const project_commit*;
+        using reference = const project_commit&;
+
+        const project_container* container = nullptr;
+        std::size_t index = 0;
+
+        [[nodiscard]] reference operator*() const;
+        [[nodiscard]] pointer operator->() const;
+        iterator& operator++();
+        iterator operator++(int);
+        [[nodiscard]] bool operator==(const iterator& other) const;
+        [[nodiscard]] bool operator!=(const iterator& other) const;
+    };
+
+    const project_container* container = nullptr;
+
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] bool empty() const;
+    [[nodiscard]] const project_commit& operator[](const std::size_t index) const;
+    [[nodiscard]] iterator begin() const;
+    [[nodiscard]] iterator end() const;
+};
+
+/// @brief Represents how many full project checkpoints a project container holds and their estimated size
+struct checkpoint_stats {
+    std::size_t count;
+    std::size_t bytes;
+};
+
+/// @brief Represents how many blobs and distinct chunks a project container stores and the bytes of these chunks
+struct blob_stats {
+    std::size_t blobs;
+    std::size_t chunks;
+    std::uint64_t bytes;
+};
+
+/// @brief Represents how a project container squashes its history when project_container::compact_history() runs.
+/// Commits younger than keep_all_for are kept as they are, older commits are squashed into one commit
+/// per period of squash_period. A zero squash_period never squashes. Committing never compacts, so that the
+/// editing thread is not blocked by squashes, owners call compact_history() from idle time or between edits
+struct compaction_policy {
+    std::chrono::system_clock::duration keep_all_for = std::chrono::hours(1);
+    std::chrono::system_clock::duration squash_period = std::chrono::hours(1);
+};
+
+struct string_table;
+
 /// @brief Represents a feature rich dawxchange project that saves changes history as linear commits.
-/// This is the format to use from daws
+/// This is the format to use from daws. Commits of imported indexed containers are decoded once on first access,
+/// so that const members can be called from several threads and the references they return stay valid until
+/// the container commits, squashes, compacts or is imported to
 struct project_container {
     project_container();
     project_container(const project& base);
@@ -160,19 +855,171 @@ struct project_container {
     [[nodiscard]] bool can_redo() const;
     [[nodiscard]] std::size_t get_applied_count() const;
     [[nodiscard]] const project& get_project() const;
-    [[nodiscard]] const std::vector<project_commit>& get_commits() const;
+    [[nodiscard]] std::size_t get_commit_count() const;
+    [[nodiscard]] const project_commit& get_commit(const std::size_t index) const;
+    [[nodiscard]] commit_range get_commits() const;
+    [[nodiscard]] const std::string& get_commit_message(const std::size_t index) const;
+    [[nodiscard]] std::chrono::time_point<std::chrono::system_clock> get_commit_timestamp(const std::size_t index) const;
+    [[nodiscard]] backward_mode get_backward_mode() const;
+    void set_backward_mode(const backward_mode mode);
+    void set_executor(const executor& exec);
+    [[nodiscard]] std::size_t get_checkpoint_interval() const;
+    void set_checkpoint_interval(const std::size_t interval);
+    [[nodiscard]] checkpoint_stats get_checkpoint_stats() const;
+    [[nodiscard]] std::uint64_t get_journal_size() const;
+    [[nodiscard]] blob_digest put_blob(const char* data, const std::size_t size);
+    [[nodiscard]] bool has_blob(const blob_digest& digest) const;
+    [[nodiscard]] std::uint64_t get_blob_size(const blob_digest& digest) const;
+    [[nodiscard]] std::vector<char> get_blob(const blob_digest& digest) const;
+    void visit_blob(const blob_digest& digest, const std::function<void(const char*, std::size_t)>& visitor) const;
+    [[nodiscard]] blob_stats get_blob_stats() const;
     void commit(const std::string& message, const project& next);
+    void commit(const std::string& message, project&& next);
     void commit(const project_commit& next);
+    [[nodiscard]] bool in_gesture() const;
+    void begin_gesture(const std::string& message);
+    void end_gesture();
+    void cancel_gesture();
     void undo();
     void redo();
+    void checkout(const std::size_t index);
+    void squash(const std::size_t first, const std::size_t last, const std::string& message);
+    [[nodiscard]] std::optional<compaction_policy> get_compaction_policy() const;
+    void set_compaction_policy(const std::optional<compaction_policy>& policy);
+    std::size_t compact_history(const std::chrono::time_point<std::chrono::system_clock>& now = std::chrono::system_clock::now());
+    [[nodiscard]] const interval_index* get_interval_index() const;
+    void set_interval_index(const bool enabled);
 
 private:
+    struct file_buffer;
+    struct squash_range;
+    struct decoded_commit {
+        std::once_flag once;
+        std::shared_ptr<const project_commit> commit; // set once by the first access
+    };
+    struct commit_slot {
+        std::shared_ptr<const project_commit> commit; // only holds the message and timestamp while offset is set
+        std::uint64_t offset; // offset of the commit record to decode from _buffer, 0 when commit holds the patches
+        std::shared_ptr<decoded_commit> decoded; // null when offset is 0, shared with export snapshots
+    };
+    struct journal_state {
+        bool attached = false; // whether the file holds a snapshot of this container
+        std::size_t synced = 0; // leading commits that are already written to the file
+        std::size_t applied = 0; // applied count last written to the file
+        std::uint64_t snapshot_size = 0;
+        std::uint64_t size = 0; // bytes of journal records after the snapshot
+        std::vector<blob_digest> pending_chunks; // chunks that are not written to the file yet
+        std::vector<blob_digest> pending_blobs;
+        std::size_t strings = 0; // leading values of _strings that are already written to the file
+    };
+    struct blob_chunk {
+        std::shared_ptr<const std::vector<char>> bytes; // null while the chunk is only in _buffer
+        std::uint64_t offset; // offset of the chunk record in _buffer
+        std::size_t size;
+    };
+    struct blob_manifest {
+        std::uint64_t size;
+        std::vector<blob_digest> chunks;
+    };
+    struct gesture_state {
+        std::string message;
+        project current; // latest project committed during the gesture, _proj stays at its start
+        bool committed; // whether current was set
+    };
+
     project _proj;
     std::size_t _applied;
-    std::vector<project_commit> _commits;
+    std::vector<commit_slot> _commits;
+    std::shared_ptr<const file_buffer> _buffer;
+    backward_mode _backward_mode;
+    executor _executor;
+    std::size_t _checkpoint_interval;
+    std::map<std::size_t, project> _checkpoints;
+    journal_state _journal;
+    std::map<blob_digest, blob_chunk> _chunks;
+    std::map<blob_digest, blob_manifest> _blobs;
+    std::optional<compaction_policy> _compaction_policy;
+    std::size_t _compacted; // leading commits that the compaction policy already squashed
+    std::shared_ptr<string_table> _strings; // strings of version::alpha_interned payloads, only grows
+    std::unique_ptr<interval_index> _intervals; // null unless enabled, follows _proj
+    std::optional<gesture_state> _gesture;
+#if defined(FMTDXC_PMR)
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> _scratch; // released after each use
+#endif
+
+    void _record_checkpoint();
+    void _truncate();
+    const project_commit& _load(const std::size_t index) const;
+    void _squash(std::vector<squash_range>& ranges);
+    void _update_intervals(const sparse_project& diffs);
+    void _commit_intervals(const project_commit& c, const project& next);
+    void _push_commit(project_commit&& c);
 
-    template <typename archive_t>
-    friend void serialize(archive_t& archive, project_container& value);
+    friend struct container_io;
+    friend struct edit_session;
+};
+
+/// @brief Records typed edits to the project of a container as forward and backward patches while applying them
+/// in place, so that committing costs as much as the edits made instead of a project copy and a diff.
+/// Edits are visible from project_container::get_project() as they are made, and the container must not be
+/// committed to, undone, redone, checked out or exported until the session is committed or discarded.
+/// The interval index of the container catches up when the session is committed or discarded.
+/// Sessions discard their edits that were not committed when destroyed, ignoring the errors of discard()
+struct edit_session {
+    edit_session(project_container& container);
+    edit_session(const edit_session& other) = delete;
+    edit_session& operator=(const edit_session& other) = delete;
+    ~edit_session();
+
+    [[nodiscard]] std::size_t get_edit_count() const;
+    void set_audio_clip_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t start_tick);
+    void set_audio_clip_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t length_ticks);
+    void set_audio_clip_db(const std::uint32_t sequencer, const std::uint32_t clip, const double db);
+    void set_midi_clip_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t start_tick);
+    void set_midi_clip_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t length_ticks);
+    void set_midi_note_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint64_t start_tick);
+    void set_midi_note_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint64_t length_ticks);
+    void set_midi_note_pitch(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint16_t pitch);
+    void set_midi_note_velocity(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const float velocity);
+    void set_mixer_track_db(const std::uint32_t track, const double db);
+    void set_mixer_track_pan(const std::uint32_t track, const double pan);
+
+    /// @brief Adds delta to the start tick of the notes of a midi clip that start within [first_tick, last_tick).
+    /// The patches hold one operation per run of selected note ids instead of one entry per note.
+    /// Throws std::out_of_range if a note would start before tick 0
+    void shift_midi_notes(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t first_tick, const std::uint64_t last_tick, const std::int64_t delta);
+
+    /// @brief Adds semitones to the pitch of the notes of a midi clip that start within [first_tick, last_tick).
+    /// The patches hold one operation per run of selected note ids instead of one entry per note.
+    /// Throws std::out_of_range if a pitch would leave the range of its field
+    void transpose_midi_notes(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t first_tick, const std::uint64_t last_tick, const std::int32_t semitones);
+
+    /// @brief Adds a midi note to a midi clip, throws if the clip already holds a note with this id
+    void add_midi_note(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const project::midi_note& value);
+
+    /// @brief Commits the edits made since the session started or was last committed, does nothing when they
+    /// did not change the project
+    /// @param message Message of the commit
+    void commit(const std::string& message);
+
+    /// @brief Reverts the edits made since the session started or was last committed. Throws std::bad_alloc
+    /// when reverting runs out of memory, in which case the project is partly reverted and the session holds no edits
+    void discard();
+
+private:
+    struct note_key {
+        std::uint32_t sequencer;
+        std::uint32_t clip;
+        std::uint32_t note;
+    };
+
+    project_container& _container;
+    sparse_project _forward;
+    sparse_project _backward;
+    std::vector<note_key> _added; // notes that discard removes, backward patches can not delete them
+    std::size_t _edits = 0;
+
+    void _begin_edit();
 };
 
 /// @brief Imports a project container from an input stream
@@ -181,10 +1028,206 @@ private:
 /// @param ver Detected version of the project container
 void import_container(std::istream& stream, project_container& container, version& ver);
 
+/// @brief Imports a project container from a file that is memory mapped when the platform allows it.
+/// Containers from version::alpha_indexed only decode the current project and the commit messages
+/// and timestamps, commit patches are decoded on demand
+/// @param path Path of the file to import from
+/// @param container Project container to import to
+/// @param ver Detected version of the project container
+void import_container(const std::filesystem::path& path, project_container& container, version& ver);
+
+/// @brief Appends to a version::alpha_indexed file the commits and applied count that changed since the
+/// container was imported from it or last journaled to it, as checksummed records after the snapshot.
+/// Writes a full snapshot with compact_container instead when the container is not attached to a file yet.
+/// Importing the file replays the journal and discards a torn final record
+/// @param path Path of the file to append to
+/// @param container Project container to journal
+void append_journal(const std::filesystem::path& path, project_container& container);
+
+/// @brief Rewrites a version::alpha_indexed snapshot without journal through a temporary file that
+/// replaces the file, then attaches the container to it. Commits that were decoded are released
+/// @param path Path of the file to rewrite
+/// @param container Project container to write
+void compact_container(const std::filesystem::path& path, project_container& container);
+
 /// @brief Exports a project container to an output stream
 /// @param stream Output stream to export to
 /// @param container Project container to export from
 /// @param ver Choosen dawxchange version of the project container
 void export_container(std::ostream& stream, const project_container& container, const version& ver);
 
+/// @brief Receives from the worker thread of an asynchronous export how many records of the project,
+/// commits and blob chunks were written out of the total
+using export_progress = std::function<void(std::size_t written, std::size_t total)>;
+
+/// @brief Represents an export running on a worker thread. Destroying it waits for the export to finish
+struct export_task {
+    export_task(std::future<void>&& result, std::shared_ptr<std::atomic<bool>> cancelled);
+    export_task(const export_task& other) = delete;
+    export_task& operator=(const export_task& other) = delete;
+    export_task(export_task&& other) = default;
+    export_task& operator=(export_task&& other) = default;
+
+    [[nodiscard]] std::future<void>& get_future();
+    void cancel();
+
+private:
+    std::future<void> _future;
+    std::shared_ptr<std::atomic<bool>> _cancelled;
+};
+
+/// @brief Exports a snapshot of a project container to an output stream from a worker thread. The snapshot
+/// copies the current project and shares the commits, so that the container can be committed to, undone and
+/// journaled while the export runs. It is taken on the calling thread before this returns: the project, the
+/// string table and the commit, chunk and blob indices are copied there, which costs as much as copying the
+/// project unless FMTDXC_ID_MAP is cow, whose copies share their storage. Only encoding and writing run on the
+/// worker. The future throws the error of the export, or a std::runtime_error when the export was cancelled,
+/// in which case the stream holds an incomplete container
+/// @param stream Output stream to export to, that must outlive the task
+/// @param container Project container to take the snapshot from
+/// @param ver Choosen dawxchange version of the project container
+/// @param progress Optional callback called after each written record
+[[nodiscard]] export_task export_container_async(std::ostream& stream, const project_container& container, const version& ver, const export_progress& progress = {});
+
+/// @brief Reads a project container one commit at a time without keeping the decoded commits, so that memory
+/// stays bounded by the current project and the largest commit. Containers from version::alpha are read in order,
+/// the other versions are memory mapped and streams that hold them are first spooled to a temporary file
+struct container_reader {
+    container_reader(const std::filesystem::path& path);
+    container_reader(std::istream& stream);
+    container_reader(const container_reader& other) = delete;
+    container_reader& operator=(const container_reader& other) = delete;
+    ~container_reader();
+
+    [[nodiscard]] version get_version() const;
+    [[nodiscard]] const project& get_project() const;
+    [[nodiscard]] std::size_t get_applied_count() const;
+    [[nodiscard]] std::size_t get_commit_count() const;
+    [[nodiscard]] std::size_t get_commit_index() const;
+
+    /// @brief Reads the next commit, or returns null once every commit was read.
+    /// Commits read without their patches only hold their message and timestamp, and are not decoded
+    /// from the containers that index them
+    /// @param patches Whether to decode the forward and backward patches
+    [[nodiscard]] std::shared_ptr<const project_commit> read_commit(const bool patches = true);
+
+private:
+    struct state;
+    std::unique_ptr<state> _state;
+};
+
+/// @brief Writes a project container one commit at a time, so that memory stays bounded by the current project
+/// and the largest commit. The commit count is given first because version::alpha writes it before the commits
+struct container_writer {
+    container_writer(std::ostream& stream, const version& ver, const project& current, const std::size_t applied, const std::size_t commit_count);
+    container_writer(const container_writer& other) = delete;
+    container_writer& operator=(const container_writer& other) = delete;
+    ~container_writer();
+
+    void write_commit(const project_commit& commit);
+
+    /// @brief Completes the container once every commit was written
+    void finish();
+
+private:
+    struct state;
+    std::unique_ptr<state> _state;
+};
+
+/// @brief Represents the first json line of a converted container, which describes the container
+/// and the parts of it held by the following lines
+struct container_info {
+    version ver = version::alpha;
+    std::size_t applied = 0;
+    std::size_t commit_count = 0;
+    bool has_project = true; // whether a project line follows
+    std::size_t first_commit = 0; // index of the first commit line
+    std::size_t last_commit = 0; // one past the index of the last commit line
+    bool has_patches = true; // whether commit lines hold their patches or only their message and timestamp
+};
+
+/// @brief Represents a json line of a converted container
+using json_line = std::variant<container_info, project, project_commit>;
+
+/// @brief Writes the description of a container as a single json line
+/// @param stream Output stream to write to
+/// @param value Description to write
+void export_json_line(std::ostream& stream, const container_info& value);
+
+/// @brief Writes a project as a single json line
+/// @param stream Output stream to write to
+/// @param value Project to write
+void export_json_line(std::ostream& stream, const project& value);
+
+/// @brief Writes a commit as a single json line
+/// @param stream Output stream to write to
+/// @param value Commit to write
+void export_json_line(std::ostream& stream, const project_commit& value);
+
+/// @brief Reads the next json line written by export_json_line, skipping blank lines
+/// @param stream Input stream to read from
+/// @param line Value of the line
+/// @return Whether a line was read before the end of the stream
+bool import_json_line(std::istream& stream, json_line& line);
+
+/// @brief Represents the public operations timed by the instrumentation. Operations called by other
+/// operations are timed too, a commit also times the diff it runs
+enum struct instrumentation_phase {
+    diff,
+    apply,
+    compose,
+    merge,
+    commit,
+    undo,
+    redo,
+    checkout,
+    squash,
+    export_container,
+    import_container,
+    append_journal,
+    compact_container
+};
+
+/// @brief Count of values of instrumentation_phase
+inline constexpr std::size_t instrumentation_phase_count = 13;
+
+/// @brief Represents how many times an instrumented phase ran and the wall time it took
+struct phase_stats {
+    std::uint64_t calls;
+    std::chrono::nanoseconds time;
+};
+
+/// @brief Represents the work done by the library since the process started or the stats were reset.
+/// Stays zero unless the library is built with FMTDXC_INSTRUMENTATION
+struct instrumentation_stats {
+    std::uint64_t nodes_visited; // entities walked by diff, apply and compose
+    std::uint64_t audio_sequencers_diffed; // entities compared field by field, the ones skipped by their generation stamp are only visited
+    std::uint64_t audio_clips_diffed;
+    std::uint64_t midi_sequencers_diffed;
+    std::uint64_t midi_clips_diffed;
+    std::uint64_t midi_notes_diffed;
+    std::uint64_t mixer_tracks_diffed;
+    std::uint64_t audio_effects_diffed;
+    std::uint64_t mixer_routings_diffed;
+    std::uint64_t collected_audio_files_diffed;
+    std::uint64_t patch_entities; // entities written to forward and backward patches by diff
+    std::uint64_t bytes_encoded; // bytes of projects and commits written by export_container, append_journal and compact_container
+    std::uint64_t bytes_decoded; // bytes of projects and commits read by import_container and lazy loading
+    std::uint64_t entities_allocated; // entities inserted into projects and patches by diff, apply and compose
+    std::array<phase_stats, instrumentation_phase_count> phases;
+};
+
+/// @brief Callback receiving the stats gathered by all threads while an outermost instrumented phase ran
+using instrumentation_sink = std::function<void(const instrumentation_phase phase, const instrumentation_stats& stats)>;
+
+/// @brief Returns the stats gathered by all threads since the process started or the last reset
+instrumentation_stats get_instrumentation_stats();
+
+/// @brief Restarts the stats returned by get_instrumentation_stats from zero
+void reset_instrumentation_stats();
+
+/// @brief Registers a callback that is called from the calling thread after each outermost instrumented phase
+/// @param sink Callback to register, or an empty callback to unregister
+void set_instrumentation_sink(const instrumentation_sink& sink);
+
 }
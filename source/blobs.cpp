@@ -0,0 +1,131 @@
+#include <fmtdxc/fmtdxc.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace fmtdxc {
+
+// ---------- blobs ----------
+
+// blobs are split into fixed size chunks so that a blob that changed only stores the chunks that differ
+static constexpr std::size_t blob_chunk_size = 64 * 1024;
+
+static blob_digest sha256(const char* data, const std::size_t size)
+{
+    static constexpr std::uint32_t _k[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+    std::uint32_t _state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    const auto _rotate = [](const std::uint32_t x, const int n) { return (x >> n) | (x << (32 - n)); };
+    const auto _compress = [&](const std::uint8_t* block) {
+        std::uint32_t _w[64];
+        for (int _index = 0; _index < 16; ++_index)
+            _w[_index] = (std::uint32_t(block[4 * _index]) << 24) | (std::uint32_t(block[4 * _index + 1]) << 16) | (std::uint32_t(block[4 * _index + 2]) << 8) | std::uint32_t(block[4 * _index + 3]);
+        for (int _index = 16; _index < 64; ++_index) {
+            const std::uint32_t _s0 = _rotate(_w[_index - 15], 7) ^ _rotate(_w[_index - 15], 18) ^ (_w[_index - 15] >> 3);
+            const std::uint32_t _s1 = _rotate(_w[_index - 2], 17) ^ _rotate(_w[_index - 2], 19) ^ (_w[_index - 2] >> 10);
+            _w[_index] = _w[_index - 16] + _s0 + _w[_index - 7] + _s1;
+        }
+        std::uint32_t _a = _state[0], _b = _state[1], _c = _state[2], _d = _state[3], _e = _state[4], _f = _state[5], _g = _state[6], _h = _state[7];
+        for (int _index = 0; _index < 64; ++_index) {
+            const std::uint32_t _t1 = _h + (_rotate(_e, 6) ^ _rotate(_e, 11) ^ _rotate(_e, 25)) + ((_e & _f) ^ (~_e & _g)) + _k[_index] + _w[_index];
+            const std::uint32_t _t2 = (_rotate(_a, 2) ^ _rotate(_a, 13) ^ _rotate(_a, 22)) + ((_a & _b) ^ (_a & _c) ^ (_b & _c));
+            _h = _g;
+            _g = _f;
+            _f = _e;
+            _e = _d + _t1;
+            _d = _c;
+            _c = _b;
+            _b = _a;
+            _a = _t1 + _t2;
+        }
+        _state[0] += _a;
+        _state[1] += _b;
+        _state[2] += _c;
+        _state[3] += _d;
+        _state[4] += _e;
+        _state[5] += _f;
+        _state[6] += _g;
+        _state[7] += _h;
+    };
+
+    const std::uint8_t* _bytes = reinterpret_cast<const std::uint8_t*>(data);
+    std::size_t _offset = 0;
+    for (; _offset + 64 <= size; _offset += 64)
+        _compress(_bytes + _offset);
+    std::uint8_t _tail[128] = {};
+    const std::size_t _remaining = size - _offset;
+    std::copy(_bytes + _offset, _bytes + size, _tail);
+    _tail[_remaining] = 0x80;
+    const std::size_t _tail_size = _remaining < 56 ? 64 : 128;
+    const std::uint64_t _bits = static_cast<std::uint64_t>(size) * 8;
+    for (int _byte = 0; _byte < 8; ++_byte)
+        _tail[_tail_size - 1 - _byte] = static_cast<std::uint8_t>(_bits >> (8 * _byte));
+    for (std::size_t _block = 0; _block < _tail_size; _block += 64)
+        _compress(_tail + _block);
+
+    blob_digest _digest;
+    for (int _index = 0; _index < 8; ++_index)
+        for (int _byte = 0; _byte < 4; ++_byte)
+            _digest.bytes[4 * _index + _byte] = static_cast<std::uint8_t>(_state[_index] >> (24 - 8 * _byte));
+    return _digest;
+}
+
+// a blob is identified by the digest of its size and of the digests of its chunks, so that
+// hashing a blob reads its bytes once
+static blob_digest blob_digest_of(const std::uint64_t size, const std::vector<blob_digest>& chunks)
+{
+    std::string _manifest;
+    for (int _byte = 0; _byte < 8; ++_byte)
+        _manifest.push_back(static_cast<char>((size >> (8 * _byte)) & 0xFF));
+    for (auto& _chunk : chunks)
+        _manifest.append(reinterpret_cast<const char*>(_chunk.bytes.data()), _chunk.bytes.size());
+    return sha256(_manifest.data(), _manifest.size());
+}
+
+blob_digest project_container::put_blob(const char* data, const std::size_t size)
+{
+    blob_manifest _manifest { size, {} };
+    _manifest.chunks.reserve((size + blob_chunk_size - 1) / blob_chunk_size);
+    for (std::size_t _offset = 0; _offset < size; _offset += blob_chunk_size) {
+        const std::size_t _size = std::min(blob_chunk_size, size - _offset);
+        const blob_digest _chunk = sha256(data + _offset, _size);
+        _manifest.chunks.push_back(_chunk);
+        if (_chunks.find(_chunk) == _chunks.end()) {
+            _chunks.emplace(_chunk, blob_chunk { std::make_shared<const std::vector<char>>(data + _offset, data + _offset + _size), 0, _size });
+            _journal.pending_chunks.push_back(_chunk);
+        }
+    }
+    const blob_digest _digest = blob_digest_of(size, _manifest.chunks);
+    if (_blobs.emplace(_digest, std::move(_manifest)).second)
+        _journal.pending_blobs.push_back(_digest);
+    return _digest;
+}
+
+bool project_container::has_blob(const blob_digest& digest) const { return _blobs.find(digest) != _blobs.end(); }
+
+std::uint64_t project_container::get_blob_size(const blob_digest& digest) const { return _blobs.at(digest).size; }
+
+std::vector<char> project_container::get_blob(const blob_digest& digest) const
+{
+    std::vector<char> _bytes;
+    _bytes.reserve(static_cast<std::size_t>(get_blob_size(digest)));
+    visit_blob(digest, [&_bytes](const char* data, const std::size_t size) { _bytes.insert(_bytes.end(), data, data + size); });
+    return _bytes;
+}
+
+blob_stats project_container::get_blob_stats() const
+{
+    blob_stats _stats { _blobs.size(), _chunks.size(), 0 };
+    for (auto& [digest, chunk] : _chunks)
+        _stats.bytes += chunk.size;
+    return _stats;
+}
+}
@@ -0,0 +1,2132 @@
+#include "internal.hpp"
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/archives/json.hpp>
+#include <cereal/cereal.hpp>
+#include <cereal/types/array.hpp>
+#include <cereal/types/chrono.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/optional.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <sstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define FMTDXC_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace std {
+namespace filesystem {
+
+    template <typename archive_t>
+    void serialize(archive_t& archive, path& p)
+    {
+        if constexpr (archive_t::is_saving::value) {
+            archive(cereal::make_nvp("path", p.string()));
+        } else if constexpr (archive_t::is_loading::value) {
+            std::string _str;
+            archive(cereal::make_nvp("path", _str));
+            p = std::filesystem::path(_str);
+        }
+    }
+
+}
+}
+
+#define FMX_SERIALIZE_NESTED(Nested)                                                                  \
+    template <class archive_t>                                                                        \
+    void serialize(archive_t& archive, project::Nested& value) { serialize_fields(archive, value); } \
+    template <class archive_t>                                                                        \
+    void serialize(archive_t& archive, sparse_project::Nested& value) { serialize_fields(archive, value); }
+
+namespace fmtdxc {
+
+// interned values are archived as the values themselves
+template <typename archive_t>
+std::string save_minimal(const archive_t&, const interned<std::string>& value)
+{
+    return value.get();
+}
+
+template <typename archive_t>
+void load_minimal(const archive_t&, interned<std::string>& value, const std::string& data)
+{
+    value = data;
+}
+
+template <typename archive_t>
+void save(archive_t& archive, const interned<std::filesystem::path>& value)
+{
+    archive(cereal::make_nvp("path", value->string()));
+}
+
+template <typename archive_t>
+void load(archive_t& archive, interned<std::filesystem::path>& value)
+{
+    std::string _str;
+    archive(cereal::make_nvp("path", _str));
+    value = std::filesystem::path(_str);
+}
+
+// note operations are only written by json lines, where they are an optional last member of sparse midi clips,
+// the binary layouts of version::alpha and version::alpha_indexed can not hold them
+template <typename archive_t>
+void serialize_note_operations(archive_t&, std::monostate&)
+{
+}
+
+template <typename archive_t>
+void serialize_note_operations(archive_t& archive, std::vector<midi_note_operation>& value)
+{
+    if constexpr (std::is_same_v<archive_t, cereal::JSONOutputArchive>) {
+        if (!value.empty())
+            archive(cereal::make_nvp("operations", value));
+    } else if constexpr (std::is_same_v<archive_t, cereal::JSONInputArchive>) {
+        const char* _name = archive.getNodeName();
+        if (_name && std::strcmp(_name, "operations") == 0)
+            archive(cereal::make_nvp("operations", value));
+    } else if constexpr (archive_t::is_saving::value) {
+        if (!value.empty())
+            throw std::runtime_error("fmtdxc: midi note operations need version::alpha_columnar or later");
+    }
+}
+
+// flat and copy on write id maps are archived like std::map
+template <typename archive_t, typename map_t>
+void save_id_map(archive_t& archive, const map_t& value)
+{
+    archive(cereal::make_size_tag(static_cast<cereal::size_type>(value.size())));
+    for (auto& [id, entity] : value)
+        archive(cereal::make_map_item(id, entity));
+}
+
+template <typename archive_t, typename map_t>
+void load_id_map(archive_t& archive, map_t& value)
+{
+    cereal::size_type _size;
+    archive(cereal::make_size_tag(_size));
+    value.clear();
+    value.reserve(static_cast<std::size_t>(_size));
+    for (cereal::size_type _index = 0; _index < _size; ++_index) {
+        std::uint32_t _id;
+        typename map_t::mapped_type _entity;
+        archive(cereal::make_map_item(_id, _entity));
+        value.emplace_hint(value.end(), _id, std::move(_entity));
+    }
+}
+
+template <typename archive_t, typename T>
+void save(archive_t& archive, const flat_id_map<T>& value)
+{
+    save_id_map(archive, value);
+}
+
+template <typename archive_t, typename T>
+void load(archive_t& archive, flat_id_map<T>& value)
+{
+    load_id_map(archive, value);
+}
+
+template <typename archive_t, typename T>
+void save(archive_t& archive, const cow_id_map<T>& value)
+{
+    save_id_map(archive, value);
+}
+
+template <typename archive_t, typename T>
+void load(archive_t& archive, cow_id_map<T>& value)
+{
+    load_id_map(archive, value);
+}
+
+template <typename archive_t>
+void serialize(archive_t& archive, midi_note_operation& value)
+{
+    archive(cereal::make_nvp("first_note", value.first_note));
+    archive(cereal::make_nvp("last_note", value.last_note));
+    archive(cereal::make_nvp("start_delta", value.start_delta));
+    archive(cereal::make_nvp("pitch_delta", value.pitch_delta));
+}
+
+template <typename archive_t>
+void serialize(archive_t& archive, blob_digest& value)
+{
+    archive(cereal::make_nvp("bytes", value.bytes));
+}
+
+// nested records are archived in the order of their field list
+template <typename archive_t, typename record_t>
+void serialize_fields(archive_t& archive, record_t& value)
+{
+    record_fields<record_t>::visit([&](const char* name, auto&& field) {
+        auto& _member = field(value);
+        using member_t = member_type<decltype(_member)>;
+        if constexpr (std::is_same_v<member_t, std::monostate> || std::is_same_v<member_t, std::vector<midi_note_operation>>)
+            serialize_note_operations(archive, _member);
+        else
+            archive(cereal::make_nvp(name, _member));
+    });
+}
+
+FMX_SERIALIZE_NESTED(audio_effect)
+FMX_SERIALIZE_NESTED(midi_instrument)
+FMX_SERIALIZE_NESTED(audio_clip)
+FMX_SERIALIZE_NESTED(midi_mpe)
+FMX_SERIALIZE_NESTED(midi_note)
+FMX_SERIALIZE_NESTED(midi_clip)
+FMX_SERIALIZE_NESTED(audio_sequencer)
+FMX_SERIALIZE_NESTED(mixer_routing)
+FMX_SERIALIZE_NESTED(mixer_track)
+FMX_SERIALIZE_NESTED(collected_audio_file)
+FMX_SERIALIZE_NESTED(midi_sequencer)
+
+// root layout of version::alpha, kept as is so that existing containers still import
+template <typename archive_t, bool sparse_t>
+void serialize(archive_t& archive, basic_project<sparse_t>& value)
+{
+    archive(cereal::make_nvp("name", value.name));
+    archive(cereal::make_nvp("ppq", value.ppq));
+    // archive(cereal::make_nvp("audio_sequencers", value.audio_sequencers));
+    // archive(cereal::make_nvp("midi_sequencers", value.midi_sequencers));
+    archive(cereal::make_nvp("mixer_tracks", value.mixer_tracks));
+    archive(cereal::make_nvp("master_track_id", value.master_track_id));
+}
+
+// root layout of the payloads of version::alpha_indexed
+template <typename archive_t, bool sparse_t>
+void serialize_payload(archive_t& archive, basic_project<sparse_t>& value)
+{
+    archive(cereal::make_nvp("name", value.name));
+    archive(cereal::make_nvp("ppq", value.ppq));
+    archive(cereal::make_nvp("audio_sequencers", value.audio_sequencers));
+    archive(cereal::make_nvp("midi_sequencers", value.midi_sequencers));
+    archive(cereal::make_nvp("mixer_tracks", value.mixer_tracks));
+    archive(cereal::make_nvp("collected_audio_files", value.collected_audio_files));
+    archive(cereal::make_nvp("master_track_id", value.master_track_id));
+}
+
+template <typename archive_t>
+void serialize(archive_t& archive, project_commit& value)
+{
+    archive(cereal::make_nvp("message", value.message));
+    archive(cereal::make_nvp("timestamp", value.timestamp));
+    archive(cereal::make_nvp("forward", value.forward));
+    archive(cereal::make_nvp("backward", value.backward));
+}
+
+// json lines hold whole projects and patches, unlike the root layout of version::alpha
+template <bool sparse_t>
+struct payload_view {
+    basic_project<sparse_t>& value;
+};
+
+template <typename archive_t, bool sparse_t>
+void serialize(archive_t& archive, payload_view<sparse_t>& view)
+{
+    serialize_payload(archive, view.value);
+}
+
+struct commit_view {
+    project_commit& value;
+};
+
+template <typename archive_t>
+void serialize(archive_t& archive, commit_view& view)
+{
+    payload_view<true> _forward { view.value.forward };
+    payload_view<true> _backward { view.value.backward };
+    archive(cereal::make_nvp("message", view.value.message));
+    archive(cereal::make_nvp("timestamp", view.value.timestamp));
+    archive(cereal::make_nvp("forward", _forward));
+    archive(cereal::make_nvp("backward", _backward));
+}
+
+template <typename archive_t>
+void serialize(archive_t& archive, container_info& value)
+{
+    archive(cereal::make_nvp("version", value.ver));
+    archive(cereal::make_nvp("applied", value.applied));
+    archive(cereal::make_nvp("commit_count", value.commit_count));
+    archive(cereal::make_nvp("has_project", value.has_project));
+    archive(cereal::make_nvp("first_commit", value.first_commit));
+    archive(cereal::make_nvp("last_commit", value.last_commit));
+    archive(cereal::make_nvp("has_patches", value.has_patches));
+}
+
+// ---------- container files ----------
+//
+// version::alpha_indexed layout, integers are little endian:
+//   header   'DXCC' | u32 version | u64 snapshot size (0 when the stream was not seekable)
+//   records  u32 tag | u64 size | payload | u32 crc32 of payload
+//   trailer  u64 offset of the index record | 'DXCINDEX'
+//   journal  records appended after the snapshot by append_journal
+// the index record lists the applied count, the project record and the message and timestamp
+// of every commit record so that commit patches can be decoded on demand, then the blob manifests
+// and the chunk records. Journal records list the count of commits kept from before, the applied
+// count and the commit records, blobs and chunk records written before them
+
+static constexpr char container_magic[4] = { 'D', 'X', 'C', 'C' };
+static constexpr char index_magic[8] = { 'D', 'X', 'C', 'I', 'N', 'D', 'E', 'X' };
+static constexpr std::size_t header_size = 16;
+static constexpr std::size_t trailer_size = 16;
+static constexpr std::size_t record_overhead = 16;
+
+enum struct record_tag : std::uint32_t {
+    project = 1,
+    commit = 2,
+    index = 3,
+    journal = 4,
+    chunk = 5,
+    strings = 6
+};
+
+static std::uint32_t crc32(const char* data, const std::size_t size)
+{
+    static const std::array<std::uint32_t, 256> _table = []() {
+        std::array<std::uint32_t, 256> _values;
+        for (std::uint32_t _index = 0; _index < 256; ++_index) {
+            std::uint32_t _crc = _index;
+            for (int _bit = 0; _bit < 8; ++_bit)
+                _crc = _crc & 1 ? 0xEDB88320u ^ (_crc >> 1) : _crc >> 1;
+            _values[_index] = _crc;
+        }
+        return _values;
+    }();
+    std::uint32_t _crc = 0xFFFFFFFFu;
+    for (std::size_t _index = 0; _index < size; ++_index)
+        _crc = _table[(_crc ^ static_cast<std::uint8_t>(data[_index])) & 0xFF] ^ (_crc >> 8);
+    return ~_crc;
+}
+
+static void put_u32(std::string& out, const std::uint32_t value)
+{
+    for (int _byte = 0; _byte < 4; ++_byte)
+        out.push_back(static_cast<char>((value >> (8 * _byte)) & 0xFF));
+}
+
+static void put_u64(std::string& out, const std::uint64_t value)
+{
+    for (int _byte = 0; _byte < 8; ++_byte)
+        out.push_back(static_cast<char>((value >> (8 * _byte)) & 0xFF));
+}
+
+static void put_string(std::string& out, const std::string& value)
+{
+    put_u64(out, value.size());
+    out.append(value);
+}
+
+static void put_digest(std::string& out, const blob_digest& value)
+{
+    out.append(reinterpret_cast<const char*>(value.bytes.data()), value.bytes.size());
+}
+
+static std::int64_t to_nanoseconds(const std::chrono::time_point<std::chrono::system_clock>& timestamp)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(timestamp.time_since_epoch()).count();
+}
+
+static std::chrono::time_point<std::chrono::system_clock> from_nanoseconds(const std::int64_t count)
+{
+    return std::chrono::time_point<std::chrono::system_clock>(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(count)));
+}
+
+// bounds checked little endian reads over bytes that are not owned
+struct byte_reader {
+    const char* data;
+    std::size_t size;
+    std::size_t position;
+
+    void require(const std::size_t count) const
+    {
+        if (count > size - position)
+            throw std::runtime_error("fmtdxc: truncated dawxchange container");
+    }
+
+    std::uint64_t read_uint(const int bytes)
+    {
+        require(bytes);
+        std::uint64_t _value = 0;
+        for (int _byte = 0; _byte < bytes; ++_byte)
+            _value |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(data[position + _byte])) << (8 * _byte);
+        position += bytes;
+        return _value;
+    }
+
+    std::uint32_t u32() { return static_cast<std::uint32_t>(read_uint(4)); }
+    std::uint64_t u64() { return read_uint(8); }
+    std::int64_t i64() { return static_cast<std::int64_t>(read_uint(8)); }
+
+    std::uint64_t varint()
+    {
+        std::uint64_t _value = 0;
+        for (int _shift = 0; _shift < 64; _shift += 7) {
+            require(1);
+            const std::uint8_t _byte = static_cast<std::uint8_t>(data[position++]);
+            _value |= static_cast<std::uint64_t>(_byte & 0x7F) << _shift;
+            if (!(_byte & 0x80))
+                return _value;
+        }
+        throw std::runtime_error("fmtdxc: invalid varint in dawxchange container");
+    }
+
+    const char* bytes(const std::size_t count)
+    {
+        require(count);
+        const char* _bytes = data + position;
+        position += count;
+        return _bytes;
+    }
+
+    blob_digest digest()
+    {
+        blob_digest _digest;
+        const char* _bytes = bytes(_digest.bytes.size());
+        std::copy(_bytes, _bytes + _digest.bytes.size(), reinterpret_cast<char*>(_digest.bytes.data()));
+        return _digest;
+    }
+
+    std::string string()
+    {
+        const std::uint64_t _size = u64();
+        require(_size);
+        return std::string(bytes(_size), _size);
+    }
+};
+
+// lets cereal decode bytes in place, without copying them into a stringstream
+struct span_streambuf : std::streambuf {
+    span_streambuf(const char* data, const std::size_t size)
+    {
+        char* _begin = const_cast<char*>(data);
+        setg(_begin, _begin, _begin + size);
+    }
+};
+
+struct record_view {
+    record_tag tag;
+    const char* payload;
+    std::size_t size;
+};
+
+static record_view read_record(const char* data, const std::size_t size, const std::size_t offset)
+{
+    if (offset > size)
+        throw std::runtime_error("fmtdxc: record offset out of dawxchange container");
+    byte_reader _reader { data, size, offset };
+    record_view _record;
+    _record.tag = static_cast<record_tag>(_reader.u32());
+    _record.size = static_cast<std::size_t>(_reader.u64());
+    _record.payload = _reader.bytes(_record.size);
+    if (_reader.u32() != crc32(_record.payload, _record.size))
+        throw std::runtime_error("fmtdxc: corrupted record in dawxchange container");
+    return _record;
+}
+
+// ---------- columnar encoding ----------
+//
+// payloads of version::alpha_columnar. Integers are varints, ticks of notes are zigzag deltas from
+// the previous note and ids are deltas from the previous id. Records of sparse projects start with
+// a presence bitmap of their fields instead of one optional tag per field, and the notes of a
+// midi clip are written column by column. Payloads of version::alpha_interned write strings and
+// paths as indices into the string table of the container
+
+static void put_varint(std::string& out, std::uint64_t value)
+{
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static std::uint64_t zigzag(const std::int64_t value)
+{
+    return (static_cast<std::uint64_t>(value) << 1) ^ static_cast<std::uint64_t>(value >> 63);
+}
+
+static std::int64_t unzigzag(const std::uint64_t value)
+{
+    return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+static void encode_field(std::string& out, const bool value)
+{
+    out.push_back(value ? 1 : 0);
+}
+
+template <typename T, std::enable_if_t<std::is_unsigned_v<T>, int> = 0>
+static void encode_field(std::string& out, const T value)
+{
+    put_varint(out, value);
+}
+
+static void encode_field(std::string& out, const float value)
+{
+    std::uint32_t _bits;
+    std::memcpy(&_bits, &value, sizeof(_bits));
+    put_u32(out, _bits);
+}
+
+static void encode_field(std::string& out, const double value)
+{
+    std::uint64_t _bits;
+    std::memcpy(&_bits, &value, sizeof(_bits));
+    put_u64(out, _bits);
+}
+
+// table of the payload that the calling thread encodes or decodes, null when strings are written inline
+static string_table*& get_thread_strings()
+{
+    thread_local string_table* _strings = nullptr;
+    return _strings;
+}
+
+struct strings_scope {
+    strings_scope(string_table* strings)
+        : _previous(get_thread_strings())
+    {
+        get_thread_strings() = strings;
+    }
+    strings_scope(const strings_scope& other) = delete;
+    strings_scope& operator=(const strings_scope& other) = delete;
+    ~strings_scope() { get_thread_strings() = _previous; }
+
+private:
+    string_table* _previous;
+};
+
+static void encode_field(std::string& out, const std::string& value)
+{
+    if (string_table* _strings = get_thread_strings()) {
+        put_varint(out, _strings->insert(value));
+        return;
+    }
+    put_varint(out, value.size());
+    out.append(value);
+}
+
+static void encode_field(std::string& out, const std::filesystem::path& value)
+{
+    encode_field(out, value.generic_u8string());
+}
+
+template <typename T>
+static void encode_field(std::string& out, const interned<T>& value)
+{
+    encode_field(out, value.get());
+}
+
+static void encode_field(std::string& out, const blob_digest& value)
+{
+    put_digest(out, value);
+}
+
+template <typename T>
+static void encode_field(std::string& out, const std::optional<T>& value)
+{
+    // presence is written in the bitmap of the record
+    if (value)
+        encode_field(out, *value);
+}
+
+static void decode_field(byte_reader& in, bool& value)
+{
+    value = *in.bytes(1) != 0;
+}
+
+template <typename T, std::enable_if_t<std::is_unsigned_v<T>, int> = 0>
+static void decode_field(byte_reader& in, T& value)
+{
+    value = static_cast<T>(in.varint());
+}
+
+static void decode_field(byte_reader& in, float& value)
+{
+    const std::uint32_t _bits = in.u32();
+    std::memcpy(&value, &_bits, sizeof(value));
+}
+
+static void decode_field(byte_reader& in, double& value)
+{
+    const std::uint64_t _bits = in.u64();
+    std::memcpy(&value, &_bits, sizeof(value));
+}
+
+static void decode_field(byte_reader& in, std::string& value)
+{
+    if (const string_table* _strings = get_thread_strings()) {
+        value = _strings->at(in.varint());
+        return;
+    }
+    const std::uint64_t _size = in.varint();
+    in.require(_size);
+    value.assign(in.bytes(_size), _size);
+}
+
+static void decode_field(byte_reader& in, std::filesystem::path& value)
+{
+    std::string _path;
+    decode_field(in, _path);
+    value = std::filesystem::u8path(_path);
+}
+
+template <typename T>
+static void decode_field(byte_reader& in, interned<T>& value)
+{
+    T _value;
+    decode_field(in, _value);
+    value = std::move(_value);
+}
+
+static void decode_field(byte_reader& in, blob_digest& value)
+{
+    value = in.digest();
+}
+
+template <typename T>
+static void decode_field(byte_reader& in, T& value, const bool present)
+{
+    if constexpr (is_optional<T>::value) {
+        if (present)
+            decode_field(in, value.emplace());
+        else
+            value.reset();
+    } else {
+        decode_field(in, value);
+    }
+}
+
+template <typename T>
+static bool has_field(const T& value)
+{
+    if constexpr (is_optional<T>::value)
+        return value.has_value();
+    else
+        return true;
+}
+
+// note operations of sparse midi clips follow their other fields, their presence bit is never set by containers
+// written before they existed
+static bool has_field(const std::vector<midi_note_operation>& value)
+{
+    return !value.empty();
+}
+
+static void encode_field(std::string& out, const std::vector<midi_note_operation>& value)
+{
+    // presence is written in the bitmap of the record
+    if (value.empty())
+        return;
+    put_varint(out, value.size());
+    for (auto& _operation : value) {
+        put_varint(out, _operation.first_note);
+        put_varint(out, _operation.last_note - _operation.first_note);
+        put_varint(out, zigzag(_operation.start_delta));
+        put_varint(out, zigzag(_operation.pitch_delta));
+    }
+}
+
+static void decode_field(byte_reader& in, std::vector<midi_note_operation>& value, const bool present)
+{
+    value.clear();
+    if (!present)
+        return;
+    const std::uint64_t _count = in.varint();
+    in.require(_count);
+    value.resize(static_cast<std::size_t>(_count));
+    for (auto& _operation : value) {
+        _operation.first_note = static_cast<std::uint32_t>(in.varint());
+        const std::uint64_t _span = in.varint();
+        if (_span > std::numeric_limits<std::uint32_t>::max() - _operation.first_note)
+            throw std::runtime_error("fmtdxc: invalid midi note operation in dawxchange container");
+        _operation.last_note = _operation.first_note + static_cast<std::uint32_t>(_span);
+        _operation.start_delta = unzigzag(in.varint());
+        _operation.pitch_delta = static_cast<std::int32_t>(unzigzag(in.varint()));
+    }
+}
+
+template <typename map_t, typename encode_t>
+static void encode_map(std::string& out, const map_t& entities, encode_t&& encode_entity)
+{
+    put_varint(out, entities.size());
+    std::uint32_t _previous = 0;
+    for (auto& [id, entity] : entities) {
+        put_varint(out, id - _previous);
+        _previous = id;
+        encode_entity(out, entity);
+    }
+}
+
+template <typename map_t, typename decode_t>
+static void decode_map(byte_reader& in, map_t& entities, decode_t&& decode_entity)
+{
+    entities.clear();
+    const std::uint64_t _count = in.varint();
+    std::uint32_t _id = 0;
+    for (std::uint64_t _entity = 0; _entity < _count; ++_entity) {
+        _id += static_cast<std::uint32_t>(in.varint());
+        auto& _value = entities.emplace_hint(entities.end(), _id, typename map_t::mapped_type {})->second;
+        decode_entity(in, _value);
+    }
+}
+
+// values of a record, with the note operations of sparse midi clips but without its maps of child entities
+template <typename T>
+static constexpr bool is_columnar_member = !is_entity_map<T>::value && !std::is_same_v<T, std::monostate>;
+
+// sparse records start with a presence bitmap over their values in the order of their field list
+template <typename record_t>
+static void encode_record_fields(std::string& out, const record_t& value)
+{
+    if constexpr (record_fields<record_t>::is_sparse) {
+        std::uint64_t _presence = 0;
+        std::uint64_t _bit = 1;
+        record_fields<record_t>::visit([&](const char*, auto&& field) {
+            if constexpr (is_columnar_member<member_type<decltype(field(value))>>) {
+                _presence |= has_field(field(value)) ? _bit : 0;
+                _bit <<= 1;
+            }
+        });
+        put_varint(out, _presence);
+    }
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        if constexpr (is_columnar_member<member_type<decltype(field(value))>>)
+            encode_field(out, field(value));
+    });
+}
+
+template <typename record_t>
+static void decode_record_fields(byte_reader& in, record_t& value)
+{
+    std::uint64_t _presence = ~std::uint64_t(0);
+    if constexpr (record_fields<record_t>::is_sparse)
+        _presence = in.varint();
+    std::uint64_t _bit = 1;
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        if constexpr (is_columnar_member<member_type<decltype(field(value))>>) {
+            decode_field(in, field(value), (_presence & _bit) != 0);
+            _bit <<= 1;
+        }
+    });
+}
+
+template <typename record_t, std::enable_if_t<record_fields<record_t>::is_record, int> = 0>
+static void encode_field(std::string& out, const record_t& value)
+{
+    encode_record_fields(out, value);
+}
+
+template <typename record_t, std::enable_if_t<record_fields<record_t>::is_record, int> = 0>
+static void decode_field(byte_reader& in, record_t& value)
+{
+    decode_record_fields(in, value);
+}
+
+template <typename mpe_t>
+static bool has_mpe(const mpe_t& value)
+{
+    if constexpr (is_optional<mpe_t>::value)
+        return value.has_value();
+    else
+        return !is_default_record(value);
+}
+
+// the value of a field that is present, whether the record is sparse or not
+template <typename T>
+static decltype(auto) field_value(T& value)
+{
+    if constexpr (is_optional<std::remove_const_t<T>>::value)
+        return (*value);
+    else
+        return (value);
+}
+
+// note presence bits of sparse columns
+enum : std::uint8_t {
+    note_start_tick = 1 << 0,
+    note_length_ticks = 1 << 1,
+    note_pitch = 1 << 2,
+    note_velocity = 1 << 3
+};
+
+template <typename notes_t>
+static void encode_notes(std::string& out, const notes_t& notes)
+{
+    using note_t = typename notes_t::mapped_type;
+    constexpr bool _sparse = is_optional<decltype(note_t::start_tick)>::value;
+
+    put_varint(out, notes.size());
+    std::uint32_t _previous = 0;
+    for (auto& [id, note] : notes) {
+        put_varint(out, id - _previous);
+        _previous = id;
+    }
+    if constexpr (_sparse) {
+        for (auto& [id, note] : notes)
+            out.push_back(static_cast<char>((note.start_tick ? note_start_tick : 0) | (note.length_ticks ? note_length_ticks : 0) | (note.pitch ? note_pitch : 0) | (note.velocity ? note_velocity : 0)));
+    }
+    // deltas wrap in unsigned arithmetic so that ticks above INT64_MAX round trip too
+    std::uint64_t _tick = 0;
+    for (auto& [id, note] : notes) {
+        if (has_field(note.start_tick)) {
+            const std::uint64_t _start = field_value(note.start_tick);
+            put_varint(out, zigzag(static_cast<std::int64_t>(_start - _tick)));
+            _tick = _start;
+        }
+    }
+    for (auto& [id, note] : notes)
+        if (has_field(note.length_ticks))
+            encode_field(out, field_value(note.length_ticks));
+    for (auto& [id, note] : notes)
+        if (has_field(note.pitch))
+            encode_field(out, field_value(note.pitch));
+    for (auto& [id, note] : notes)
+        if (has_field(note.velocity))
+            encode_field(out, field_value(note.velocity));
+
+    // expressions are rare, they follow as note indices and records
+    std::size_t _mpe_count = 0;
+    for (auto& [id, note] : notes)
+        _mpe_count += has_mpe(note.mpe) ? 1 : 0;
+    put_varint(out, _mpe_count);
+    std::size_t _index = 0;
+    std::size_t _previous_index = 0;
+    for (auto& [id, note] : notes) {
+        if (has_mpe(note.mpe)) {
+            put_varint(out, _index - _previous_index);
+            _previous_index = _index;
+            encode_record_fields(out, field_value(note.mpe));
+        }
+        ++_index;
+    }
+}
+
+template <typename notes_t>
+static void decode_notes(byte_reader& in, notes_t& notes)
+{
+    using note_t = typename notes_t::mapped_type;
+    constexpr bool _sparse = is_optional<decltype(note_t::start_tick)>::value;
+
+    notes.clear();
+    const std::uint64_t _count = in.varint();
+    in.require(_count);
+    std::uint32_t _id = 0;
+    for (std::uint64_t _note = 0; _note < _count; ++_note) {
+        _id += static_cast<std::uint32_t>(in.varint());
+        notes.emplace_hint(notes.end(), _id, note_t {});
+    }
+    if (notes.size() != _count)
+        throw std::runtime_error("fmtdxc: duplicate note ids in dawxchange container");
+    // flat maps may move notes while inserting, pointers are taken once every note exists
+    std::vector<note_t*> _notes;
+    _notes.reserve(notes.size());
+    for (auto& [id, note] : notes)
+        _notes.push_back(&note);
+    std::vector<std::uint8_t> _presence(_notes.size(), note_start_tick | note_length_ticks | note_pitch | note_velocity);
+    if constexpr (_sparse) {
+        const char* _bytes = in.bytes(_notes.size());
+        std::copy(_bytes, _bytes + _notes.size(), _presence.begin());
+    }
+    std::uint64_t _tick = 0;
+    for (std::size_t _note = 0; _note < _notes.size(); ++_note) {
+        if (_presence[_note] & note_start_tick) {
+            _tick += static_cast<std::uint64_t>(unzigzag(in.varint()));
+            _notes[_note]->start_tick = _tick;
+        }
+    }
+    for (std::size_t _note = 0; _note < _notes.size(); ++_note)
+        decode_field(in, _notes[_note]->length_ticks, (_presence[_note] & note_length_ticks) != 0);
+    for (std::size_t _note = 0; _note < _notes.size(); ++_note)
+        decode_field(in, _notes[_note]->pitch, (_presence[_note] & note_pitch) != 0);
+    for (std::size_t _note = 0; _note < _notes.size(); ++_note)
+        decode_field(in, _notes[_note]->velocity, (_presence[_note] & note_velocity) != 0);
+
+    const std::uint64_t _mpe_count = in.varint();
+    std::size_t _index = 0;
+    for (std::uint64_t _mpe = 0; _mpe < _mpe_count; ++_mpe) {
+        _index += static_cast<std::size_t>(in.varint());
+        if (_index >= _notes.size())
+            throw std::runtime_error("fmtdxc: invalid note expression in dawxchange container");
+        auto& _note = *_notes[_index];
+        if constexpr (_sparse)
+            _note.mpe.emplace();
+        decode_record_fields(in, field_value(_note.mpe));
+    }
+}
+
+template <typename clip_t>
+static void encode_midi_clip(std::string& out, const clip_t& value)
+{
+    encode_record_fields(out, value);
+    encode_notes(out, value.notes);
+}
+
+template <typename clip_t>
+static void decode_midi_clip(byte_reader& in, clip_t& value)
+{
+    decode_record_fields(in, value);
+    decode_notes(in, value.notes);
+}
+
+template <typename sequencer_t>
+static void encode_audio_sequencer(std::string& out, const sequencer_t& value)
+{
+    encode_record_fields(out, value);
+    encode_map(out, value.clips, encode_record_fields<typename decltype(value.clips)::mapped_type>);
+}
+
+template <typename sequencer_t>
+static void decode_audio_sequencer(byte_reader& in, sequencer_t& value)
+{
+    decode_record_fields(in, value);
+    decode_map(in, value.clips, decode_record_fields<typename decltype(value.clips)::mapped_type>);
+}
+
+template <typename sequencer_t>
+static void encode_midi_sequencer(std::string& out, const sequencer_t& value)
+{
+    encode_record_fields(out, value);
+    encode_map(out, value.clips, encode_midi_clip<typename decltype(value.clips)::mapped_type>);
+}
+
+template <typename sequencer_t>
+static void decode_midi_sequencer(byte_reader& in, sequencer_t& value)
+{
+    decode_record_fields(in, value);
+    decode_map(in, value.clips, decode_midi_clip<typename decltype(value.clips)::mapped_type>);
+}
+
+template <typename track_t>
+static void encode_mixer_track(std::string& out, const track_t& value)
+{
+    encode_record_fields(out, value);
+    encode_map(out, value.effects, encode_record_fields<typename decltype(value.effects)::mapped_type>);
+    encode_map(out, value.routings, encode_record_fields<typename decltype(value.routings)::mapped_type>);
+}
+
+template <typename track_t>
+static void decode_mixer_track(byte_reader& in, track_t& value)
+{
+    decode_record_fields(in, value);
+    decode_map(in, value.effects, decode_record_fields<typename decltype(value.effects)::mapped_type>);
+    decode_map(in, value.routings, decode_record_fields<typename decltype(value.routings)::mapped_type>);
+}
+
+template <bool sparse_t>
+static void encode_columnar(std::string& out, const basic_project<sparse_t>& value)
+{
+    using project_t = basic_project<sparse_t>;
+    encode_record_fields(out, value);
+    encode_map(out, value.audio_sequencers, encode_audio_sequencer<typename project_t::audio_sequencer>);
+    encode_map(out, value.midi_sequencers, encode_midi_sequencer<typename project_t::midi_sequencer>);
+    encode_map(out, value.mixer_tracks, encode_mixer_track<typename project_t::mixer_track>);
+    encode_map(out, value.collected_audio_files, encode_record_fields<typename project_t::collected_audio_file>);
+}
+
+template <bool sparse_t>
+static void decode_columnar(byte_reader& in, basic_project<sparse_t>& value)
+{
+    using project_t = basic_project<sparse_t>;
+    decode_record_fields(in, value);
+    decode_map(in, value.audio_sequencers, decode_audio_sequencer<typename project_t::audio_sequencer>);
+    decode_map(in, value.midi_sequencers, decode_midi_sequencer<typename project_t::midi_sequencer>);
+    decode_map(in, value.mixer_tracks, decode_mixer_track<typename project_t::mixer_track>);
+    decode_map(in, value.collected_audio_files, decode_record_fields<typename project_t::collected_audio_file>);
+}
+
+static bool is_columnar(const version ver)
+{
+    return ver == version::alpha_columnar || ver == version::alpha_interned;
+}
+
+static bool is_interned(const version ver)
+{
+    return ver == version::alpha_interned;
+}
+
+template <typename value_t>
+static std::string encode_payload(const value_t& value, const version ver, string_table* strings)
+{
+    std::string _payload;
+    if (is_columnar(ver)) {
+        strings_scope _scope(is_interned(ver) ? strings : nullptr);
+        encode_columnar(_payload, value);
+    } else {
+        std::ostringstream _stream(std::ios::binary);
+        {
+            cereal::BinaryOutputArchive _archive(_stream);
+            serialize_payload(_archive, const_cast<value_t&>(value));
+        }
+        _payload = std::move(_stream).str();
+    }
+    FMTDXC_COUNT(bytes_encoded, _payload.size());
+    return _payload;
+}
+
+template <typename value_t>
+static void decode_payload(const char* data, const std::size_t size, value_t& value, const version ver, string_table* strings)
+{
+    FMTDXC_COUNT(bytes_decoded, size);
+    if (is_columnar(ver)) {
+        strings_scope _scope(is_interned(ver) ? strings : nullptr);
+        byte_reader _reader { data, size, 0 };
+        decode_columnar(_reader, value);
+        return;
+    }
+    span_streambuf _buffer(data, size);
+    std::istream _stream(&_buffer);
+    cereal::BinaryInputArchive _archive(_stream);
+    serialize_payload(_archive, value);
+}
+
+static project_commit decode_commit(const record_view& record, const version ver, string_table* strings)
+{
+    if (record.tag != record_tag::commit)
+        throw std::runtime_error("fmtdxc: expected a commit record in dawxchange container");
+    byte_reader _reader { record.payload, record.size, 0 };
+    return make_commit([&](project_commit& _commit) {
+        _commit.message = _reader.string();
+        _commit.timestamp = from_nanoseconds(_reader.i64());
+        const std::uint64_t _forward_size = _reader.u64();
+        decode_payload(_reader.bytes(_forward_size), _forward_size, _commit.forward, ver, strings);
+        const std::uint64_t _backward_size = _reader.u64();
+        decode_payload(_reader.bytes(_backward_size), _backward_size, _commit.backward, ver, strings);
+    });
+}
+
+// writes indexed snapshots and journals record by record, without seeking unless the stream allows it.
+// Strings that version::alpha_interned payloads added to the table after the first written one are
+// written in a strings record before the index or journal record
+struct record_writer {
+    record_writer(std::ostream& stream, const std::uint64_t offset, const version ver, string_table& strings, const std::size_t written)
+        : _stream(stream)
+        , _start(stream.tellp())
+        , _offset(offset)
+        , _project_offset(0)
+        , _version(ver)
+        , _strings(strings)
+        , _strings_written(written)
+    {
+    }
+
+    void write_header()
+    {
+        std::string _header(container_magic, sizeof(container_magic));
+        put_u32(_header, static_cast<std::uint32_t>(_version));
+        put_u64(_header, 0);
+        _write(_header.data(), _header.size());
+    }
+
+    void write_project(const project& value)
+    {
+        _project_offset = _offset;
+        _write_record(record_tag::project, encode_payload(value, _version, &_strings));
+    }
+
+    void write_commit(const project_commit& value)
+    {
+        std::string _payload;
+        put_string(_payload, value.message);
+        put_u64(_payload, static_cast<std::uint64_t>(to_nanoseconds(value.timestamp)));
+        const std::string _forward = encode_payload(value.forward, _version, &_strings);
+        put_u64(_payload, _forward.size());
+        _payload.append(_forward);
+        const std::string _backward = encode_payload(value.backward, _version, &_strings);
+        put_u64(_payload, _backward.size());
+        _payload.append(_backward);
+        _entries.push_back({ _offset, value.message, to_nanoseconds(value.timestamp) });
+        _write_record(record_tag::commit, _payload);
+    }
+
+    // copies a commit record that was not decoded as is
+    void write_commit(const record_view& record, const std::string& message, const std::chrono::time_point<std::chrono::system_clock>& timestamp)
+    {
+        _entries.push_back({ _offset, message, to_nanoseconds(timestamp) });
+        _write_record(record_tag::commit, record.payload, record.size);
+    }
+
+    void finish_snapshot(const std::size_t applied)
+    {
+        const std::uint64_t _strings_offset = _write_strings();
+        const std::uint64_t _index_offset = _offset;
+        std::string _index;
+        put_u64(_index, applied);
+        put_u64(_index, _project_offset);
+        _put_entries(_index, _strings_offset);
+        _write_record(record_tag::index, _index.data(), _index.size());
+
+        std::string _trailer;
+        put_u64(_trailer, _index_offset);
+        _trailer.append(index_magic, sizeof(index_magic));
+        _write(_trailer.data(), _trailer.size());
+
+        // readers find the trailer from the snapshot size, journals may be appended after it
+        if (_start != std::streampos(-1)) {
+            const std::streampos _end = _stream.tellp();
+            std::string _size;
+            put_u64(_size, _offset);
+            _stream.seekp(_start + std::streamoff(8));
+            _stream.write(_size.data(), _size.size());
+            _stream.seekp(_end);
+        }
+        _flush();
+    }
+
+    // the journal record commits the commit records written before it, readers drop commit records that are not followed by one
+    void finish_journal(const std::size_t kept, const std::size_t applied)
+    {
+        const std::uint64_t _strings_offset = _write_strings();
+        std::string _journal;
+        put_u64(_journal, kept);
+        put_u64(_journal, applied);
+        _put_entries(_journal, _strings_offset);
+        _write_record(record_tag::journal, _journal.data(), _journal.size());
+        _flush();
+    }
+
+    void write_chunk(const blob_digest& digest, const char* data, const std::size_t size)
+    {
+        _chunk_entries.push_back({ digest, _offset });
+        std::string _payload(reinterpret_cast<const char*>(digest.bytes.data()), digest.bytes.size());
+        _payload.append(data, size);
+        _write_record(record_tag::chunk, _payload);
+    }
+
+    // copies a chunk record from the mapped file as is
+    void write_chunk(const blob_digest& digest, const record_view& record)
+    {
+        _chunk_entries.push_back({ digest, _offset });
+        _write_record(record_tag::chunk, record.payload, record.size);
+    }
+
+    void write_blob(const blob_digest& digest, const std::uint64_t size, const std::vector<blob_digest>& chunks)
+    {
+        put_digest(_blobs, digest);
+        put_u64(_blobs, size);
+        put_u64(_blobs, chunks.size());
+        for (auto& _chunk : chunks)
+            put_digest(_blobs, _chunk);
+        ++_blob_count;
+    }
+
+    std::uint64_t get_offset() const { return _offset; }
+    version get_version() const { return _version; }
+    std::size_t get_strings_written() const { return _strings_written; }
+
+private:
+    struct index_entry {
+        std::uint64_t offset;
+        std::string message;
+        std::int64_t timestamp;
+    };
+
+    std::ostream& _stream;
+    std::streampos _start;
+    std::uint64_t _offset;
+    std::uint64_t _project_offset;
+    version _version;
+    string_table& _strings;
+    std::size_t _strings_written;
+    std::vector<index_entry> _entries;
+    std::vector<std::pair<blob_digest, std::uint64_t>> _chunk_entries;
+    std::string _blobs;
+    std::uint64_t _blob_count = 0;
+
+    void _write(const char* data, const std::size_t size)
+    {
+        _stream.write(data, size);
+        _offset += size;
+    }
+
+    void _write_record(const record_tag tag, const std::string& payload)
+    {
+        _write_record(tag, payload.data(), payload.size());
+    }
+
+    void _write_record(const record_tag tag, const char* payload, const std::size_t size)
+    {
+        std::string _header;
+        put_u32(_header, static_cast<std::uint32_t>(tag));
+        put_u64(_header, size);
+        _write(_header.data(), _header.size());
+        _write(payload, size);
+        std::string _crc;
+        put_u32(_crc, crc32(payload, size));
+        _write(_crc.data(), _crc.size());
+    }
+
+    // returns the offset of the strings record, or 0 when no string was added
+    std::uint64_t _write_strings()
+    {
+        if (!is_interned(_version) || _strings_written == _strings.values.size())
+            return 0;
+        const std::uint64_t _strings_offset = _offset;
+        std::string _payload;
+        put_u64(_payload, _strings_written);
+        put_u64(_payload, _strings.values.size() - _strings_written);
+        for (std::size_t _index = _strings_written; _index < _strings.values.size(); ++_index)
+            put_string(_payload, _strings.values[_index]);
+        _write_record(record_tag::strings, _payload);
+        _strings_written = _strings.values.size();
+        return _strings_offset;
+    }
+
+    void _put_entries(std::string& out, const std::uint64_t strings_offset) const
+    {
+        put_u64(out, _entries.size());
+        for (auto& _entry : _entries) {
+            put_u64(out, _entry.offset);
+            put_string(out, _entry.message);
+            put_u64(out, static_cast<std::uint64_t>(_entry.timestamp));
+        }
+        put_u64(out, _blob_count);
+        out.append(_blobs);
+        put_u64(out, _chunk_entries.size());
+        for (auto& [digest, offset] : _chunk_entries) {
+            put_digest(out, digest);
+            put_u64(out, offset);
+        }
+        if (is_interned(_version))
+            put_u64(out, strings_offset);
+    }
+
+    void _flush()
+    {
+        _stream.flush();
+        if (!_stream)
+            throw std::runtime_error("fmtdxc: failed to write dawxchange container");
+    }
+};
+
+// bytes of an imported container, memory mapped when the platform allows it
+struct project_container::file_buffer {
+    const char* data = nullptr;
+    std::size_t size = 0;
+    version ver = version::alpha;
+    std::vector<char> owned;
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#elif defined(FMTDXC_POSIX)
+    void* mapped = nullptr;
+#endif
+
+    file_buffer() = default;
+    file_buffer(const file_buffer& other) = delete;
+    file_buffer& operator=(const file_buffer& other) = delete;
+
+    ~file_buffer()
+    {
+#if defined(_WIN32)
+        if (data && owned.empty())
+            UnmapViewOfFile(data);
+        if (mapping)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+#elif defined(FMTDXC_POSIX)
+        if (mapped)
+            munmap(mapped, size);
+#endif
+    }
+};
+
+// progress and cancellation of an asynchronous export, checked after each written record
+struct export_control {
+    const std::atomic<bool>& cancelled;
+    const export_progress& progress;
+    std::size_t total;
+    std::size_t written = 0;
+};
+
+static void step_export(export_control* control)
+{
+    if (!control)
+        return;
+    if (control->cancelled.load(std::memory_order_relaxed))
+        throw std::runtime_error("fmtdxc: export was cancelled");
+    ++control->written;
+    if (control->progress)
+        control->progress(control->written, control->total);
+}
+
+struct container_io {
+
+    static std::shared_ptr<project_container::file_buffer> read_stream(std::istream& stream, const std::string& prefix = {})
+    {
+        auto _buffer = std::make_shared<project_container::file_buffer>();
+        _buffer->owned.assign(prefix.begin(), prefix.end());
+        _buffer->owned.insert(_buffer->owned.end(), std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+        _buffer->data = _buffer->owned.data();
+        _buffer->size = _buffer->owned.size();
+        return _buffer;
+    }
+
+    static std::shared_ptr<project_container::file_buffer> map_file(const std::filesystem::path& path)
+    {
+        auto _buffer = std::make_shared<project_container::file_buffer>();
+#if defined(_WIN32)
+        _buffer->file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (_buffer->file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("fmtdxc: failed to open " + path.string());
+        LARGE_INTEGER _size;
+        GetFileSizeEx(_buffer->file, &_size);
+        _buffer->size = static_cast<std::size_t>(_size.QuadPart);
+        if (_buffer->size) {
+            _buffer->mapping = CreateFileMappingW(_buffer->file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            const void* _view = _buffer->mapping ? MapViewOfFile(_buffer->mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (!_view)
+                throw std::runtime_error("fmtdxc: failed to map " + path.string());
+            _buffer->data = static_cast<const char*>(_view);
+        }
+#elif defined(FMTDXC_POSIX)
+        const int _file = open(path.c_str(), O_RDONLY);
+        if (_file < 0)
+            throw std::runtime_error("fmtdxc: failed to open " + path.string());
+        struct stat _stat;
+        if (fstat(_file, &_stat) == 0 && _stat.st_size > 0) {
+            _buffer->size = static_cast<std::size_t>(_stat.st_size);
+            _buffer->mapped = mmap(nullptr, _buffer->size, PROT_READ, MAP_PRIVATE, _file, 0);
+            if (_buffer->mapped == MAP_FAILED)
+                _buffer->mapped = nullptr;
+            _buffer->data = static_cast<const char*>(_buffer->mapped);
+        }
+        close(_file);
+        if (_buffer->size && !_buffer->data)
+            throw std::runtime_error("fmtdxc: failed to map " + path.string());
+#else
+        std::ifstream _stream(path, std::ios::binary);
+        if (!_stream)
+            throw std::runtime_error("fmtdxc: failed to open " + path.string());
+        return read_stream(_stream);
+#endif
+        return _buffer;
+    }
+
+    static bool is_indexed(const project_container::file_buffer& buffer)
+    {
+        return buffer.size >= header_size && std::equal(container_magic, container_magic + sizeof(container_magic), buffer.data);
+    }
+
+    static void reset(project_container& container)
+    {
+        container._proj = project {};
+        container._applied = 0;
+        container._commits.clear();
+        container._buffer.reset();
+        container._checkpoints.clear();
+        container._journal = {};
+        container._chunks.clear();
+        container._blobs.clear();
+        container._strings = std::make_shared<string_table>();
+        container._gesture.reset();
+        rebuild_intervals(container);
+    }
+
+    static void rebuild_intervals(project_container& container)
+    {
+        if (container._intervals)
+            container._intervals->build(container._proj);
+    }
+
+    template <typename archive_t>
+    static void save_alpha(archive_t& archive, const project_container& container, export_control* control = nullptr)
+    {
+        archive(cereal::make_nvp("project", container._proj));
+        archive(cereal::make_nvp("applied", container._applied));
+        step_export(control);
+        archive(cereal::make_size_tag(static_cast<cereal::size_type>(container._commits.size())));
+        for (std::size_t _index = 0; _index < container._commits.size(); ++_index) {
+            archive(container._load(_index));
+            step_export(control);
+        }
+    }
+
+    template <typename archive_t>
+    static void load_alpha(archive_t& archive, project_container& container)
+    {
+        reset(container);
+        archive(cereal::make_nvp("project", container._proj));
+        archive(cereal::make_nvp("applied", container._applied));
+        rebuild_intervals(container);
+        cereal::size_type _count;
+        archive(cereal::make_size_tag(_count));
+        for (cereal::size_type _index = 0; _index < _count; ++_index) {
+            project_commit _commit = make_commit([&archive](project_commit& _commit) { archive(_commit); });
+            container._commits.push_back({ std::make_shared<const project_commit>(std::move(_commit)), 0, nullptr });
+        }
+    }
+
+    struct snapshot_view {
+        std::size_t size;
+        std::size_t applied;
+        std::size_t project_offset;
+        std::vector<project_container::commit_slot> commits;
+        std::map<blob_digest, project_container::blob_manifest> blobs;
+        std::map<blob_digest, project_container::blob_chunk> chunks;
+        std::uint64_t strings_offset;
+    };
+
+    static std::vector<project_container::commit_slot> read_entries(byte_reader& reader)
+    {
+        const std::uint64_t _count = reader.u64();
+        std::vector<project_container::commit_slot> _commits;
+        _commits.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(_count, reader.size)));
+        for (std::uint64_t _entry = 0; _entry < _count; ++_entry) {
+            auto _commit = std::make_shared<project_commit>();
+            const std::uint64_t _offset = reader.u64();
+            _commit->message = reader.string();
+            _commit->timestamp = from_nanoseconds(reader.i64());
+            _commits.push_back({ std::move(_commit), _offset, std::make_shared<project_container::decoded_commit>() });
+        }
+        return _commits;
+    }
+
+    // blob manifests and chunk records that follow the commit entries of index and journal records
+    static void read_blobs(byte_reader& reader, const project_container::file_buffer& buffer, std::map<blob_digest, project_container::blob_manifest>& blobs, std::map<blob_digest, project_container::blob_chunk>& chunks)
+    {
+        if (reader.position == reader.size)
+            return;
+        const std::uint64_t _blob_count = reader.u64();
+        for (std::uint64_t _blob = 0; _blob < _blob_count; ++_blob) {
+            const blob_digest _digest = reader.digest();
+            project_container::blob_manifest _manifest;
+            _manifest.size = reader.u64();
+            const std::uint64_t _chunk_count = reader.u64();
+            _manifest.chunks.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(_chunk_count, reader.size)));
+            for (std::uint64_t _chunk = 0; _chunk < _chunk_count; ++_chunk)
+                _manifest.chunks.push_back(reader.digest());
+            blobs.emplace(_digest, std::move(_manifest));
+        }
+        const std::uint64_t _chunk_count = reader.u64();
+        for (std::uint64_t _chunk = 0; _chunk < _chunk_count; ++_chunk) {
+            const blob_digest _digest = reader.digest();
+            const std::uint64_t _offset = reader.u64();
+            byte_reader _header { buffer.data, buffer.size, static_cast<std::size_t>(_offset) + 4 };
+            const std::uint64_t _size = _header.u64();
+            if (_size < sizeof(blob_digest::bytes))
+                throw std::runtime_error("fmtdxc: invalid chunk record in dawxchange container");
+            chunks.emplace(_digest, project_container::blob_chunk { nullptr, _offset, static_cast<std::size_t>(_size - sizeof(blob_digest::bytes)) });
+        }
+    }
+
+    // appends the strings of a strings record to the table, the record continues the table where the previous one ended
+    static void read_strings(const project_container::file_buffer& buffer, const std::uint64_t offset, string_table& strings)
+    {
+        if (!offset)
+            return;
+        const record_view _record = read_record(buffer.data, buffer.size, static_cast<std::size_t>(offset));
+        if (_record.tag != record_tag::strings)
+            throw std::runtime_error("fmtdxc: expected a strings record in dawxchange container");
+        byte_reader _reader { _record.payload, _record.size, 0 };
+        const std::uint64_t _first = _reader.u64();
+        const std::uint64_t _count = _reader.u64();
+        if (_first != strings.values.size())
+            throw std::runtime_error("fmtdxc: invalid string table in dawxchange container");
+        for (std::uint64_t _string = 0; _string < _count; ++_string)
+            if (strings.insert(_reader.string()) + 1 != strings.values.size())
+                throw std::runtime_error("fmtdxc: invalid string table in dawxchange container");
+    }
+
+    static snapshot_view read_snapshot(const project_container::file_buffer& buffer, version& ver)
+    {
+        byte_reader _header { buffer.data, buffer.size, sizeof(container_magic) };
+        ver = static_cast<version>(_header.u32());
+        const std::uint64_t _snapshot_size = _header.u64();
+        snapshot_view _snapshot;
+        _snapshot.size = _snapshot_size ? static_cast<std::size_t>(_snapshot_size) : buffer.size;
+        if (_snapshot.size > buffer.size || _snapshot.size < header_size + trailer_size)
+            throw std::runtime_error("fmtdxc: truncated dawxchange container");
+        byte_reader _trailer { buffer.data, _snapshot.size, _snapshot.size - trailer_size };
+        const std::uint64_t _index_offset = _trailer.u64();
+        if (!std::equal(index_magic, index_magic + sizeof(index_magic), _trailer.bytes(sizeof(index_magic))))
+            throw std::runtime_error("fmtdxc: missing index in dawxchange container");
+
+        const record_view _index_record = read_record(buffer.data, _snapshot.size, static_cast<std::size_t>(_index_offset));
+        if (_index_record.tag != record_tag::index)
+            throw std::runtime_error("fmtdxc: expected an index record in dawxchange container");
+        byte_reader _index { _index_record.payload, _index_record.size, 0 };
+        _snapshot.applied = static_cast<std::size_t>(_index.u64());
+        _snapshot.project_offset = static_cast<std::size_t>(_index.u64());
+        _snapshot.commits = read_entries(_index);
+        read_blobs(_index, buffer, _snapshot.blobs, _snapshot.chunks);
+        _snapshot.strings_offset = is_interned(ver) ? _index.u64() : 0;
+        if (_snapshot.applied > _snapshot.commits.size())
+            throw std::runtime_error("fmtdxc: invalid applied count in dawxchange container");
+        return _snapshot;
+    }
+
+    // moves the project over one commit like undo and redo, but decodes the commit for this step only
+    // so that replaying a journal keeps no more than one decoded commit at a time
+    static void replay_step(project_container& container, const bool forward)
+    {
+        const std::size_t _index = forward ? container._applied : container._applied - 1;
+        const std::shared_ptr<const project_commit> _commit = read_commit(container, _index, true);
+        apply(container._proj, forward ? _commit->forward : _commit->backward);
+        container._applied = forward ? container._applied + 1 : _index;
+    }
+
+    static void replay(project_container& container, const std::size_t kept, const std::size_t applied, std::vector<project_container::commit_slot>&& commits)
+    {
+        if (kept > container._commits.size() || applied > kept + commits.size())
+            throw std::runtime_error("fmtdxc: invalid journal record in dawxchange container");
+        while (container._applied > kept)
+            replay_step(container, false);
+        container._commits.erase(container._commits.begin() + kept, container._commits.end());
+        container._commits.insert(container._commits.end(), std::make_move_iterator(commits.begin()), std::make_move_iterator(commits.end()));
+        while (container._applied < applied)
+            replay_step(container, true);
+        while (container._applied > applied)
+            replay_step(container, false);
+    }
+
+    // replays the journal records after the snapshot and returns where the valid journal ends,
+    // records after it are the torn tail of an interrupted append
+    static std::size_t replay_journal(project_container& container, const std::size_t begin)
+    {
+        const project_container::file_buffer& _buffer = *container._buffer;
+        std::size_t _position = begin;
+        std::size_t _end = begin;
+        while (_position < _buffer.size) {
+            record_view _record;
+            try {
+                _record = read_record(_buffer.data, _buffer.size, _position);
+            } catch (const std::runtime_error&) {
+                break;
+            }
+            _position += record_overhead + _record.size;
+            if (_record.tag != record_tag::journal)
+                continue;
+            byte_reader _reader { _record.payload, _record.size, 0 };
+            const std::size_t _kept = static_cast<std::size_t>(_reader.u64());
+            const std::size_t _applied = static_cast<std::size_t>(_reader.u64());
+            std::vector<project_container::commit_slot> _commits = read_entries(_reader);
+            read_blobs(_reader, _buffer, container._blobs, container._chunks);
+            // commits of the journal may refer to its strings
+            if (is_interned(_buffer.ver))
+                read_strings(_buffer, _reader.u64(), *container._strings);
+            replay(container, _kept, _applied, std::move(_commits));
+            _end = _position;
+        }
+        return _end;
+    }
+
+    static void load_indexed(std::shared_ptr<project_container::file_buffer> buffer, project_container& container, version& ver)
+    {
+        snapshot_view _snapshot = read_snapshot(*buffer, ver);
+        buffer->ver = ver;
+        reset(container);
+        const record_view _project_record = read_record(buffer->data, _snapshot.size, _snapshot.project_offset);
+        if (_project_record.tag != record_tag::project)
+            throw std::runtime_error("fmtdxc: expected a project record in dawxchange container");
+        read_strings(*buffer, _snapshot.strings_offset, *container._strings);
+        decode_payload(_project_record.payload, _project_record.size, container._proj, ver, container._strings.get());
+        container._applied = _snapshot.applied;
+        container._commits = std::move(_snapshot.commits);
+        container._blobs = std::move(_snapshot.blobs);
+        container._chunks = std::move(_snapshot.chunks);
+        container._buffer = std::move(buffer);
+        const std::size_t _journal_end = replay_journal(container, _snapshot.size);
+        // the index is built once for the replayed project instead of being updated by every step
+        rebuild_intervals(container);
+        container._journal = { false, container._commits.size(), container._applied, _snapshot.size, _journal_end - _snapshot.size, {}, {}, container._strings->values.size() };
+    }
+
+    static void load_buffer(std::shared_ptr<project_container::file_buffer> buffer, project_container& container, version& ver)
+    {
+        if (is_indexed(*buffer)) {
+            load_indexed(std::move(buffer), container, ver);
+            return;
+        }
+        span_streambuf _span(buffer->data, buffer->size);
+        std::istream _stream(&_span);
+        cereal::BinaryInputArchive _archive(_stream);
+        load_alpha(_archive, container);
+        ver = version::alpha;
+    }
+
+    static void load_file(const std::filesystem::path& path, project_container& container, version& ver)
+    {
+        load_buffer(map_file(path), container, ver);
+        container._journal.attached = ver != version::alpha;
+    }
+
+    // the metadata commit of the slot is kept so that its message stays valid, the decode is retried if it threw
+    static const project_commit& load_commit(const project_container& container, const std::size_t index)
+    {
+        const auto& _slot = container._commits.at(index);
+        if (!_slot.offset)
+            return *_slot.commit;
+        auto& _decoded = *_slot.decoded;
+        std::call_once(_decoded.once, [&container, &_slot, &_decoded]() {
+            const record_view _record = read_record(container._buffer->data, container._buffer->size, static_cast<std::size_t>(_slot.offset));
+            _decoded.commit = std::make_shared<const project_commit>(decode_commit(_record, container._buffer->ver, container._strings.get()));
+        });
+        return *_decoded.commit;
+    }
+
+    // decodes a commit without keeping it in its slot, commits read without patches are not decoded at all
+    static std::shared_ptr<const project_commit> read_commit(const project_container& container, const std::size_t index, const bool patches)
+    {
+        const auto& _slot = container._commits.at(index);
+        if (!patches) {
+            if (_slot.offset)
+                return _slot.commit;
+            auto _commit = std::make_shared<project_commit>();
+            _commit->message = _slot.commit->message;
+            _commit->timestamp = _slot.commit->timestamp;
+            return _commit;
+        }
+        if (!_slot.offset)
+            return _slot.commit;
+        const record_view _record = read_record(container._buffer->data, container._buffer->size, static_cast<std::size_t>(_slot.offset));
+        return std::make_shared<const project_commit>(decode_commit(_record, container._buffer->ver, container._strings.get()));
+    }
+
+    static void write_commit(record_writer& writer, const project_container& container, const std::size_t index)
+    {
+        const auto& _slot = container._commits[index];
+        // records are copied as is when both versions encode payloads the same way, string indices stay
+        // valid because the table of the container starts with the table of its file
+        const version _version = container._buffer ? container._buffer->ver : version::alpha;
+        if (_slot.offset && is_columnar(_version) == is_columnar(writer.get_version()) && is_interned(_version) == is_interned(writer.get_version())) {
+            const record_view _record = read_record(container._buffer->data, container._buffer->size, static_cast<std::size_t>(_slot.offset));
+            writer.write_commit(_record, _slot.commit->message, _slot.commit->timestamp);
+        } else {
+            writer.write_commit(container._load(index));
+        }
+    }
+
+    static record_view read_chunk(const project_container& container, const project_container::blob_chunk& chunk)
+    {
+        const record_view _record = read_record(container._buffer->data, container._buffer->size, static_cast<std::size_t>(chunk.offset));
+        if (_record.tag != record_tag::chunk || _record.size < sizeof(blob_digest::bytes))
+            throw std::runtime_error("fmtdxc: expected a chunk record in dawxchange container");
+        return _record;
+    }
+
+    static void visit_blob(const project_container& container, const blob_digest& digest, const std::function<void(const char*, std::size_t)>& visitor)
+    {
+        for (auto& _digest : container._blobs.at(digest).chunks) {
+            const auto& _chunk = container._chunks.at(_digest);
+            if (_chunk.bytes) {
+                visitor(_chunk.bytes->data(), _chunk.bytes->size());
+            } else {
+                // served from the mapped file without copying
+                const record_view _record = read_chunk(container, _chunk);
+                visitor(_record.payload + sizeof(blob_digest::bytes), _record.size - sizeof(blob_digest::bytes));
+            }
+        }
+    }
+
+    static void write_chunk(record_writer& writer, const project_container& container, const blob_digest& digest)
+    {
+        const auto& _chunk = container._chunks.at(digest);
+        if (_chunk.bytes)
+            writer.write_chunk(digest, _chunk.bytes->data(), _chunk.bytes->size());
+        else
+            writer.write_chunk(digest, read_chunk(container, _chunk));
+    }
+
+    static void write_blob(record_writer& writer, const project_container& container, const blob_digest& digest)
+    {
+        const auto& _manifest = container._blobs.at(digest);
+        writer.write_blob(digest, _manifest.size, _manifest.chunks);
+    }
+
+    static void export_indexed(std::ostream& stream, const project_container& container, const version ver, export_control* control = nullptr)
+    {
+        record_writer _writer(stream, 0, ver, *container._strings, 0);
+        _writer.write_header();
+        _writer.write_project(container._proj);
+        step_export(control);
+        for (std::size_t _index = 0; _index < container._commits.size(); ++_index) {
+            write_commit(_writer, container, _index);
+            step_export(control);
+        }
+        for (auto& [digest, chunk] : container._chunks) {
+            write_chunk(_writer, container, digest);
+            step_export(control);
+        }
+        for (auto& [digest, manifest] : container._blobs)
+            write_blob(_writer, container, digest);
+        _writer.finish_snapshot(container._applied);
+    }
+
+    static void export_stream(std::ostream& stream, const project_container& container, const version ver, export_control* control = nullptr)
+    {
+        if (control)
+            control->total = 1 + container._commits.size() + (ver == version::alpha ? 0 : container._chunks.size());
+        if (ver == version::alpha) {
+            FMTDXC_COUNT_GROWTH(bytes_encoded, std::max<std::streamoff>(stream.tellp(), 0));
+            cereal::BinaryOutputArchive _archive(stream);
+            save_alpha(_archive, container, control);
+        } else {
+            export_indexed(stream, container, ver, control);
+        }
+    }
+
+    // copies what an export reads on the calling thread, the commits and chunks are immutable once written
+    // and are shared. The string table is copied because the export may grow it
+    static std::shared_ptr<const project_container> snapshot(const project_container& container)
+    {
+        auto _snapshot = std::make_shared<project_container>(container._proj);
+        _snapshot->_applied = container._applied;
+        _snapshot->_commits = container._commits;
+        _snapshot->_buffer = container._buffer;
+        _snapshot->_chunks = container._chunks;
+        _snapshot->_blobs = container._blobs;
+        _snapshot->_strings = std::make_shared<string_table>(*container._strings);
+        return _snapshot;
+    }
+
+    static void compact(const std::filesystem::path& path, project_container& container)
+    {
+        std::filesystem::path _temporary = path;
+        _temporary += ".tmp";
+        {
+            std::ofstream _stream(_temporary, std::ios::binary | std::ios::trunc);
+            if (!_stream)
+                throw std::runtime_error("fmtdxc: failed to open " + _temporary.string());
+            // files keep their version, new files use the most compact one
+            export_indexed(_stream, container, container._journal.attached ? container._buffer->ver : version::alpha_interned);
+        }
+        std::filesystem::rename(_temporary, path);
+
+        // points the commits that were not decoded yet to the new file and releases the others
+        auto _buffer = map_file(path);
+        snapshot_view _snapshot = read_snapshot(*_buffer, _buffer->ver);
+        container._commits = std::move(_snapshot.commits);
+        container._blobs = std::move(_snapshot.blobs);
+        container._chunks = std::move(_snapshot.chunks);
+        container._buffer = std::move(_buffer);
+        container._journal = { true, container._commits.size(), container._applied, _snapshot.size, 0, {}, {}, container._strings->values.size() };
+    }
+
+    static void append(const std::filesystem::path& path, project_container& container)
+    {
+        auto& _journal = container._journal;
+        if (!_journal.attached || !std::filesystem::exists(path)) {
+            compact(path, container);
+            return;
+        }
+        if (_journal.synced == container._commits.size() && _journal.applied == container._applied && _journal.pending_blobs.empty())
+            return;
+
+        const std::uint64_t _end = _journal.snapshot_size + _journal.size;
+        const std::uint64_t _file_size = std::filesystem::file_size(path);
+        if (_file_size < _end)
+            throw std::runtime_error("fmtdxc: journaled file was truncated " + path.string());
+        if (_file_size > _end)
+            std::filesystem::resize_file(path, _end);
+        std::ofstream _stream(path, std::ios::binary | std::ios::app);
+        if (!_stream)
+            throw std::runtime_error("fmtdxc: failed to open " + path.string());
+        record_writer _writer(_stream, _end, container._buffer->ver, *container._strings, _journal.strings);
+        for (std::size_t _index = _journal.synced; _index < container._commits.size(); ++_index)
+            write_commit(_writer, container, _index);
+        for (auto& _digest : _journal.pending_chunks)
+            write_chunk(_writer, container, _digest);
+        for (auto& _digest : _journal.pending_blobs)
+            write_blob(_writer, container, _digest);
+        _writer.finish_journal(_journal.synced, container._applied);
+        _journal.pending_chunks.clear();
+        _journal.pending_blobs.clear();
+        _journal.size = _writer.get_offset() - _journal.snapshot_size;
+        _journal.synced = container._commits.size();
+        _journal.applied = container._applied;
+        _journal.strings = _writer.get_strings_written();
+    }
+};
+
+const project_commit& project_container::_load(const std::size_t index) const
+{
+    return container_io::load_commit(*this, index);
+}
+
+void project_container::visit_blob(const blob_digest& digest, const std::function<void(const char*, std::size_t)>& visitor) const
+{
+    container_io::visit_blob(*this, digest, visitor);
+}
+
+void import_container(std::istream& stream, project_container& container, version& ver)
+{
+    FMTDXC_PHASE(import_container);
+    const std::streampos _start = stream.tellg();
+    char _magic[sizeof(container_magic)] = {};
+    if (_start != std::streampos(-1) && stream.read(_magic, sizeof(_magic)) && !std::equal(container_magic, container_magic + sizeof(container_magic), _magic)) {
+        stream.seekg(_start);
+        FMTDXC_COUNT_GROWTH(bytes_decoded, std::max<std::streamoff>(stream.tellg(), 0));
+        cereal::BinaryInputArchive _archive(stream);
+        container_io::load_alpha(_archive, container);
+        ver = version::alpha;
+        return;
+    }
+    // indexed containers and streams that can not seek back are read in memory first
+    const std::string _prefix(_magic, _start == std::streampos(-1) ? 0 : static_cast<std::size_t>(stream.gcount()));
+    stream.clear();
+    container_io::load_buffer(container_io::read_stream(stream, _prefix), container, ver);
+}
+
+void import_container(const std::filesystem::path& path, project_container& container, version& ver)
+{
+    FMTDXC_PHASE(import_container);
+    container_io::load_file(path, container, ver);
+}
+
+void export_container(std::ostream& stream, const project_container& container, const version& ver)
+{
+    FMTDXC_PHASE(export_container);
+    container_io::export_stream(stream, container, ver);
+}
+
+export_task::export_task(std::future<void>&& result, std::shared_ptr<std::atomic<bool>> cancelled)
+    : _future(std::move(result))
+    , _cancelled(std::move(cancelled))
+{
+}
+
+std::future<void>& export_task::get_future() { return _future; }
+
+void export_task::cancel() { _cancelled->store(true, std::memory_order_relaxed); }
+
+export_task export_container_async(std::ostream& stream, const project_container& container, const version& ver, const export_progress& progress)
+{
+    std::shared_ptr<const project_container> _snapshot = container_io::snapshot(container);
+    auto _cancelled = std::make_shared<std::atomic<bool>>(false);
+    std::future<void> _result = std::async(std::launch::async, [&stream, _snapshot, _cancelled, ver, progress]() {
+        FMTDXC_PHASE(export_container);
+        export_control _control { *_cancelled, progress, 0 };
+        container_io::export_stream(stream, *_snapshot, ver, &_control);
+    });
+    return export_task(std::move(_result), std::move(_cancelled));
+}
+
+void append_journal(const std::filesystem::path& path, project_container& container)
+{
+    FMTDXC_PHASE(append_journal);
+    container_io::append(path, container);
+}
+
+void compact_container(const std::filesystem::path& path, project_container& container)
+{
+    FMTDXC_PHASE(compact_container);
+    container_io::compact(path, container);
+}
+
+// ---------- streaming conversion ----------
+
+// reads the bytes consumed to detect the container version again before the rest of the stream,
+// so that streams which can not seek back are read in order
+struct prefixed_streambuf : std::streambuf {
+    prefixed_streambuf(const std::string& prefix, std::streambuf* source)
+        : _prefix(prefix)
+        , _source(source)
+    {
+        setg(_prefix.data(), _prefix.data(), _prefix.data() + _prefix.size());
+    }
+
+protected:
+    int_type underflow() override
+    {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        const std::streamsize _count = _source->sgetn(_buffer.data(), _buffer.size());
+        if (_count <= 0)
+            return traits_type::eof();
+        setg(_buffer.data(), _buffer.data(), _buffer.data() + _count);
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    std::string _prefix;
+    std::streambuf* _source;
+    std::array<char, 64 * 1024> _buffer;
+};
+
+struct container_reader::state {
+    version ver = version::alpha;
+    project proj;
+    std::size_t applied = 0;
+    std::size_t count = 0;
+    std::size_t index = 0;
+
+    // version::alpha containers are decoded in order from the stream
+    std::ifstream file;
+    std::unique_ptr<prefixed_streambuf> prefixed;
+    std::unique_ptr<std::istream> stream;
+    std::unique_ptr<cereal::BinaryInputArchive> archive;
+
+    // other versions are mapped, streams are spooled to a temporary file first
+    project_container container;
+    std::filesystem::path spooled;
+
+    ~state()
+    {
+        container_io::reset(container);
+        if (!spooled.empty()) {
+            std::error_code _error;
+            std::filesystem::remove(spooled, _error);
+        }
+    }
+
+    void read_alpha(std::istream& input, const std::string& prefix)
+    {
+        prefixed = std::make_unique<prefixed_streambuf>(prefix, input.rdbuf());
+        stream = std::make_unique<std::istream>(prefixed.get());
+        archive = std::make_unique<cereal::BinaryInputArchive>(*stream);
+        (*archive)(cereal::make_nvp("project", proj));
+        (*archive)(cereal::make_nvp("applied", applied));
+        cereal::size_type _count;
+        (*archive)(cereal::make_size_tag(_count));
+        count = static_cast<std::size_t>(_count);
+        if (applied > count)
+            throw std::runtime_error("fmtdxc: invalid applied count in dawxchange container");
+    }
+
+    void read_indexed(const std::filesystem::path& path)
+    {
+        container_io::load_file(path, container, ver);
+        applied = container.get_applied_count();
+        count = container.get_commit_count();
+    }
+};
+
+static std::string read_magic(std::istream& stream)
+{
+    char _magic[sizeof(container_magic)] = {};
+    stream.read(_magic, sizeof(_magic));
+    return std::string(_magic, static_cast<std::size_t>(stream.gcount()));
+}
+
+static bool is_indexed_magic(const std::string& magic)
+{
+    return magic.size() == sizeof(container_magic) && std::equal(container_magic, container_magic + sizeof(container_magic), magic.data());
+}
+
+container_reader::container_reader(const std::filesystem::path& path)
+    : _state(std::make_unique<state>())
+{
+    _state->file.open(path, std::ios::binary);
+    if (!_state->file)
+        throw std::runtime_error("fmtdxc: failed to open " + path.string());
+    const std::string _magic = read_magic(_state->file);
+    if (is_indexed_magic(_magic)) {
+        _state->file.close();
+        _state->read_indexed(path);
+    } else {
+        _state->file.clear();
+        _state->read_alpha(_state->file, _magic);
+    }
+}
+
+container_reader::container_reader(std::istream& stream)
+    : _state(std::make_unique<state>())
+{
+    const std::string _magic = read_magic(stream);
+    stream.clear();
+    if (!is_indexed_magic(_magic)) {
+        _state->read_alpha(stream, _magic);
+        return;
+    }
+    const auto _stamp = std::chrono::steady_clock::now().time_since_epoch().count();
+    const std::size_t _thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    _state->spooled = std::filesystem::temp_directory_path() / ("fmtdxc-" + std::to_string(_thread) + "-" + std::to_string(_stamp) + ".dxcc");
+    {
+        std::ofstream _spool(_state->spooled, std::ios::binary | std::ios::trunc);
+        if (!_spool)
+            throw std::runtime_error("fmtdxc: failed to open " + _state->spooled.string());
+        prefixed_streambuf _input(_magic, stream.rdbuf());
+        _spool << &_input;
+        _spool.flush();
+        if (!_spool)
+            throw std::runtime_error("fmtdxc: failed to write " + _state->spooled.string());
+    }
+    _state->read_indexed(_state->spooled);
+}
+
+container_reader::~container_reader() = default;
+
+version container_reader::get_version() const { return _state->ver; }
+
+const project& container_reader::get_project() const { return _state->archive ? _state->proj : _state->container.get_project(); }
+
+std::size_t container_reader::get_applied_count() const { return _state->applied; }
+
+std::size_t container_reader::get_commit_count() const { return _state->count; }
+
+std::size_t container_reader::get_commit_index() const { return _state->index; }
+
+std::shared_ptr<const project_commit> container_reader::read_commit(const bool patches)
+{
+    if (_state->index == _state->count)
+        return nullptr;
+    const std::size_t _index = _state->index++;
+    if (!_state->archive)
+        return container_io::read_commit(_state->container, _index, patches);
+    project_commit _commit = make_commit([this](project_commit& _commit) { (*_state->archive)(_commit); });
+    if (patches)
+        return std::make_shared<const project_commit>(std::move(_commit));
+    auto _summary = std::make_shared<project_commit>();
+    _summary->message = std::move(_commit.message);
+    _summary->timestamp = _commit.timestamp;
+    return _summary;
+}
+
+struct container_writer::state {
+    version ver;
+    std::size_t applied;
+    std::size_t count;
+    std::size_t written = 0;
+    std::ostream& stream;
+    std::unique_ptr<cereal::BinaryOutputArchive> archive;
+    string_table strings;
+    std::unique_ptr<record_writer> writer;
+
+    state(std::ostream& output, const version v, const std::size_t a, const std::size_t c)
+        : ver(v)
+        , applied(a)
+        , count(c)
+        , stream(output)
+    {
+    }
+};
+
+container_writer::container_writer(std::ostream& stream, const version& ver, const project& current, const std::size_t applied, const std::size_t commit_count)
+    : _state(std::make_unique<state>(stream, ver, applied, commit_count))
+{
+    if (applied > commit_count)
+        throw std::runtime_error("fmtdxc: invalid applied count for dawxchange container");
+    if (ver == version::alpha) {
+        _state->archive = std::make_unique<cereal::BinaryOutputArchive>(stream);
+        (*_state->archive)(cereal::make_nvp("project", current));
+        (*_state->archive)(cereal::make_nvp("applied", applied));
+        (*_state->archive)(cereal::make_size_tag(static_cast<cereal::size_type>(commit_count)));
+    } else {
+        _state->writer = std::make_unique<record_writer>(stream, 0, ver, _state->strings, 0);
+        _state->writer->write_header();
+        _state->writer->write_project(current);
+    }
+}
+
+container_writer::~container_writer() = default;
+
+void container_writer::write_commit(const project_commit& commit)
+{
+    if (_state->written == _state->count)
+        throw std::runtime_error("fmtdxc: more commits were written than the dawxchange container holds");
+    if (_state->archive)
+        (*_state->archive)(commit);
+    else
+        _state->writer->write_commit(commit);
+    ++_state->written;
+}
+
+void container_writer::finish()
+{
+    if (_state->written != _state->count)
+        throw std::runtime_error("fmtdxc: fewer commits were written than the dawxchange container holds");
+    if (_state->writer) {
+        _state->writer->finish_snapshot(_state->applied);
+        return;
+    }
+    _state->stream.flush();
+    if (!_state->stream)
+        throw std::runtime_error("fmtdxc: failed to write dawxchange container");
+}
+
+// each line is an object with a single member named after what it holds
+template <typename value_t>
+static void write_json_line(std::ostream& stream, const char* name, value_t& value)
+{
+    std::ostringstream _line;
+    {
+        cereal::JSONOutputArchive _archive(_line, cereal::JSONOutputArchive::Options::NoIndent());
+        _archive(cereal::make_nvp(name, value));
+    }
+    std::string _text = _line.str();
+    // strings escape their line breaks, the ones left are indentation
+    _text.erase(std::remove(_text.begin(), _text.end(), '\n'), _text.end());
+    stream << _text << '\n';
+    if (!stream)
+        throw std::runtime_error("fmtdxc: failed to write json line");
+}
+
+void export_json_line(std::ostream& stream, const container_info& value)
+{
+    container_info _value = value;
+    write_json_line(stream, "info", _value);
+}
+
+void export_json_line(std::ostream& stream, const project& value)
+{
+    payload_view<false> _view { const_cast<project&>(value) };
+    write_json_line(stream, "project", _view);
+}
+
+void export_json_line(std::ostream& stream, const project_commit& value)
+{
+    commit_view _view { const_cast<project_commit&>(value) };
+    write_json_line(stream, "commit", _view);
+}
+
+bool import_json_line(std::istream& stream, json_line& line)
+{
+    std::string _text;
+    while (std::getline(stream, _text)) {
+        const std::size_t _begin = _text.find('"');
+        if (_begin == std::string::npos) {
+            if (_text.find_first_not_of(" \t\r") != std::string::npos)
+                throw std::runtime_error("fmtdxc: invalid json line");
+            continue;
+        }
+        const std::size_t _end = _text.find('"', _begin + 1);
+        if (_end == std::string::npos)
+            throw std::runtime_error("fmtdxc: invalid json line");
+        const std::string _name = _text.substr(_begin + 1, _end - _begin - 1);
+        std::istringstream _line(_text);
+        cereal::JSONInputArchive _archive(_line);
+        if (_name == "info") {
+            container_info _info;
+            _archive(cereal::make_nvp("info", _info));
+            line = _info;
+        } else if (_name == "project") {
+            project _project;
+            payload_view<false> _view { _project };
+            _archive(cereal::make_nvp("project", _view));
+            line = std::move(_project);
+        } else if (_name == "commit") {
+            line = make_commit([&_archive](project_commit& _commit) {
+                commit_view _view { _commit };
+                _archive(cereal::make_nvp("commit", _view));
+            });
+        } else {
+            throw std::runtime_error("fmtdxc: unknown json line " + _name);
+        }
+        return true;
+    }
+    return false;
+}
+
+}
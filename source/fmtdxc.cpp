@@ -1,130 +1,130 @@
-#include <fmtdxc/fmtdxc.hpp>
+#include "internal.hpp"
 
-#include <cereal/archives/binary.hpp>
-#include <cereal/archives/json.hpp>
-#include <cereal/cereal.hpp>
-#include <cereal/types/chrono.hpp>
-#include <cereal/types/map.hpp>
-#include <cereal/types/optional.hpp>
-#include <cereal/types/string.hpp>
-#include <cereal/types/vector.hpp>
+#include <algorithm>
+#include <limits>
+#include <unordered_set>
 
-#include <cmath>
-#include <ctime>
-#include <utility>
+#if defined(__AVX2__)
+#define FMTDXC_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FMTDXC_SSE2
+#endif
+#if defined(FMTDXC_SSE2)
+#include <immintrin.h>
+#endif
 
 namespace fmtdxc {
 
-inline bool differs(double a, double b, double eps = 1e-9)
-{
-    return std::fabs(a - b) > eps;
-}
+// ---------- memory resources ----------
 
-inline bool differs(float a, float b, float eps = 1e-6f)
-{
-    return std::fabs(a - b) > eps;
-}
+#if defined(FMTDXC_PMR)
 
-template <typename T>
-inline bool differs(const T& a, const T& b)
+std::shared_ptr<std::pmr::memory_resource> get_current_resource()
 {
-    return a != b;
+    const std::shared_ptr<std::pmr::memory_resource>& _resource = get_thread_resource();
+    if (_resource)
+        return _resource;
+    // aliases an empty owner, the default resource is never released
+    return std::shared_ptr<std::pmr::memory_resource>(std::shared_ptr<void>(), std::pmr::get_default_resource());
 }
 
-template <typename T>
-static std::optional<T> diff_value(const T& a, const T& b)
+resource_scope::resource_scope(std::shared_ptr<std::pmr::memory_resource> resource)
+    : _previous(std::exchange(get_thread_resource(), std::move(resource)))
 {
-    return differs(a, b) ? std::make_optional(b) : std::nullopt;
 }
 
-template <typename T>
-static void set_if(T& dst, const std::optional<T>& maybe)
+resource_scope::~resource_scope()
 {
-    if (maybe)
-        dst = *maybe;
+    get_thread_resource() = std::move(_previous);
 }
 
-static bool is_empty_audio_clip(const sparse_project::audio_clip& x)
-{
-    return !x.name && !x.start_tick && !x.length_ticks && !x.file && !x.file_start_frame && !x.db && !x.is_loop;
-}
+#endif
 
-static bool is_empty_midi_mpe(const sparse_project::midi_mpe& x)
+// deltas are signed and must not overflow when they are summed or negated, unlike the fields they are added to
+template <typename T>
+static T add_delta(const T a, const T b)
 {
-    return !x.channel && !x.pressure && !x.slide && !x.timbre;
+    if (b > 0 ? a > std::numeric_limits<T>::max() - b : a < std::numeric_limits<T>::min() - b)
+        throw std::out_of_range("fmtdxc: midi note operation delta out of range");
+    return a + b;
 }
 
-static bool is_empty_midi_note(const sparse_project::midi_note& x)
+template <typename T>
+static T negate_delta(const T a)
 {
-    return !x.start_tick && !x.length_ticks && !x.pitch && !x.velocity && (!x.mpe || is_empty_midi_mpe(*x.mpe));
+    if (a == std::numeric_limits<T>::min())
+        throw std::out_of_range("fmtdxc: midi note operation delta out of range");
+    return -a;
 }
 
-static bool is_empty_midi_clip(const sparse_project::midi_clip& x)
+// operations only add to fields, so that they commute with each other and consecutive ones over the same notes fold into one
+static void append_note_operation(sparse_project::note_operations& operations, const midi_note_operation& operation)
 {
-    return !x.name && !x.start_tick && !x.length_ticks && x.notes.empty();
+    if (!operations.empty() && operations.back().first_note == operation.first_note && operations.back().last_note == operation.last_note) {
+        const std::int64_t _start_delta = add_delta(operations.back().start_delta, operation.start_delta);
+        const std::int32_t _pitch_delta = add_delta(operations.back().pitch_delta, operation.pitch_delta);
+        operations.back().start_delta = _start_delta;
+        operations.back().pitch_delta = _pitch_delta;
+        if (!operations.back().start_delta && !operations.back().pitch_delta)
+            operations.pop_back();
+    } else if (operation.start_delta || operation.pitch_delta) {
+        operations.push_back(operation);
+    }
 }
 
-static bool is_empty_audio_sequencer(const sparse_project::audio_sequencer& x)
+static midi_note_operation inverse_note_operation(const midi_note_operation& operation)
 {
-    return !x.name && !x.output && x.clips.empty();
+    return { operation.first_note, operation.last_note, negate_delta(operation.start_delta), negate_delta(operation.pitch_delta) };
 }
 
-static bool is_empty_midi_sequencer(const sparse_project::midi_sequencer& x)
+// sum of the operations of a patch that cover a note
+static midi_note_operation note_operation_deltas(const sparse_project::note_operations& operations, const std::uint32_t note)
 {
-    // we only consider instrument.name at the moment
-    return !x.name && !x.output && (!x.instrument || !x.instrument->name) && x.clips.empty();
+    midi_note_operation _deltas { note, note, 0, 0 };
+    for (auto& _operation : operations) {
+        if (note >= _operation.first_note && note <= _operation.last_note) {
+            _deltas.start_delta = add_delta(_deltas.start_delta, _operation.start_delta);
+            _deltas.pitch_delta = add_delta(_deltas.pitch_delta, _operation.pitch_delta);
+        }
+    }
+    return _deltas;
 }
 
-static bool is_empty_mixer_track(const sparse_project::mixer_track& x)
+// fields wrap around like unsigned integers so that the inverse operation restores them exactly
+static void shift_note(project::midi_note& note, const midi_note_operation& operation)
 {
-    return !x.name && !x.db && !x.pan && x.effects.empty() && x.routings.empty();
+    note.start_tick += static_cast<std::uint64_t>(operation.start_delta);
+    note.pitch = static_cast<std::uint16_t>(note.pitch + static_cast<std::uint32_t>(operation.pitch_delta));
 }
 
-static bool is_empty(const sparse_project& x)
+// only the fields that a note entry holds are shifted
+static void shift_note(sparse_project::midi_note& note, const midi_note_operation& operation)
 {
-    return !x.name && !x.ppq && !x.master_track_id && x.audio_sequencers.empty() && x.midi_sequencers.empty() && x.mixer_tracks.empty();
+    if (note.start_tick)
+        *note.start_tick += static_cast<std::uint64_t>(operation.start_delta);
+    if (note.pitch)
+        *note.pitch = static_cast<std::uint16_t>(*note.pitch + static_cast<std::uint32_t>(operation.pitch_delta));
 }
 
 static sparse_project::audio_clip full_patch_audio_clip(const project::audio_clip& s)
 {
     sparse_project::audio_clip p;
-    p.name = s.name;
-    p.start_tick = s.start_tick;
-    p.length_ticks = s.length_ticks;
-    p.file = s.file;
-    p.file_start_frame = s.file_start_frame;
-    p.db = s.db;
-    p.is_loop = s.is_loop;
-    return p;
-}
-
-static sparse_project::midi_mpe full_patch_midi_mpe(const project::midi_mpe& s)
-{
-    sparse_project::midi_mpe p;
-    p.channel = s.channel;
-    p.pressure = s.pressure;
-    p.slide = s.slide;
-    p.timbre = s.timbre;
+    full_patch_fields(s, p);
     return p;
 }
 
 static sparse_project::midi_note full_patch_midi_note(const project::midi_note& s)
 {
     sparse_project::midi_note p;
-    p.start_tick = s.start_tick;
-    p.length_ticks = s.length_ticks;
-    p.pitch = s.pitch;
-    p.velocity = s.velocity;
-    // if (s.mpe) p.mpe = full_patch(*s.mpe);
+    full_patch_fields(s, p);
     return p;
 }
 
 static sparse_project::midi_clip full_patch_midi_clip(const project::midi_clip& s)
 {
     sparse_project::midi_clip p;
-    p.name = s.name;
-    p.start_tick = s.start_tick;
-    p.length_ticks = s.length_ticks;
+    full_patch_fields(s, p);
     for (auto& [nid, n] : s.notes)
         p.notes.emplace(nid, full_patch_midi_note(n));
     return p;
@@ -133,8 +133,7 @@ static sparse_project::midi_clip full_patch_midi_clip(const project::midi_clip&
 static sparse_project::audio_sequencer full_patch_audio_sequencer(const project::audio_sequencer& s)
 {
     sparse_project::audio_sequencer p;
-    p.name = s.name;
-    p.output = s.output;
+    full_patch_fields(s, p);
     for (auto& [cid, c] : s.clips)
         p.clips.emplace(cid, full_patch_audio_clip(c));
     return p;
@@ -143,491 +142,2105 @@ static sparse_project::audio_sequencer full_patch_audio_sequencer(const project:
 static sparse_project::midi_sequencer full_patch_midi_sequencer(const project::midi_sequencer& s)
 {
     sparse_project::midi_sequencer p;
-    p.name = s.name;
-    p.output = s.output;
-    p.instrument = sparse_project::midi_instrument {};
-    p.instrument->name = s.instrument.name;
+    full_patch_fields(s, p);
     for (auto& [cid, c] : s.clips)
         p.clips.emplace(cid, full_patch_midi_clip(c));
     return p;
 }
 
+static sparse_project::audio_effect full_patch_audio_effect(const project::audio_effect& s)
+{
+    sparse_project::audio_effect p;
+    full_patch_fields(s, p);
+    return p;
+}
+
+static sparse_project::mixer_routing full_patch_mixer_routing(const project::mixer_routing& s)
+{
+    sparse_project::mixer_routing p;
+    full_patch_fields(s, p);
+    return p;
+}
+
 static sparse_project::mixer_track full_patch_mixer_track(const project::mixer_track& s)
 {
     sparse_project::mixer_track p;
-    p.name = s.name;
-    p.db = s.db;
-    p.pan = s.pan;
-    // effects/routings are placeholders in your model; include when you model fields there
+    full_patch_fields(s, p);
+    for (auto& [eid, e] : s.effects)
+        p.effects.emplace(eid, full_patch_audio_effect(e));
+    for (auto& [rid, r] : s.routings)
+        p.routings.emplace(rid, full_patch_mixer_routing(r));
     return p;
 }
 
-static sparse_project::audio_clip diff_audio_clip(const project::audio_clip& a, const project::audio_clip& b)
-{
-    sparse_project::audio_clip out;
-    out.name = diff_value(a.name, b.name);
-    out.start_tick = diff_value(a.start_tick, b.start_tick);
-    out.length_ticks = diff_value(a.length_ticks, b.length_ticks);
-    out.file = diff_value(a.file, b.file);
-    out.file_start_frame = diff_value(a.file_start_frame, b.file_start_frame);
-    out.db = diff_value(a.db, b.db);
-    out.is_loop = diff_value(a.is_loop, b.is_loop);
-    return out;
-}
-
-static sparse_project::midi_note diff_midi_note(const project::midi_note& a, const project::midi_note& b)
-{
-    sparse_project::midi_note out;
-    out.start_tick = diff_value(a.start_tick, b.start_tick);
-    out.length_ticks = diff_value(a.length_ticks, b.length_ticks);
-    out.pitch = diff_value(a.pitch, b.pitch);
-    out.velocity = diff_value(a.velocity, b.velocity);
-    // optional: field-level MPE diff
-    // if (a.mpe != b.mpe) {
-    //     sparse_project::midi_mpe mpe;
-    //     if (a.mpe && b.mpe) {
-    //         mpe.channel  = diff_value(a.mpe.channel,  b.mpe.channel);
-    //         mpe.pressure = diff_value(a.mpe.pressure, b.mpe.pressure);
-    //         mpe.slide    = diff_value(a.mpe.slide,    b.mpe.slide);
-    //         mpe.timbre   = diff_value(a.mpe.timbre,   b.mpe.timbre);
-    //         if (!is_empty(mpe)) out.mpe = mpe;
-    //     } else if (b.mpe) {
-    //         out.mpe = full_patch(*b.mpe);
-    //     } else {
-    //         // deletion of mpe not modeled; skip or set out.mpe = sparse_project::midi_mpe{} (no-op)
-    //     }
-    // }
-    return out;
-}
-
-// generic diff_map with pruning + proper adds
-template <typename K, typename V, typename DiffFn, typename FullPatchFn, typename IsEmptyFn>
-static auto diff_map(const std::map<K, V>& a, const std::map<K, V>& b,
-    DiffFn&& diff_entity, FullPatchFn&& full_entity, IsEmptyFn&& is_empty_entity)
-    -> std::map<K, decltype(diff_entity(std::declval<V>(), std::declval<V>()))>
+static sparse_project::collected_audio_file full_patch_collected_audio_file(const project::collected_audio_file& s)
 {
-    using SparseV = decltype(diff_entity(std::declval<V>(), std::declval<V>()));
-    std::map<K, SparseV> out;
-
-    for (auto& [idB, objB] : b) {
-        auto itA = a.find(idB);
-        if (itA == a.end()) {
-            auto patch = full_entity(objB); // NEW entity => full payload
-            if (!is_empty_entity(patch))
-                out.emplace(idB, std::move(patch));
-        } else {
-            auto patch = diff_entity(itA->second, objB);
-            if (!is_empty_entity(patch))
-                out.emplace(idB, std::move(patch));
-        }
-    }
-    // deletes not modeled (by design). If you need them, switch to optional<T> map values in sparse mode.
-    return out;
+    sparse_project::collected_audio_file p;
+    full_patch_fields(s, p);
+    return p;
 }
 
-static sparse_project::midi_clip diff_midi_clip(const project::midi_clip& a, const project::midi_clip& b)
+// clips with fewer notes are diffed note by note, gathering columns would not pay off
+static constexpr std::size_t columnar_note_threshold = 64;
+
+std::uint64_t next_generation()
 {
-    sparse_project::midi_clip out;
-    out.name = diff_value(a.name, b.name);
-    out.start_tick = diff_value(a.start_tick, b.start_tick);
-    out.length_ticks = diff_value(a.length_ticks, b.length_ticks);
-    out.notes = diff_map(a.notes, b.notes,
-        diff_midi_note,
-        full_patch_midi_note,
-        is_empty_midi_note);
-    return out;
+    static std::atomic<std::uint64_t> _counter { 0 };
+    return _counter.fetch_add(1, std::memory_order_relaxed) + 1;
 }
 
-static sparse_project::audio_sequencer diff_audio_sequencer(const project::audio_sequencer& a, const project::audio_sequencer& b)
+template <typename T, typename = void>
+struct has_generation : std::false_type { };
+
+template <typename T>
+struct has_generation<T, std::void_t<decltype(std::declval<const T&>().generation)>> : std::true_type { };
+
+// entities with the same non zero stamp are known to be identical down to their leaves,
+// effects and routings carry no stamp and are always compared
+template <typename T>
+static bool same_generation(const T& a, const T& b)
 {
-    sparse_project::audio_sequencer out;
-    out.name = diff_value(a.name, b.name);
-    out.output = diff_value(a.output, b.output);
-    out.clips = diff_map(a.clips, b.clips,
-        diff_audio_clip,
-        full_patch_audio_clip,
-        is_empty_audio_clip);
-    return out;
+    if constexpr (has_generation<T>::value)
+        return a.generation != 0 && a.generation == b.generation;
+    else
+        return false;
 }
 
-static sparse_project::midi_sequencer diff_midi_sequencer(const project::midi_sequencer& a, const project::midi_sequencer& b)
+// maps copied from one another hold the same entities until either is mutated
+template <typename Map>
+static bool shares_entities(const Map&, const Map&)
 {
-    sparse_project::midi_sequencer out;
-    out.name = diff_value(a.name, b.name);
-    out.output = diff_value(a.output, b.output);
-    // instrument (only name at the moment)
-    if (a.instrument.name != b.instrument.name) {
-        out.instrument = sparse_project::midi_instrument {};
-        out.instrument->name = b.instrument.name;
-    }
-    out.clips = diff_map(a.clips, b.clips,
-        diff_midi_clip,
-        full_patch_midi_clip,
-        is_empty_midi_clip);
-    return out;
+    return false;
 }
 
-static sparse_project::mixer_track diff_mixer_track(const project::mixer_track& a, const project::mixer_track& b)
+template <typename T>
+static bool shares_entities(const cow_id_map<T>& a, const cow_id_map<T>& b)
 {
-    sparse_project::mixer_track out;
-    out.name = diff_value(a.name, b.name);
-    out.db = diff_value(a.db, b.db);
-    out.pan = diff_value(a.pan, b.pan);
-    // effects / routings can be added here when fields exist
-    return out;
+    return a.shares(b);
 }
 
-void diff(const project& a, const project& b, sparse_project& out)
+// entities that editors never touched stay untracked
+template <typename T>
+static void refresh_generation(T& entity, const std::uint64_t stamp)
 {
-    out.name = diff_value(a.name, b.name);
-    out.ppq = diff_value(a.ppq, b.ppq);
-    out.master_track_id = diff_value(a.master_track_id, b.master_track_id);
+    if (entity.generation)
+        entity.generation = stamp;
+}
 
-    out.audio_sequencers = diff_map(a.audio_sequencers, b.audio_sequencers,
-        diff_audio_sequencer,
-        full_patch_audio_sequencer,
-        is_empty_audio_sequencer);
-    out.midi_sequencers = diff_map(a.midi_sequencers, b.midi_sequencers,
-        diff_midi_sequencer,
-        full_patch_midi_sequencer,
-        is_empty_midi_sequencer);
-    out.mixer_tracks = diff_map(a.mixer_tracks, b.mixer_tracks,
-        diff_mixer_track,
-        full_patch_mixer_track,
-        is_empty_mixer_track);
+template <bool bidirectional_t, typename T>
+static void diff_value(const T& a, const T& b, std::optional<T>& forward, std::optional<T>& backward)
+{
+    if (differs(a, b)) {
+        forward = b;
+        if constexpr (bidirectional_t)
+            backward = a;
+    }
 }
 
-static void apply_audio_clip(project::audio_clip& dst, const sparse_project::audio_clip& p)
+// nested records are diffed field by field and only kept when something changed in them
+template <bool bidirectional_t, typename record_t, typename sparse_record_t>
+static void diff_fields(const record_t& a, const record_t& b, sparse_record_t& forward, sparse_record_t& backward)
 {
-    set_if(dst.name, p.name);
-    set_if(dst.start_tick, p.start_tick);
-    set_if(dst.length_ticks, p.length_ticks);
-    set_if(dst.file, p.file);
-    set_if(dst.file_start_frame, p.file_start_frame);
-    set_if(dst.db, p.db);
-    set_if(dst.is_loop, p.is_loop);
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        using value_t = member_type<decltype(field(a))>;
+        if constexpr (is_nested_record<value_t>) {
+            typename member_type<decltype(field(forward))>::value_type _forward, _backward;
+            diff_fields<bidirectional_t>(field(a), field(b), _forward, _backward);
+            if (!is_empty_record(_forward))
+                field(forward) = std::move(_forward);
+            if constexpr (bidirectional_t) {
+                if (!is_empty_record(_backward))
+                    field(backward) = std::move(_backward);
+            }
+        } else if constexpr (is_value_member<value_t>) {
+            diff_value<bidirectional_t>(field(a), field(b), field(forward), field(backward));
+        }
+    });
 }
 
-static void apply_midi_mpe(project::midi_mpe& dst, const sparse_project::midi_mpe& p)
+template <bool bidirectional_t>
+static void diff_audio_clip(const project::audio_clip& a, const project::audio_clip& b, sparse_project::audio_clip& forward, sparse_project::audio_clip& backward, const backward_mode)
 {
-    set_if(dst.channel, p.channel);
-    set_if(dst.pressure, p.pressure);
-    set_if(dst.slide, p.slide);
-    set_if(dst.timbre, p.timbre);
+    diff_fields<bidirectional_t>(a, b, forward, backward);
 }
 
-static void apply_midi_note(project::midi_note& dst, const sparse_project::midi_note& p)
+template <bool bidirectional_t>
+static void diff_midi_note(const project::midi_note& a, const project::midi_note& b, sparse_project::midi_note& forward, sparse_project::midi_note& backward, const backward_mode)
 {
-    set_if(dst.start_tick, p.start_tick);
-    set_if(dst.length_ticks, p.length_ticks);
-    set_if(dst.pitch, p.pitch);
-    set_if(dst.velocity, p.velocity);
-    // apply_midi_mpe(dst.mpe, p.mpe);
+    diff_fields<bidirectional_t>(a, b, forward, backward);
 }
 
-static void apply_midi_clip(project::midi_clip& dst, const sparse_project::midi_clip& p)
+// generic diff_range with pruning + proper adds, walks both sorted ranges side by side
+// so that forward and backward patches are produced with a single lookup per id
+template <bool bidirectional_t, typename It, typename SparseMap, typename DiffFn, typename FullPatchFn, typename IsEmptyFn>
+static void diff_range(It itA, const It lastA, It itB, const It lastB,
+    SparseMap& forward, SparseMap& backward, const backward_mode mode,
+    DiffFn&& diff_entity, FullPatchFn&& full_entity, IsEmptyFn&& is_empty_entity)
 {
-    set_if(dst.name, p.name);
-    set_if(dst.start_tick, p.start_tick);
-    set_if(dst.length_ticks, p.length_ticks);
-    for (auto& [nid, np] : p.notes) {
-        auto& note = dst.notes[nid]; // create if missing
-        apply_midi_note(note, np);
+    using SparseV = typename SparseMap::mapped_type;
+    FMTDXC_COUNT_GROWTH(patch_entities, forward.size() + backward.size());
+    while (itA != lastA || itB != lastB) {
+        FMTDXC_COUNT(nodes_visited, 1);
+        if (itB == lastB || (itA != lastA && itA->first < itB->first)) {
+            // entity only in base => nothing forward (deletes not modeled), full payload backward
+            if constexpr (bidirectional_t) {
+                if (mode == backward_mode::full) {
+                    auto patch = full_entity(itA->second);
+                    if (!is_empty_entity(patch))
+                        backward.emplace_hint(backward.end(), itA->first, std::move(patch));
+                }
+            }
+            ++itA;
+        } else if (itA == lastA || itB->first < itA->first) {
+            auto patch = full_entity(itB->second); // NEW entity => full payload
+            if (!is_empty_entity(patch))
+                forward.emplace_hint(forward.end(), itB->first, std::move(patch));
+            ++itB;
+        } else if (!same_generation(itA->second, itB->second)) {
+            FMTDXC_COUNT_DIFFED(typename std::iterator_traits<It>::value_type::second_type);
+            SparseV forward_patch, backward_patch;
+            diff_entity(itA->second, itB->second, forward_patch, backward_patch, mode);
+            if (!is_empty_entity(forward_patch))
+                forward.emplace_hint(forward.end(), itB->first, std::move(forward_patch));
+            if constexpr (bidirectional_t) {
+                if (!is_empty_entity(backward_patch))
+                    backward.emplace_hint(backward.end(), itA->first, std::move(backward_patch));
+            }
+            ++itA;
+            ++itB;
+        } else {
+            ++itA;
+            ++itB;
+        }
     }
 }
 
-static void apply_audio_sequencer(project::audio_sequencer& dst, const sparse_project::audio_sequencer& p)
+template <bool bidirectional_t, typename Map, typename SparseMap, typename DiffFn, typename FullPatchFn, typename IsEmptyFn>
+static void diff_map(const Map& a, const Map& b,
+    SparseMap& forward, SparseMap& backward, const backward_mode mode,
+    DiffFn&& diff_entity, FullPatchFn&& full_entity, IsEmptyFn&& is_empty_entity)
 {
-    set_if(dst.name, p.name);
-    set_if(dst.output, p.output);
-    for (auto& [cid, cp] : p.clips) {
-        auto& clip = dst.clips[cid]; // create if missing
-        apply_audio_clip(clip, cp);
-    }
+    if (shares_entities(a, b))
+        return;
+    diff_range<bidirectional_t>(a.begin(), a.end(), b.begin(), b.end(), forward, backward, mode,
+        std::forward<DiffFn>(diff_entity), std::forward<FullPatchFn>(full_entity), std::forward<IsEmptyFn>(is_empty_entity));
 }
 
-static void apply_midi_sequencer(project::midi_sequencer& dst, const sparse_project::midi_sequencer& p)
+// ---------- columnar notes ----------
+
+// returns false when a note carries an expression, that columns do not hold
+template <typename notes_t>
+static bool notes_to_columns(const notes_t& notes, midi_note_columns& columns)
 {
-    set_if(dst.name, p.name);
-    set_if(dst.output, p.output);
-    if (p.instrument) {
-        set_if(dst.instrument.name, p.instrument->name);
-    }
-    for (auto& [cid, cp] : p.clips) {
-        auto& clip = dst.clips[cid];
-        apply_midi_clip(clip, cp);
+    const std::size_t _count = notes.size();
+    columns.ids.resize(_count);
+    columns.start_ticks.resize(_count);
+    columns.length_ticks.resize(_count);
+    columns.pitches.resize(_count);
+    columns.velocities.resize(_count);
+    std::size_t _index = 0;
+    bool _plain = true;
+    for (auto& [nid, n] : notes) {
+        columns.ids[_index] = nid;
+        columns.start_ticks[_index] = n.start_tick;
+        columns.length_ticks[_index] = n.length_ticks;
+        columns.pitches[_index] = n.pitch;
+        columns.velocities[_index] = n.velocity;
+        _plain = _plain && is_default_record(n.mpe);
+        ++_index;
     }
+    return _plain;
 }
 
-static void apply_mixer_track(project::mixer_track& dst, const sparse_project::mixer_track& p)
+void to_columns(const project::midi_clip& clip, midi_note_columns& columns)
 {
-    set_if(dst.name, p.name);
-    set_if(dst.db, p.db);
-    set_if(dst.pan, p.pan);
-    // effects/routings once modeled
+    notes_to_columns(clip.notes, columns);
 }
 
-void apply(const project& base, const sparse_project& diffs, project& out)
+void from_columns(const midi_note_columns& columns, project::midi_clip& clip)
 {
-    out = base;
+    for (std::size_t _index = 0; _index < columns.ids.size(); ++_index) {
+        auto& _note = clip.notes[columns.ids[_index]];
+        _note.start_tick = columns.start_ticks[_index];
+        _note.length_ticks = columns.length_ticks[_index];
+        _note.pitch = columns.pitches[_index];
+        _note.velocity = columns.velocities[_index];
+    }
+}
 
-    set_if(out.name, diffs.name);
-    set_if(out.ppq, diffs.ppq);
-    set_if(out.master_track_id, diffs.master_track_id);
+static std::uint8_t compare_note(const midi_note_columns& a, const midi_note_columns& b, const std::size_t index)
+{
+    std::uint8_t _mask = 0;
+    _mask |= a.start_ticks[index] != b.start_ticks[index] ? midi_note_mask::start_tick : 0;
+    _mask |= a.length_ticks[index] != b.length_ticks[index] ? midi_note_mask::length_ticks : 0;
+    _mask |= a.pitches[index] != b.pitches[index] ? midi_note_mask::pitch : 0;
+    _mask |= differs(a.velocities[index], b.velocities[index]) ? midi_note_mask::velocity : 0;
+    return _mask;
+}
 
-    for (auto& [asid, asp] : diffs.audio_sequencers) {
-        auto& as = out.audio_sequencers[asid]; // add or modify
-        apply_audio_sequencer(as, asp);
+#if defined(FMTDXC_SSE2)
+// expands 4 equality bits per field into one change mask per note
+static void store_note_masks(const int start_equal, const int length_equal, const int pitch_equal, const int velocity_changed, std::uint8_t* masks)
+{
+    for (int _lane = 0; _lane < 4; ++_lane) {
+        std::uint8_t _mask = 0;
+        _mask |= (start_equal >> _lane) & 1 ? 0 : midi_note_mask::start_tick;
+        _mask |= (length_equal >> _lane) & 1 ? 0 : midi_note_mask::length_ticks;
+        _mask |= (pitch_equal >> (_lane * 2)) & 1 ? 0 : midi_note_mask::pitch;
+        _mask |= (velocity_changed >> _lane) & 1 ? midi_note_mask::velocity : 0;
+        masks[_lane] = _mask;
     }
-    for (auto& [msid, msp] : diffs.midi_sequencers) {
-        auto& ms = out.midi_sequencers[msid];
-        apply_midi_sequencer(ms, msp);
+}
+
+#if !defined(FMTDXC_AVX2)
+// 64 bit lanes equality with SSE2 only, both 32 bit halves must match
+static __m128i cmpeq_epi64(const __m128i a, const __m128i b)
+{
+#if defined(__SSE4_1__)
+    return _mm_cmpeq_epi64(a, b);
+#else
+    const __m128i _halves = _mm_cmpeq_epi32(a, b);
+    return _mm_and_si128(_halves, _mm_shuffle_epi32(_halves, _MM_SHUFFLE(2, 3, 0, 1)));
+#endif
+}
+#endif
+#endif
+
+void compare_note_columns(const midi_note_columns& a, const midi_note_columns& b, std::vector<std::uint8_t>& masks)
+{
+    const std::size_t _count = std::min(a.ids.size(), b.ids.size());
+    masks.resize(_count);
+    std::size_t _index = 0;
+#if defined(FMTDXC_SSE2)
+    const __m128 _sign = _mm_set1_ps(-0.0f);
+    const __m128 _eps = _mm_set1_ps(1e-6f);
+    for (; _index + 4 <= _count; _index += 4) {
+#if defined(FMTDXC_AVX2)
+        const __m256i _start_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.start_ticks.data() + _index));
+        const __m256i _start_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.start_ticks.data() + _index));
+        const __m256i _length_a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a.length_ticks.data() + _index));
+        const __m256i _length_b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b.length_ticks.data() + _index));
+        const int _start_equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_start_a, _start_b)));
+        const int _length_equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_length_a, _length_b)));
+#else
+        const __m128i* _start_a = reinterpret_cast<const __m128i*>(a.start_ticks.data() + _index);
+        const __m128i* _start_b = reinterpret_cast<const __m128i*>(b.start_ticks.data() + _index);
+        const __m128i* _length_a = reinterpret_cast<const __m128i*>(a.length_ticks.data() + _index);
+        const __m128i* _length_b = reinterpret_cast<const __m128i*>(b.length_ticks.data() + _index);
+        const int _start_equal = _mm_movemask_pd(_mm_castsi128_pd(cmpeq_epi64(_mm_loadu_si128(_start_a), _mm_loadu_si128(_start_b))))
+            | (_mm_movemask_pd(_mm_castsi128_pd(cmpeq_epi64(_mm_loadu_si128(_start_a + 1), _mm_loadu_si128(_start_b + 1)))) << 2);
+        const int _length_equal = _mm_movemask_pd(_mm_castsi128_pd(cmpeq_epi64(_mm_loadu_si128(_length_a), _mm_loadu_si128(_length_b))))
+            | (_mm_movemask_pd(_mm_castsi128_pd(cmpeq_epi64(_mm_loadu_si128(_length_a + 1), _mm_loadu_si128(_length_b + 1)))) << 2);
+#endif
+        const __m128i _pitch_a = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(a.pitches.data() + _index));
+        const __m128i _pitch_b = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(b.pitches.data() + _index));
+        const int _pitch_equal = _mm_movemask_epi8(_mm_cmpeq_epi16(_pitch_a, _pitch_b));
+        // same as differs(float, float): |a - b| > eps, false for NaN
+        const __m128 _delta = _mm_sub_ps(_mm_loadu_ps(a.velocities.data() + _index), _mm_loadu_ps(b.velocities.data() + _index));
+        const int _velocity_changed = _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(_sign, _delta), _eps));
+        store_note_masks(_start_equal, _length_equal, _pitch_equal, _velocity_changed, masks.data() + _index);
     }
-    for (auto& [mtid, mtp] : diffs.mixer_tracks) {
-        auto& mt = out.mixer_tracks[mtid];
-        apply_mixer_track(mt, mtp);
+#endif
+    for (; _index < _count; ++_index)
+        masks[_index] = compare_note(a, b, _index);
+}
+
+// diffs clips that hold the same note ids through the columnar kernel, returns false when it does not apply
+template <bool bidirectional_t, typename notes_t, typename sparse_notes_t>
+static bool diff_notes_columnar(const notes_t& a, const notes_t& b, sparse_notes_t& forward, sparse_notes_t& backward)
+{
+    if (a.size() != b.size() || a.size() < columnar_note_threshold)
+        return false;
+    thread_local midi_note_columns _columns_a, _columns_b;
+    thread_local std::vector<std::uint8_t> _masks;
+    const bool _plain_a = notes_to_columns(a, _columns_a);
+    const bool _plain_b = notes_to_columns(b, _columns_b);
+    if (!_plain_a || !_plain_b || _columns_a.ids != _columns_b.ids)
+        return false;
+    compare_note_columns(_columns_a, _columns_b, _masks);
+    FMTDXC_COUNT(nodes_visited, _masks.size());
+    FMTDXC_COUNT(midi_notes_diffed, _masks.size());
+    FMTDXC_COUNT_GROWTH(patch_entities, forward.size() + backward.size());
+
+    for (std::size_t _index = 0; _index < _masks.size(); ++_index) {
+        const std::uint8_t _mask = _masks[_index];
+        if (!_mask)
+            continue;
+        sparse_project::midi_note _forward, _backward;
+        if (_mask & midi_note_mask::start_tick) {
+            _forward.start_tick = _columns_b.start_ticks[_index];
+            _backward.start_tick = _columns_a.start_ticks[_index];
+        }
+        if (_mask & midi_note_mask::length_ticks) {
+            _forward.length_ticks = _columns_b.length_ticks[_index];
+            _backward.length_ticks = _columns_a.length_ticks[_index];
+        }
+        if (_mask & midi_note_mask::pitch) {
+            _forward.pitch = _columns_b.pitches[_index];
+            _backward.pitch = _columns_a.pitches[_index];
+        }
+        if (_mask & midi_note_mask::velocity) {
+            _forward.velocity = _columns_b.velocities[_index];
+            _backward.velocity = _columns_a.velocities[_index];
+        }
+        forward.emplace_hint(forward.end(), _columns_b.ids[_index], std::move(_forward));
+        if constexpr (bidirectional_t)
+            backward.emplace_hint(backward.end(), _columns_a.ids[_index], std::move(_backward));
     }
+    return true;
 }
 
-void apply(project& base, const sparse_project& diffs)
+template <bool bidirectional_t>
+static void diff_midi_clip(const project::midi_clip& a, const project::midi_clip& b, sparse_project::midi_clip& forward, sparse_project::midi_clip& backward, const backward_mode mode)
 {
-    project _out;
-    apply(base, diffs, _out);
-    base = _out;
-    // fugly!
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+    if (shares_entities(a.notes, b.notes))
+        return;
+    if (!diff_notes_columnar<bidirectional_t>(a.notes, b.notes, forward.notes, backward.notes))
+        diff_map<bidirectional_t>(a.notes, b.notes, forward.notes, backward.notes, mode,
+            diff_midi_note<bidirectional_t>,
+            full_patch_midi_note,
+            is_empty_midi_note);
 }
 
-// ---------- project_container methods ----------
-project_container::project_container()
-    : _proj {}
-    , _applied(0)
+template <bool bidirectional_t>
+static void diff_audio_sequencer(const project::audio_sequencer& a, const project::audio_sequencer& b, sparse_project::audio_sequencer& forward, sparse_project::audio_sequencer& backward, const backward_mode mode)
 {
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+    diff_map<bidirectional_t>(a.clips, b.clips, forward.clips, backward.clips, mode,
+        diff_audio_clip<bidirectional_t>,
+        full_patch_audio_clip,
+        is_empty_audio_clip);
 }
-project_container::project_container(const project& base)
-    : _proj(base)
-    , _applied(0)
+
+template <bool bidirectional_t>
+static void diff_midi_sequencer(const project::midi_sequencer& a, const project::midi_sequencer& b, sparse_project::midi_sequencer& forward, sparse_project::midi_sequencer& backward, const backward_mode mode)
 {
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+    diff_map<bidirectional_t>(a.clips, b.clips, forward.clips, backward.clips, mode,
+        diff_midi_clip<bidirectional_t>,
+        full_patch_midi_clip,
+        is_empty_midi_clip);
 }
-project_container::project_container(const project& base,
-    const std::vector<project_commit>& commits)
-    : _proj(base)
-    , _applied(0)
-    , _commits(commits)
+
+template <bool bidirectional_t>
+static void diff_audio_effect(const project::audio_effect& a, const project::audio_effect& b, sparse_project::audio_effect& forward, sparse_project::audio_effect& backward, const backward_mode)
 {
+    diff_fields<bidirectional_t>(a, b, forward, backward);
 }
-project_container::project_container(const project& base,
-    const std::vector<project_commit>& commits,
-    const std::size_t applied)
-    : _proj(base)
-    , _applied(applied)
-    , _commits(commits)
+
+template <bool bidirectional_t>
+static void diff_mixer_routing(const project::mixer_routing& a, const project::mixer_routing& b, sparse_project::mixer_routing& forward, sparse_project::mixer_routing& backward, const backward_mode)
 {
+    diff_fields<bidirectional_t>(a, b, forward, backward);
 }
 
-bool project_container::can_undo() const { return _applied > 0; }
+template <bool bidirectional_t>
+static void diff_mixer_track(const project::mixer_track& a, const project::mixer_track& b, sparse_project::mixer_track& forward, sparse_project::mixer_track& backward, const backward_mode mode)
+{
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+    diff_map<bidirectional_t>(a.effects, b.effects, forward.effects, backward.effects, mode,
+        diff_audio_effect<bidirectional_t>,
+        full_patch_audio_effect,
+        is_empty_audio_effect);
+    diff_map<bidirectional_t>(a.routings, b.routings, forward.routings, backward.routings, mode,
+        diff_mixer_routing<bidirectional_t>,
+        full_patch_mixer_routing,
+        is_empty_mixer_routing);
+}
 
-bool project_container::can_redo() const { return _applied < _commits.size(); }
+// blobs are compared by digest, their bytes stay in the blob store of the container
+template <bool bidirectional_t>
+static void diff_collected_audio_file(const project::collected_audio_file& a, const project::collected_audio_file& b, sparse_project::collected_audio_file& forward, sparse_project::collected_audio_file& backward, const backward_mode)
+{
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+}
 
-std::size_t project_container::get_applied_count() const { return _applied; }
+template <bool bidirectional_t>
+static void diff_project(const project& a, const project& b, sparse_project& forward, sparse_project& backward, const backward_mode mode)
+{
+    if (same_generation(a, b))
+        return;
+    diff_fields<bidirectional_t>(a, b, forward, backward);
 
-const project& project_container::get_project() const { return _proj; }
+    diff_map<bidirectional_t>(a.audio_sequencers, b.audio_sequencers, forward.audio_sequencers, backward.audio_sequencers, mode,
+        diff_audio_sequencer<bidirectional_t>,
+        full_patch_audio_sequencer,
+        is_empty_audio_sequencer);
+    diff_map<bidirectional_t>(a.midi_sequencers, b.midi_sequencers, forward.midi_sequencers, backward.midi_sequencers, mode,
+        diff_midi_sequencer<bidirectional_t>,
+        full_patch_midi_sequencer,
+        is_empty_midi_sequencer);
+    diff_map<bidirectional_t>(a.mixer_tracks, b.mixer_tracks, forward.mixer_tracks, backward.mixer_tracks, mode,
+        diff_mixer_track<bidirectional_t>,
+        full_patch_mixer_track,
+        is_empty_mixer_track);
+    diff_map<bidirectional_t>(a.collected_audio_files, b.collected_audio_files, forward.collected_audio_files, backward.collected_audio_files, mode,
+        diff_collected_audio_file<bidirectional_t>,
+        full_patch_collected_audio_file,
+        is_empty_collected_audio_file);
+}
 
-const std::vector<project_commit>& project_container::get_commits() const { return _commits; }
+// contiguous range of ids diffed by a single task, with its own output maps
+template <typename Map, typename SparseMap>
+struct diff_chunk {
+    typename Map::const_iterator first_a, last_a, first_b, last_b;
+    SparseMap forward;
+    SparseMap backward;
+};
+
+// splits the union of ids from a and b into ranges of about chunk_size entities each
+template <typename SparseMap, typename Map>
+static std::vector<diff_chunk<Map, SparseMap>> make_diff_chunks(const Map& a, const Map& b, const std::size_t chunk_size)
+{
+    using K = typename Map::key_type;
+    if (shares_entities(a, b))
+        return {};
+    std::vector<K> _bounds;
+    std::size_t _index = 0;
+    for (auto& [id, _] : a)
+        if (_index++ % chunk_size == 0)
+            _bounds.push_back(id);
+    _index = 0;
+    for (auto& [id, _] : b)
+        if (_index++ % chunk_size == 0)
+            _bounds.push_back(id);
+    std::sort(_bounds.begin(), _bounds.end());
+    _bounds.erase(std::unique(_bounds.begin(), _bounds.end()), _bounds.end());
+
+    std::vector<diff_chunk<Map, SparseMap>> _chunks(_bounds.size());
+    for (std::size_t _i = 0; _i < _bounds.size(); ++_i) {
+        _chunks[_i].first_a = _i == 0 ? a.begin() : _chunks[_i - 1].last_a;
+        _chunks[_i].first_b = _i == 0 ? b.begin() : _chunks[_i - 1].last_b;
+        _chunks[_i].last_a = _i + 1 < _bounds.size() ? a.lower_bound(_bounds[_i + 1]) : a.end();
+        _chunks[_i].last_b = _i + 1 < _bounds.size() ? b.lower_bound(_bounds[_i + 1]) : b.end();
+    }
+    return _chunks;
+}
 
-void project_container::commit(const std::string& message, const project& next)
+// moves entries of a chunk output into dst, chunks are merged in id order so every insertion is at the end
+template <typename K, typename V, typename C, typename A>
+static void append_map(std::map<K, V, C, A>& dst, std::map<K, V, C, A>& src)
 {
-    // truncate redo tail if any
-    if (_applied < _commits.size())
-        _commits.resize(_applied);
+    // nodes only move between maps that allocate from the same resource
+    if (dst.get_allocator() == src.get_allocator()) {
+        while (!src.empty())
+            dst.insert(dst.end(), src.extract(src.begin()));
+        return;
+    }
+    for (auto& [id, entity] : src)
+        dst.emplace_hint(dst.end(), id, std::move(entity));
+    src.clear();
+}
 
-    project_commit c;
-    c.message = message;
-    c.timestamp = std::chrono::system_clock::now();
-    diff(_proj, next, c.forward);
-    diff(next, _proj, c.backward);
+template <typename T>
+static void append_map(flat_id_map<T>& dst, flat_id_map<T>& src)
+{
+    for (auto& [id, entity] : src)
+        dst.emplace_hint(dst.end(), id, std::move(entity));
+    src.clear();
+}
 
-    // skip no-op commits
-    if (is_empty(c.forward)) {
-        _proj = next;
+template <typename T>
+static void append_map(cow_id_map<T>& dst, cow_id_map<T>& src)
+{
+    if (dst.empty()) {
+        dst = std::move(src);
         return;
     }
+    for (auto& [id, entity] : src)
+        dst.emplace_hint(dst.end(), id, std::move(entity));
+    src.clear();
+}
 
-#ifndef NDEBUG
-    {
-        project after, rewind;
-        apply(_proj, c.forward, after);
-        apply(after, c.backward, rewind);
-        // optional sanity: if (rewind != _proj) { /*log*/ }
-        (void)rewind;
+template <bool bidirectional_t, typename Chunks, typename DiffFn, typename FullPatchFn, typename IsEmptyFn>
+static void push_diff_tasks(Chunks& chunks, std::vector<std::function<void()>>& tasks, const backward_mode mode,
+    DiffFn diff_entity, FullPatchFn full_entity, IsEmptyFn is_empty_entity)
+{
+    for (auto& _chunk : chunks) {
+        tasks.emplace_back(make_task([&_chunk, mode, diff_entity, full_entity, is_empty_entity]() {
+            // outputs are constructed by the task so that they allocate from its resource
+            _chunk.forward = decltype(_chunk.forward)();
+            _chunk.backward = decltype(_chunk.backward)();
+            diff_range<bidirectional_t>(_chunk.first_a, _chunk.last_a, _chunk.first_b, _chunk.last_b,
+                _chunk.forward, _chunk.backward, mode,
+                diff_entity, full_entity, is_empty_entity);
+        }));
     }
-#endif
+}
 
-    _commits.push_back(std::move(c));
-    ++_applied;
-    _proj = next;
+template <typename Chunks, typename SparseMap>
+static void merge_diff_chunks(Chunks& chunks, SparseMap& forward, SparseMap& backward)
+{
+    for (auto& _chunk : chunks) {
+        append_map(forward, _chunk.forward);
+        append_map(backward, _chunk.backward);
+    }
 }
 
-void project_container::undo()
+template <bool bidirectional_t>
+static void diff_project(const project& a, const project& b, sparse_project& forward, sparse_project& backward, const backward_mode mode, const executor& exec, const std::size_t chunk_size)
 {
-    if (!can_undo())
+    if (same_generation(a, b))
         return;
-    const auto& c = _commits[_applied - 1];
-    apply(_proj, c.backward);
-    --_applied;
+    diff_fields<bidirectional_t>(a, b, forward, backward);
+
+    const std::size_t _chunk_size = std::max<std::size_t>(chunk_size, 1);
+    auto _audio_chunks = make_diff_chunks<decltype(forward.audio_sequencers)>(a.audio_sequencers, b.audio_sequencers, _chunk_size);
+    auto _midi_chunks = make_diff_chunks<decltype(forward.midi_sequencers)>(a.midi_sequencers, b.midi_sequencers, _chunk_size);
+    auto _track_chunks = make_diff_chunks<decltype(forward.mixer_tracks)>(a.mixer_tracks, b.mixer_tracks, _chunk_size);
+    auto _file_chunks = make_diff_chunks<decltype(forward.collected_audio_files)>(a.collected_audio_files, b.collected_audio_files, _chunk_size);
+
+    std::vector<std::function<void()>> _tasks;
+    push_diff_tasks<bidirectional_t>(_audio_chunks, _tasks, mode,
+        diff_audio_sequencer<bidirectional_t>,
+        full_patch_audio_sequencer,
+        is_empty_audio_sequencer);
+    push_diff_tasks<bidirectional_t>(_midi_chunks, _tasks, mode,
+        diff_midi_sequencer<bidirectional_t>,
+        full_patch_midi_sequencer,
+        is_empty_midi_sequencer);
+    push_diff_tasks<bidirectional_t>(_track_chunks, _tasks, mode,
+        diff_mixer_track<bidirectional_t>,
+        full_patch_mixer_track,
+        is_empty_mixer_track);
+    push_diff_tasks<bidirectional_t>(_file_chunks, _tasks, mode,
+        diff_collected_audio_file<bidirectional_t>,
+        full_patch_collected_audio_file,
+        is_empty_collected_audio_file);
+    exec(_tasks);
+
+    // deterministic: chunks cover disjoint id ranges and are merged in id order
+    merge_diff_chunks(_audio_chunks, forward.audio_sequencers, backward.audio_sequencers);
+    merge_diff_chunks(_midi_chunks, forward.midi_sequencers, backward.midi_sequencers);
+    merge_diff_chunks(_track_chunks, forward.mixer_tracks, backward.mixer_tracks);
+    merge_diff_chunks(_file_chunks, forward.collected_audio_files, backward.collected_audio_files);
 }
 
-void project_container::redo()
+void diff(const project& a, const project& b, sparse_project& out)
 {
-    if (!can_redo())
-        return;
-    const auto& c = _commits[_applied];
-    apply(_proj, c.forward);
-    ++_applied;
+    FMTDXC_PHASE(diff);
+    sparse_project _unused;
+    diff_project<false>(a, b, out, _unused, backward_mode::full);
 }
+
+void diff(const project& a, const project& b, sparse_project& forward, sparse_project& backward, const backward_mode mode)
+{
+    FMTDXC_PHASE(diff);
+    diff_project<true>(a, b, forward, backward, mode);
 }
 
-// SERIALIZATION
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-//
-namespace std {
-namespace filesystem {
-
-    template <typename archive_t>
-    void serialize(archive_t& archive, path& p)
-    {
-        if constexpr (archive_t::is_saving::value) {
-            archive(cereal::make_nvp("path", p.string()));
-        } else if constexpr (archive_t::is_loading::value) {
-            std::string _str;
-            archive(cereal::make_nvp("path", _str));
-            p = std::filesystem::path(_str);
+void diff(const project& a, const project& b, sparse_project& out, const executor& exec, const std::size_t chunk_size)
+{
+    FMTDXC_PHASE(diff);
+    sparse_project _unused;
+    if (!exec)
+        diff_project<false>(a, b, out, _unused, backward_mode::full);
+    else
+        diff_project<false>(a, b, out, _unused, backward_mode::full, exec, chunk_size);
+}
+
+void diff(const project& a, const project& b, sparse_project& forward, sparse_project& backward, const executor& exec, const backward_mode mode, const std::size_t chunk_size)
+{
+    FMTDXC_PHASE(diff);
+    if (!exec)
+        diff_project<true>(a, b, forward, backward, mode);
+    else
+        diff_project<true>(a, b, forward, backward, mode, exec, chunk_size);
+}
+
+// moves values out of the patch when it is an rvalue, nested records are applied field by field
+template <typename record_t, typename patch_t>
+static void apply_fields(record_t& dst, patch_t&& p)
+{
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        auto& _target = field(dst);
+        auto& _patch = field(p);
+        using value_t = member_type<decltype(_target)>;
+        if constexpr (is_nested_record<value_t>) {
+            if (_patch)
+                apply_fields(_target, forward_member<patch_t>(*_patch));
+        } else if constexpr (is_value_member<value_t>) {
+            set_if(_target, forward_member<patch_t>(_patch));
         }
-    }
+    });
+}
+
+template <typename patch_t>
+static void apply_audio_clip(project::audio_clip& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+}
 
+template <typename patch_t>
+static void apply_midi_note(project::midi_note& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
 }
+
+template <typename patch_t>
+static void apply_midi_clip(project::midi_clip& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+    FMTDXC_COUNT(nodes_visited, p.notes.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.notes.size());
+    for (auto& [nid, np] : p.notes) {
+        auto& note = dst.notes[nid]; // create if missing
+        apply_midi_note(note, forward_member<patch_t>(np), stamp);
+    }
+    for (auto& _operation : p.operations) {
+        for_each_operated_note(dst.notes, _operation, [&_operation, stamp](std::uint32_t, project::midi_note& _note) {
+            refresh_generation(_note, stamp);
+            shift_note(_note, _operation);
+        });
+    }
 }
 
-#define FMX_SERIALIZE_NESTED(Nested, BODY)                              \
-    template <class archive_t>                                          \
-    void serialize(archive_t& archive, project::Nested& value) { BODY } \
-    template <class archive_t>                                          \
-    void serialize(archive_t& archive, sparse_project::Nested& value) { BODY }
+template <typename patch_t>
+static void apply_audio_sequencer(project::audio_sequencer& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+    FMTDXC_COUNT(nodes_visited, p.clips.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.clips.size());
+    for (auto& [cid, cp] : p.clips) {
+        auto& clip = dst.clips[cid]; // create if missing
+        apply_audio_clip(clip, forward_member<patch_t>(cp), stamp);
+    }
+}
 
-namespace fmtdxc {
+template <typename patch_t>
+static void apply_midi_sequencer(project::midi_sequencer& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+    FMTDXC_COUNT(nodes_visited, p.clips.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.clips.size());
+    for (auto& [cid, cp] : p.clips) {
+        auto& clip = dst.clips[cid];
+        apply_midi_clip(clip, forward_member<patch_t>(cp), stamp);
+    }
+}
 
-FMX_SERIALIZE_NESTED(audio_effect, {
-    archive(cereal::make_nvp("name", value.name));
-});
+template <typename patch_t>
+static void apply_mixer_track(project::mixer_track& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+    FMTDXC_COUNT(nodes_visited, p.effects.size() + p.routings.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.effects.size() + dst.routings.size());
+    for (auto& [eid, ep] : p.effects) {
+        auto& effect = dst.effects[eid]; // create if missing
+        apply_fields(effect, forward_member<patch_t>(ep));
+    }
+    for (auto& [rid, rp] : p.routings) {
+        auto& routing = dst.routings[rid];
+        apply_fields(routing, forward_member<patch_t>(rp));
+    }
+}
 
-FMX_SERIALIZE_NESTED(midi_instrument, {
-    archive(cereal::make_nvp("name", value.name));
-});
+template <typename patch_t>
+static void apply_collected_audio_file(project::collected_audio_file& dst, patch_t&& p, const std::uint64_t stamp)
+{
+    refresh_generation(dst, stamp);
+    apply_fields(dst, std::forward<patch_t>(p));
+}
 
-FMX_SERIALIZE_NESTED(audio_clip, {
-    archive(cereal::make_nvp("name", value.name));
-    archive(cereal::make_nvp("start_tick", value.start_tick));
-    archive(cereal::make_nvp("length_ticks", value.length_ticks));
-    // file
-    archive(cereal::make_nvp("file_start_frame", value.file_start_frame));
-    archive(cereal::make_nvp("db", value.db));
-    archive(cereal::make_nvp("is_loop", value.is_loop));
-});
+// only touches the entities named in diffs, moves values out of diffs when it is an rvalue
+template <typename patch_t>
+static void apply_project(project& out, patch_t&& diffs)
+{
+    // a single fresh stamp is enough, it only has to differ from the ones of other versions of each entity
+    const std::uint64_t stamp = next_generation();
+    // entities added to out allocate from the resource of out
+    FMTDXC_RESOURCE_SCOPE(out.audio_sequencers);
+    refresh_generation(out, stamp);
+    apply_fields(out, std::forward<patch_t>(diffs));
+    FMTDXC_COUNT(nodes_visited, diffs.audio_sequencers.size() + diffs.midi_sequencers.size() + diffs.mixer_tracks.size() + diffs.collected_audio_files.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, out.audio_sequencers.size() + out.midi_sequencers.size() + out.mixer_tracks.size() + out.collected_audio_files.size());
 
-FMX_SERIALIZE_NESTED(midi_mpe, {
-    archive(cereal::make_nvp("channel", value.channel));
-    archive(cereal::make_nvp("pressure", value.pressure));
-    archive(cereal::make_nvp("slide", value.slide));
-    archive(cereal::make_nvp("timbre", value.timbre));
-});
+    for (auto& [asid, asp] : diffs.audio_sequencers) {
+        auto& as = out.audio_sequencers[asid]; // add or modify
+        apply_audio_sequencer(as, forward_member<patch_t>(asp), stamp);
+    }
+    for (auto& [msid, msp] : diffs.midi_sequencers) {
+        auto& ms = out.midi_sequencers[msid];
+        apply_midi_sequencer(ms, forward_member<patch_t>(msp), stamp);
+    }
+    for (auto& [mtid, mtp] : diffs.mixer_tracks) {
+        auto& mt = out.mixer_tracks[mtid];
+        apply_mixer_track(mt, forward_member<patch_t>(mtp), stamp);
+    }
+    for (auto& [cfid, cfp] : diffs.collected_audio_files) {
+        auto& cf = out.collected_audio_files[cfid];
+        apply_collected_audio_file(cf, forward_member<patch_t>(cfp), stamp);
+    }
+}
 
-FMX_SERIALIZE_NESTED(midi_note, {
-    archive(cereal::make_nvp("start_tick", value.start_tick));
-    archive(cereal::make_nvp("length_ticks", value.length_ticks));
-    archive(cereal::make_nvp("pitch", value.pitch));
-    archive(cereal::make_nvp("velocity", value.velocity));
-    archive(cereal::make_nvp("mpe", value.mpe));
-});
+void apply(const project& base, const sparse_project& diffs, project& out)
+{
+    FMTDXC_PHASE(apply);
+    if (&out != &base)
+        out = base;
+    apply_project(out, diffs);
+}
 
-FMX_SERIALIZE_NESTED(midi_clip, {
-    archive(cereal::make_nvp("name", value.name));
-    archive(cereal::make_nvp("start_tick", value.start_tick));
-    archive(cereal::make_nvp("length_ticks", value.length_ticks));
-    archive(cereal::make_nvp("notes", value.notes));
-});
+void apply(project&& base, const sparse_project& diffs, project& out)
+{
+    FMTDXC_PHASE(apply);
+    if (&out != &base)
+        out = std::move(base);
+    apply_project(out, diffs);
+}
 
-FMX_SERIALIZE_NESTED(audio_sequencer, {
-    archive(cereal::make_nvp("name", value.name));
-    archive(cereal::make_nvp("instrument", value.instrument));
-    archive(cereal::make_nvp("clips", value.clips));
-    archive(cereal::make_nvp("output", value.output));
-});
+void apply(project& base, const sparse_project& diffs)
+{
+    FMTDXC_PHASE(apply);
+    apply_project(base, diffs);
+}
 
-FMX_SERIALIZE_NESTED(mixer_routing, {
-    archive(cereal::make_nvp("db", value.db));
-    archive(cereal::make_nvp("output", value.output));
-});
+void apply(project& base, sparse_project&& diffs)
+{
+    FMTDXC_PHASE(apply);
+    apply_project(base, std::move(diffs));
+}
 
-FMX_SERIALIZE_NESTED(mixer_track, {
-    archive(cereal::make_nvp("name", value.name));
-    archive(cereal::make_nvp("db", value.db));
-    archive(cereal::make_nvp("pan", value.pan));
-    archive(cereal::make_nvp("effects", value.effects));
-    archive(cereal::make_nvp("routings", value.routings));
-});
+// ---------- compose ----------
 
-template <typename archive_t, bool sparse_t>
-void serialize(archive_t& archive, basic_project<sparse_t>& value)
+template <typename T>
+static void compose_value(std::optional<T>& dst, const std::optional<T>& next)
 {
-    archive(cereal::make_nvp("name", value.name));
-    archive(cereal::make_nvp("ppq", value.ppq));
-    // archive(cereal::make_nvp("audio_sequencers", value.audio_sequencers));
-    // archive(cereal::make_nvp("midi_sequencers", value.midi_sequencers));
-    archive(cereal::make_nvp("mixer_tracks", value.mixer_tracks));
-    archive(cereal::make_nvp("master_track_id", value.master_track_id));
+    if (next)
+        dst = next;
 }
 
-template <typename archive_t>
-void serialize(archive_t& archive, project_commit& value)
+template <typename T>
+static void compose_value(std::optional<T>& dst, std::optional<T>&& next)
 {
-    archive(cereal::make_nvp("message", value.message));
-    archive(cereal::make_nvp("timestamp", value.timestamp));
-    archive(cereal::make_nvp("forward", value.forward));
-    archive(cereal::make_nvp("backward", value.backward));
+    if (next)
+        dst = std::move(next);
 }
 
-template <typename archive_t>
-void serialize(archive_t& archive, project_container& value)
+// nested records that next holds are created in dst when it does not hold them yet
+template <typename record_t, typename patch_t>
+static void compose_fields(record_t& dst, patch_t&& next)
 {
-    archive(cereal::make_nvp("project", value._proj));
-    archive(cereal::make_nvp("applied", value._applied));
-    archive(cereal::make_nvp("commits", value._commits));
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        auto& _target = field(dst);
+        auto& _next = field(next);
+        using value_t = member_type<decltype(_target)>;
+        if constexpr (is_optional<value_t>::value && is_nested_record<typename value_t::value_type>) {
+            if (_next)
+                compose_fields(_target ? *_target : _target.emplace(), forward_member<patch_t>(*_next));
+        } else if constexpr (is_value_member<value_t>) {
+            compose_value(_target, forward_member<patch_t>(_next));
+        }
+    });
 }
 
-void import_container(std::istream& stream, project_container& container, version& ver)
+template <typename patch_t>
+static void compose_audio_clip(sparse_project::audio_clip& dst, patch_t&& next)
 {
-    cereal::BinaryInputArchive _archive(stream);
-    _archive(cereal::make_nvp("dawxchange binary container", container));
+    compose_fields(dst, std::forward<patch_t>(next));
 }
 
-void export_container(std::ostream& stream, const project_container& container, const version& ver)
+template <typename patch_t>
+static void compose_midi_note(sparse_project::midi_note& dst, patch_t&& next)
 {
-    cereal::BinaryOutputArchive _archive(stream);
-    _archive(cereal::make_nvp("dawxchange json container", container));
+    compose_fields(dst, std::forward<patch_t>(next));
 }
 
+template <typename patch_t>
+static void compose_midi_clip(sparse_project::midi_clip& dst, patch_t&& next)
+{
+    compose_fields(dst, std::forward<patch_t>(next));
+    FMTDXC_COUNT(nodes_visited, next.notes.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.notes.size());
+    for (auto& [nid, np] : next.notes) {
+        if (dst.operations.empty()) {
+            compose_midi_note(dst.notes[nid], forward_member<patch_t>(np));
+            continue;
+        }
+        // the entry moves before the operations of dst, that are taken off the fields it sets
+        sparse_project::midi_note _entry = np;
+        shift_note(_entry, inverse_note_operation(note_operation_deltas(dst.operations, nid)));
+        compose_midi_note(dst.notes[nid], std::move(_entry));
+    }
+    for (auto& _operation : next.operations)
+        append_note_operation(dst.operations, _operation);
+}
+
+template <typename patch_t>
+static void compose_audio_sequencer(sparse_project::audio_sequencer& dst, patch_t&& next)
+{
+    compose_fields(dst, std::forward<patch_t>(next));
+    FMTDXC_COUNT(nodes_visited, next.clips.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.clips.size());
+    for (auto& [cid, cp] : next.clips)
+        compose_audio_clip(dst.clips[cid], forward_member<patch_t>(cp));
+}
+
+template <typename patch_t>
+static void compose_midi_sequencer(sparse_project::midi_sequencer& dst, patch_t&& next)
+{
+    compose_fields(dst, std::forward<patch_t>(next));
+    FMTDXC_COUNT(nodes_visited, next.clips.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.clips.size());
+    for (auto& [cid, cp] : next.clips)
+        compose_midi_clip(dst.clips[cid], forward_member<patch_t>(cp));
+}
+
+template <typename patch_t>
+static void compose_mixer_track(sparse_project::mixer_track& dst, patch_t&& next)
+{
+    compose_fields(dst, std::forward<patch_t>(next));
+    FMTDXC_COUNT(nodes_visited, next.effects.size() + next.routings.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.effects.size() + dst.routings.size());
+    for (auto& [eid, ep] : next.effects)
+        compose_fields(dst.effects[eid], forward_member<patch_t>(ep));
+    for (auto& [rid, rp] : next.routings)
+        compose_fields(dst.routings[rid], forward_member<patch_t>(rp));
+}
+
+template <typename patch_t>
+static void compose_collected_audio_file(sparse_project::collected_audio_file& dst, patch_t&& next)
+{
+    compose_fields(dst, std::forward<patch_t>(next));
+}
+
+// folds next into dst so that applying dst alone equals applying dst then next
+template <typename patch_t>
+static void compose_into(sparse_project& dst, patch_t&& next)
+{
+    FMTDXC_RESOURCE_SCOPE(dst.audio_sequencers);
+    compose_fields(dst, std::forward<patch_t>(next));
+    FMTDXC_COUNT(nodes_visited, next.audio_sequencers.size() + next.midi_sequencers.size() + next.mixer_tracks.size() + next.collected_audio_files.size());
+    FMTDXC_COUNT_GROWTH(entities_allocated, dst.audio_sequencers.size() + dst.midi_sequencers.size() + dst.mixer_tracks.size() + dst.collected_audio_files.size());
+    for (auto& [asid, asp] : next.audio_sequencers)
+        compose_audio_sequencer(dst.audio_sequencers[asid], forward_member<patch_t>(asp));
+    for (auto& [msid, msp] : next.midi_sequencers)
+        compose_midi_sequencer(dst.midi_sequencers[msid], forward_member<patch_t>(msp));
+    for (auto& [mtid, mtp] : next.mixer_tracks)
+        compose_mixer_track(dst.mixer_tracks[mtid], forward_member<patch_t>(mtp));
+    for (auto& [cfid, cfp] : next.collected_audio_files)
+        compose_collected_audio_file(dst.collected_audio_files[cfid], forward_member<patch_t>(cfp));
+}
+
+void compose(const sparse_project& first, const sparse_project& second, sparse_project& result)
+{
+    FMTDXC_PHASE(compose);
+    if (&result != &first)
+        result = first;
+    compose_into(result, second);
+}
+
+void compose(sparse_project& first, const sparse_project& second)
+{
+    FMTDXC_PHASE(compose);
+    compose_into(first, second);
+}
+
+void compose(sparse_project& first, sparse_project&& second)
+{
+    FMTDXC_PHASE(compose);
+    compose_into(first, std::move(second));
+}
+
+// ---------- merge ----------
+
+// entity being merged, ids are only copied into the conflicts that are reported
+struct merge_scope {
+    merge_entity entity;
+    std::vector<std::uint32_t> ids;
+    std::vector<merge_conflict>& conflicts;
+
+    merge_scope child(const merge_entity child_entity, const std::uint32_t id) const
+    {
+        merge_scope _child { child_entity, ids, conflicts };
+        _child.ids.push_back(id);
+        return _child;
+    }
+};
+
+template <typename entity_t, typename T>
+static const T* base_field(const entity_t* base, T entity_t::*member)
+{
+    return base ? &(base->*member) : nullptr;
+}
+
+template <typename T>
+static void merge_value(const T* base, const std::optional<T>& ours, const std::optional<T>& theirs, std::optional<T>& result, const merge_scope& scope, const std::string& prefix, const char* field)
+{
+    const bool _ours = ours && (!base || differs(*base, *ours));
+    const bool _theirs = theirs && (!base || differs(*base, *theirs));
+    if (_ours && _theirs && differs(*ours, *theirs))
+        scope.conflicts.push_back({ scope.entity, scope.ids, prefix + field });
+    if (_ours)
+        result = *ours;
+    else if (_theirs)
+        result = *theirs;
+}
+
+// conflicts on the fields of nested records are named after the path to them, such as mpe.channel
+template <typename base_t, typename record_t>
+static void merge_fields(const base_t* base, const record_t& ours, const record_t& theirs, record_t& result, const merge_scope& scope, const std::string& prefix = {})
+{
+    record_fields<record_t>::visit([&](const char* name, auto&& field) {
+        auto& _result = field(result);
+        using value_t = member_type<decltype(_result)>;
+        if constexpr (is_optional<value_t>::value) {
+            const auto* _base = base ? &field(*base) : nullptr;
+            if constexpr (is_nested_record<typename value_t::value_type>) {
+                if (!field(ours) && !field(theirs))
+                    return;
+                const typename value_t::value_type _none {};
+                typename value_t::value_type _merged;
+                merge_fields(_base, field(ours) ? *field(ours) : _none, field(theirs) ? *field(theirs) : _none, _merged, scope, prefix + name + ".");
+                if (!is_empty_record(_merged))
+                    _result = std::move(_merged);
+            } else {
+                merge_value(_base, field(ours), field(theirs), _result, scope, prefix, name);
+            }
+        }
+    });
+}
+
+// walks both maps in id order, entities changed by one side only are merged with an empty entry for the other
+// so that their values equal to base are dropped like the ones of entities changed by both sides
+template <typename base_map_t, typename sparse_map_t, typename merge_t, typename empty_t>
+static void merge_map(const base_map_t* base, const sparse_map_t& ours, const sparse_map_t& theirs, sparse_map_t& result, merge_t&& merge_entity, empty_t&& is_empty_entity)
+{
+    const typename sparse_map_t::mapped_type _none {};
+    auto _ours = ours.begin();
+    auto _theirs = theirs.begin();
+    while (_ours != ours.end() || _theirs != theirs.end()) {
+        const bool _has_ours = _ours != ours.end() && (_theirs == theirs.end() || _ours->first <= _theirs->first);
+        const bool _has_theirs = _theirs != theirs.end() && (_ours == ours.end() || _theirs->first <= _ours->first);
+        const std::uint32_t _id = _has_ours ? _ours->first : _theirs->first;
+        const typename base_map_t::mapped_type* _base = nullptr;
+        if (base) {
+            const auto _found = base->find(_id);
+            if (_found != base->end())
+                _base = &_found->second;
+        }
+        auto _merged = result.emplace_hint(result.end(), _id, typename sparse_map_t::mapped_type {});
+        merge_entity(_base, _has_ours ? _ours->second : _none, _has_theirs ? _theirs->second : _none, _merged->second, _id);
+        if (is_empty_entity(_merged->second))
+            result.erase(_merged);
+        if (_has_ours)
+            ++_ours;
+        if (_has_theirs)
+            ++_theirs;
+    }
+}
+
+static void merge_audio_clip(const project::audio_clip* base, const sparse_project::audio_clip& ours, const sparse_project::audio_clip& theirs, sparse_project::audio_clip& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+}
+
+static void merge_midi_note(const project::midi_note* base, const sparse_project::midi_note& ours, const sparse_project::midi_note& theirs, sparse_project::midi_note& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+}
+
+// operations are resolved into note entries against base, so that both sides are merged note by note
+static sparse_project::midi_clip resolve_note_operations(const project::midi_clip* base, const sparse_project::midi_clip& patch)
+{
+    sparse_project::midi_clip _resolved = patch;
+    _resolved.operations.clear();
+    for (auto& _operation : patch.operations) {
+        for_each_operated_note(_resolved.notes, _operation, [&_operation, base](const std::uint32_t _id, sparse_project::midi_note& _entry) {
+            if (!base || base->notes.find(_id) == base->notes.end())
+                shift_note(_entry, _operation);
+        });
+        if (!base)
+            continue;
+        for_each_operated_note(base->notes, _operation, [&_operation, &_resolved](const std::uint32_t _id, const project::midi_note& _note) {
+            auto& _entry = _resolved.notes[_id];
+            if (_operation.start_delta && !_entry.start_tick)
+                _entry.start_tick = _note.start_tick;
+            if (_operation.pitch_delta && !_entry.pitch)
+                _entry.pitch = _note.pitch;
+            shift_note(_entry, _operation);
+        });
+    }
+    return _resolved;
+}
+
+static void merge_midi_clip(const project::midi_clip* base, const sparse_project::midi_clip& ours, const sparse_project::midi_clip& theirs, sparse_project::midi_clip& result, const merge_scope& scope)
+{
+    if (!ours.operations.empty() || !theirs.operations.empty()) {
+        merge_midi_clip(base, resolve_note_operations(base, ours), resolve_note_operations(base, theirs), result, scope);
+        return;
+    }
+    merge_fields(base, ours, theirs, result, scope);
+    merge_map(base_field(base, &project::midi_clip::notes), ours.notes, theirs.notes, result.notes, [&scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_midi_note(base, ours, theirs, result, scope.child(merge_entity::midi_note, id)); }, is_empty_midi_note);
+}
+
+static void merge_audio_sequencer(const project::audio_sequencer* base, const sparse_project::audio_sequencer& ours, const sparse_project::audio_sequencer& theirs, sparse_project::audio_sequencer& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+    merge_map(base_field(base, &project::audio_sequencer::clips), ours.clips, theirs.clips, result.clips, [&scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_audio_clip(base, ours, theirs, result, scope.child(merge_entity::audio_clip, id)); }, is_empty_audio_clip);
+}
+
+static void merge_midi_sequencer(const project::midi_sequencer* base, const sparse_project::midi_sequencer& ours, const sparse_project::midi_sequencer& theirs, sparse_project::midi_sequencer& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+    merge_map(base_field(base, &project::midi_sequencer::clips), ours.clips, theirs.clips, result.clips, [&scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_midi_clip(base, ours, theirs, result, scope.child(merge_entity::midi_clip, id)); }, is_empty_midi_clip);
+}
+
+static void merge_mixer_track(const project::mixer_track* base, const sparse_project::mixer_track& ours, const sparse_project::mixer_track& theirs, sparse_project::mixer_track& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+    merge_map(base_field(base, &project::mixer_track::effects), ours.effects, theirs.effects, result.effects, [&scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_fields(base, ours, theirs, result, scope.child(merge_entity::audio_effect, id)); }, is_empty_audio_effect);
+    merge_map(base_field(base, &project::mixer_track::routings), ours.routings, theirs.routings, result.routings, [&scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_fields(base, ours, theirs, result, scope.child(merge_entity::mixer_routing, id)); }, is_empty_mixer_routing);
+}
+
+static void merge_collected_audio_file(const project::collected_audio_file* base, const sparse_project::collected_audio_file& ours, const sparse_project::collected_audio_file& theirs, sparse_project::collected_audio_file& result, const merge_scope& scope)
+{
+    merge_fields(base, ours, theirs, result, scope);
+}
+
+void merge(const project& base, const sparse_project& ours, const sparse_project& theirs, sparse_project& result, std::vector<merge_conflict>& conflicts)
+{
+    FMTDXC_PHASE(merge);
+    result = sparse_project {};
+    const merge_scope _scope { merge_entity::project, {}, conflicts };
+    merge_fields(&base, ours, theirs, result, _scope);
+    merge_map(&base.audio_sequencers, ours.audio_sequencers, theirs.audio_sequencers, result.audio_sequencers, [&_scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_audio_sequencer(base, ours, theirs, result, _scope.child(merge_entity::audio_sequencer, id)); }, is_empty_audio_sequencer);
+    merge_map(&base.midi_sequencers, ours.midi_sequencers, theirs.midi_sequencers, result.midi_sequencers, [&_scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_midi_sequencer(base, ours, theirs, result, _scope.child(merge_entity::midi_sequencer, id)); }, is_empty_midi_sequencer);
+    merge_map(&base.mixer_tracks, ours.mixer_tracks, theirs.mixer_tracks, result.mixer_tracks, [&_scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_mixer_track(base, ours, theirs, result, _scope.child(merge_entity::mixer_track, id)); }, is_empty_mixer_track);
+    merge_map(&base.collected_audio_files, ours.collected_audio_files, theirs.collected_audio_files, result.collected_audio_files, [&_scope](auto* base, auto& ours, auto& theirs, auto& result, const std::uint32_t id) { merge_collected_audio_file(base, ours, theirs, result, _scope.child(merge_entity::collected_audio_file, id)); }, is_empty_collected_audio_file);
+}
+
+// ---------- interning ----------
+
+template <typename T, typename hash_t = std::hash<T>>
+struct intern_pool {
+    std::mutex mutex;
+    std::unordered_set<T, hash_t> values; // nodes keep their address when the set rehashes
+};
+
+struct path_hash {
+    std::size_t operator()(const std::filesystem::path& value) const { return std::filesystem::hash_value(value); }
+};
+
+const std::string& intern(const std::string& value)
+{
+    // leaked so that handles held by static objects outlive the pool
+    static auto& _pool = *new intern_pool<std::string>();
+    std::lock_guard<std::mutex> _lock(_pool.mutex);
+    return *_pool.values.insert(value).first;
+}
+
+const std::filesystem::path& intern(const std::filesystem::path& value)
+{
+    // paths that compare equal share the spelling that was interned first
+    static auto& _pool = *new intern_pool<std::filesystem::path, path_hash>();
+    std::lock_guard<std::mutex> _lock(_pool.mutex);
+    return *_pool.values.insert(value).first;
+}
+
+// ---------- memory usage ----------
+
+#if !defined(FMTDXC_INTERN)
+static std::size_t memory_usage(const std::string& value)
+{
+    // heap storage only, small strings live inside the object
+    return value.capacity() > std::string().capacity() ? value.capacity() + 1 : 0;
+}
+
+static std::size_t memory_usage(const std::filesystem::path& value)
+{
+    return value.native().capacity() * sizeof(std::filesystem::path::value_type);
+}
+#endif
+
+template <typename T>
+static std::size_t memory_usage(const interned<T>&)
+{
+    // pooled values are shared by every handle
+    return 0;
+}
+
+template <typename T, typename C, typename A>
+static constexpr std::size_t node_overhead(const std::map<std::uint32_t, T, C, A>&)
+{
+    // color, parent, left and right of a red-black tree node
+    return 4 * sizeof(void*);
+}
+
+template <typename T>
+static constexpr std::size_t node_overhead(const flat_id_map<T>&)
+{
+    return 0;
+}
+
+template <typename T>
+static constexpr std::size_t node_overhead(const cow_id_map<T>&)
+{
+    return 0;
+}
+
+template <typename Map, typename EntityFn>
+static std::size_t memory_usage(const Map& entities, EntityFn&& entity_usage)
+{
+    std::size_t _bytes = 0;
+    for (auto& [id, entity] : entities)
+        _bytes += sizeof(typename Map::value_type) + node_overhead(entities) + entity_usage(entity);
+    return _bytes;
+}
+
+static std::size_t memory_usage(const project::audio_clip& value)
+{
+    return memory_usage(value.name) + memory_usage(value.file);
+}
+
+static std::size_t memory_usage(const project::midi_note&)
+{
+    return 0;
+}
+
+static std::size_t memory_usage(const project::midi_clip& value)
+{
+    return memory_usage(value.name) + memory_usage(value.notes, [](const project::midi_note& x) { return memory_usage(x); });
+}
+
+static std::size_t memory_usage(const project::audio_sequencer& value)
+{
+    return memory_usage(value.name) + memory_usage(value.clips, [](const project::audio_clip& x) { return memory_usage(x); });
+}
+
+static std::size_t memory_usage(const project::midi_sequencer& value)
+{
+    return memory_usage(value.name) + memory_usage(value.instrument.name) + memory_usage(value.clips, [](const project::midi_clip& x) { return memory_usage(x); });
+}
+
+static std::size_t memory_usage(const project::mixer_track& value)
+{
+    return memory_usage(value.name)
+        + memory_usage(value.effects, [](const project::audio_effect& x) { return memory_usage(x.name); })
+        + memory_usage(value.routings, [](const project::mixer_routing&) { return std::size_t(0); });
+}
+
+// estimated heap and inline bytes held by a project
+static std::size_t memory_usage(const project& value)
+{
+    return sizeof(project) + memory_usage(value.name)
+        + memory_usage(value.audio_sequencers, [](const project::audio_sequencer& x) { return memory_usage(x); })
+        + memory_usage(value.midi_sequencers, [](const project::midi_sequencer& x) { return memory_usage(x); })
+        + memory_usage(value.mixer_tracks, [](const project::mixer_track& x) { return memory_usage(x); })
+        + memory_usage(value.collected_audio_files, [](const project::collected_audio_file& x) { return memory_usage(x.collected_relative_path); });
+}
+
+// ---------- project_container methods ----------
+
+project_container::project_container()
+    : _proj {}
+    , _applied(0)
+    , _backward_mode(backward_mode::full)
+    , _checkpoint_interval(0)
+    , _compacted(0)
+    , _strings(std::make_shared<string_table>())
+{
+}
+project_container::project_container(const project& base)
+    : _proj(base)
+    , _applied(0)
+    , _backward_mode(backward_mode::full)
+    , _checkpoint_interval(0)
+    , _compacted(0)
+    , _strings(std::make_shared<string_table>())
+{
+}
+project_container::project_container(const project& base,
+    const std::vector<project_commit>& commits)
+    : project_container(base, commits, 0)
+{
+}
+project_container::project_container(const project& base,
+    const std::vector<project_commit>& commits,
+    const std::size_t applied)
+    : _proj(base)
+    , _applied(applied)
+    , _backward_mode(backward_mode::full)
+    , _checkpoint_interval(0)
+    , _compacted(0)
+    , _strings(std::make_shared<string_table>())
+{
+    _commits.reserve(commits.size());
+    for (auto& _commit : commits)
+        _commits.push_back({ std::make_shared<const project_commit>(_commit), 0, nullptr });
+}
+
+bool project_container::can_undo() const { return _applied > 0; }
+
+bool project_container::can_redo() const { return _applied < _commits.size(); }
+
+std::size_t project_container::get_applied_count() const { return _applied; }
+
+const project& project_container::get_project() const { return _gesture && _gesture->committed ? _gesture->current : _proj; }
+
+std::size_t commit_range::size() const { return container->get_commit_count(); }
+
+bool commit_range::empty() const { return size() == 0; }
+
+const project_commit& commit_range::operator[](const std::size_t index) const { return container->get_commit(index); }
+
+commit_range::iterator commit_range::begin() const { return iterator { container, 0 }; }
+
+commit_range::iterator commit_range::end() const { return iterator { container, size() }; }
+
+const project_commit& commit_range::iterator::operator*() const { return container->get_commit(index); }
+
+const project_commit* commit_range::iterator::operator->() const { return &container->get_commit(index); }
+
+commit_range::iterator& commit_range::iterator::operator++()
+{
+    ++index;
+    return *this;
+}
+
+commit_range::iterator commit_range::iterator::operator++(int)
+{
+    iterator _previous = *this;
+    ++index;
+    return _previous;
+}
+
+bool commit_range::iterator::operator==(const iterator& other) const { return container == other.container && index == other.index; }
+
+bool commit_range::iterator::operator!=(const iterator& other) const { return !(*this == other); }
+
+std::size_t project_container::get_commit_count() const { return _commits.size(); }
+
+const project_commit& project_container::get_commit(const std::size_t index) const { return _load(index); }
+
+commit_range project_container::get_commits() const { return commit_range { this }; }
+
+const std::string& project_container::get_commit_message(const std::size_t index) const { return _commits.at(index).commit->message; }
+
+std::chrono::time_point<std::chrono::system_clock> project_container::get_commit_timestamp(const std::size_t index) const { return _commits.at(index).commit->timestamp; }
+
+backward_mode project_container::get_backward_mode() const { return _backward_mode; }
+
+void project_container::set_backward_mode(const backward_mode mode) { _backward_mode = mode; }
+
+void project_container::set_executor(const executor& exec) { _executor = exec; }
+
+std::size_t project_container::get_checkpoint_interval() const { return _checkpoint_interval; }
+
+void project_container::set_checkpoint_interval(const std::size_t interval)
+{
+    _checkpoint_interval = interval;
+    if (!_checkpoint_interval)
+        _checkpoints.clear();
+    _record_checkpoint();
+}
+
+checkpoint_stats project_container::get_checkpoint_stats() const
+{
+    checkpoint_stats _stats { _checkpoints.size(), 0 };
+    for (auto& [index, checkpoint] : _checkpoints)
+        _stats.bytes += memory_usage(checkpoint);
+    return _stats;
+}
+
+std::uint64_t project_container::get_journal_size() const { return _journal.size; }
+
+void project_container::_record_checkpoint()
+{
+    if (_checkpoint_interval && _applied % _checkpoint_interval == 0)
+        _checkpoints.try_emplace(_applied, _proj);
+}
+
+// visits the entities of two maps by id, the side that does not hold an entity is given as null
+template <typename map_t, typename visit_t>
+static void visit_by_id(const map_t* before, const map_t* after, visit_t&& visit)
+{
+    using entity_t = typename map_t::mapped_type;
+    if (before) {
+        for (auto& [_id, _entity] : *before) {
+            const entity_t* _other = nullptr;
+            if (after) {
+                auto _found = after->find(_id);
+                if (_found != after->end())
+                    _other = &_found->second;
+            }
+            visit(_id, &_entity, _other);
+        }
+    }
+    if (after) {
+        for (auto& [_id, _entity] : *after)
+            if (!before || before->find(_id) == before->end())
+                visit(_id, static_cast<const entity_t*>(nullptr), &_entity);
+    }
+}
+
+template <typename T>
+static bool same_span(const T* before, const T* after)
+{
+    return before && after && before->start_tick == after->start_tick && before->length_ticks == after->length_ticks;
+}
+
+// names the clips and notes that one project holds and the other does not or that moved between them,
+// entities stamped with the same generation are skipped with everything they hold
+static void name_moved_spans(const project& before, const project& after, sparse_project& names)
+{
+    visit_by_id(&before.audio_sequencers, &after.audio_sequencers, [&names](const std::uint32_t asid, const auto* b, const auto* a) {
+        if (b && a && same_generation(*b, *a))
+            return;
+        visit_by_id(base_field(b, &project::audio_sequencer::clips), base_field(a, &project::audio_sequencer::clips), [&names, asid](const std::uint32_t cid, const auto* bc, const auto* ac) {
+            if (!same_span(bc, ac))
+                names.audio_sequencers[asid].clips[cid];
+        });
+    });
+    visit_by_id(&before.midi_sequencers, &after.midi_sequencers, [&names](const std::uint32_t msid, const auto* b, const auto* a) {
+        if (b && a && same_generation(*b, *a))
+            return;
+        visit_by_id(base_field(b, &project::midi_sequencer::clips), base_field(a, &project::midi_sequencer::clips), [&names, msid](const std::uint32_t cid, const auto* bc, const auto* ac) {
+            if (bc && ac && same_generation(*bc, *ac))
+                return;
+            if (!same_span(bc, ac))
+                names.midi_sequencers[msid].clips[cid];
+            if (!ac)
+                return;
+            // notes of an added clip are all named so that the index learns them
+            visit_by_id(base_field(bc, &project::midi_clip::notes), &ac->notes, [&names, msid, cid](const std::uint32_t nid, const auto* bn, const auto* an) {
+                if (!same_span(bn, an))
+                    names.midi_sequencers[msid].clips[cid].notes[nid];
+            });
+        });
+    });
+}
+
+void project_container::_update_intervals(const sparse_project& diffs)
+{
+    if (_intervals)
+        _intervals->update(_proj, diffs);
+}
+
+// full backward patches name the entities that the committed project deleted, the others can not tell them
+// and the deleted entities are found from the project before the commit
+void project_container::_commit_intervals(const project_commit& c, const project& next)
+{
+    if (!_intervals)
+        return;
+    _intervals->update(next, c.forward);
+    if (_backward_mode == backward_mode::full) {
+        _intervals->update(next, c.backward);
+        return;
+    }
+    FMTDXC_SCRATCH_SCOPE(_scratch);
+    sparse_project _moved;
+    name_moved_spans(_proj, next, _moved);
+    _intervals->update(next, _moved);
+}
+
+void project_container::_truncate()
+{
+    if (_applied < _commits.size()) {
+        _commits.resize(_applied);
+        _journal.synced = std::min(_journal.synced, _applied);
+        _compacted = std::min(_compacted, _applied);
+        _checkpoints.erase(_checkpoints.upper_bound(_applied), _checkpoints.end());
+    }
+}
+
+void project_container::commit(const std::string& message, const project& next) { commit(message, project(next)); }
+
+void project_container::commit(const std::string& message, project&& next)
+{
+    FMTDXC_PHASE(commit);
+    // commits of a gesture are folded into the one made when it ends, without diffing
+    if (_gesture) {
+        _gesture->current = std::move(next);
+        _gesture->committed = true;
+        return;
+    }
+    project_commit c = make_commit([&](project_commit& _commit) {
+        _commit.message = message;
+        _commit.timestamp = std::chrono::system_clock::now();
+        diff(_proj, next, _commit.forward, _commit.backward, _executor, _backward_mode);
+    });
+
+#ifndef NDEBUG
+    // patches must lead to next and back, the rewound project may keep the entities added by the commit,
+    // checked before the redo tail is dropped so a failing commit leaves the container as it was
+    if (!is_empty(c.forward)) {
+        FMTDXC_SCRATCH_SCOPE(_scratch);
+        project _after, _rewind;
+        apply(_proj, c.forward, _after);
+        sparse_project _drift;
+        diff(_after, next, _drift);
+        if (!is_empty(_drift))
+            throw std::logic_error("fmtdxc: forward patch of the commit does not lead to the committed project");
+        apply(std::move(_after), c.backward, _rewind);
+        diff(_rewind, _proj, _drift);
+        if (!is_empty(_drift))
+            throw std::logic_error("fmtdxc: backward patch of the commit does not lead back to the project");
+    }
+#endif
+
+    // truncate redo tail if any
+    _truncate();
+    // the state before the first commit is a checkpoint too
+    _record_checkpoint();
+
+    // skip no-op commits
+    if (is_empty(c.forward)) {
+        _commit_intervals(c, next);
+        _proj = std::move(next);
+        return;
+    }
+
+    _commit_intervals(c, next);
+    _proj = std::move(next);
+    _push_commit(std::move(c));
+}
+
+void project_container::commit(const project_commit& next)
+{
+    FMTDXC_PHASE(commit);
+    end_gesture();
+    _truncate();
+    _record_checkpoint();
+    if (is_empty(next.forward))
+        return;
+    apply(_proj, next.forward);
+    _update_intervals(next.forward);
+    _push_commit(make_commit([&next](project_commit& _commit) {
+        _commit.message = next.message;
+        _commit.timestamp = next.timestamp;
+        compose(_commit.forward, next.forward);
+        compose(_commit.backward, next.backward);
+    }));
+}
+
+// appends a commit whose forward patch was already applied to _proj
+void project_container::_push_commit(project_commit&& c)
+{
+    _commits.push_back({ std::make_shared<const project_commit>(std::move(c)), 0, nullptr });
+    ++_applied;
+    _record_checkpoint();
+}
+
+bool project_container::in_gesture() const { return _gesture.has_value(); }
+
+void project_container::begin_gesture(const std::string& message)
+{
+    if (_gesture)
+        throw std::logic_error("fmtdxc: a gesture is already in progress");
+    _gesture = gesture_state { message, {}, false };
+}
+
+void project_container::end_gesture()
+{
+    if (!_gesture)
+        return;
+    gesture_state _pending = std::move(*_gesture);
+    _gesture.reset();
+    // gestures that did not commit keep the redo tail
+    if (_pending.committed)
+        commit(_pending.message, std::move(_pending.current));
+}
+
+void project_container::cancel_gesture() { _gesture.reset(); }
+
+void project_container::undo()
+{
+    FMTDXC_PHASE(undo);
+    end_gesture();
+    if (!can_undo())
+        return;
+    const auto& c = _load(_applied - 1);
+    apply(_proj, c.backward);
+    _update_intervals(c.backward);
+    --_applied;
+}
+
+void project_container::redo()
+{
+    FMTDXC_PHASE(redo);
+    end_gesture();
+    if (!can_redo())
+        return;
+    const auto& c = _load(_applied);
+    apply(_proj, c.forward);
+    _update_intervals(c.forward);
+    ++_applied;
+}
+
+void project_container::checkout(const std::size_t index)
+{
+    FMTDXC_PHASE(checkout);
+    end_gesture();
+    if (index > _commits.size() || index == _applied)
+        return;
+
+    // start from the current state or from the checkpoint that is the fewest commits away
+    std::size_t _from = _applied;
+    auto _distance = [index](const std::size_t from) { return from > index ? from - index : index - from; };
+    auto _checkpoint = _checkpoints.lower_bound(index);
+    if (_checkpoint != _checkpoints.end() && _distance(_checkpoint->first) < _distance(_from))
+        _from = _checkpoint->first;
+    if (_checkpoint != _checkpoints.begin() && _distance(std::prev(_checkpoint)->first) < _distance(_from)) {
+        --_checkpoint;
+        _from = _checkpoint->first;
+    }
+    // the index follows the state left so it is updated from what differs between that state and the checked out one
+    std::optional<project> _indexed;
+    if (_from != _applied) {
+        if (_intervals)
+            _indexed = std::move(_proj);
+        _proj = _checkpoints.at(_from);
+    }
+
+    // remaining commits are composed into a single patch so that each entity is applied once
+    {
+        FMTDXC_SCRATCH_SCOPE(_scratch);
+        sparse_project _patch;
+        if (index > _from) {
+            for (std::size_t _index = _from; _index < index; ++_index)
+                compose_into(_patch, _load(_index).forward);
+        } else {
+            for (std::size_t _index = _from; _index > index; --_index)
+                compose_into(_patch, _load(_index - 1).backward);
+        }
+        // values are moved out of the patch but its entities are still named in it
+        apply(_proj, std::move(_patch));
+        if (_indexed) {
+            sparse_project _moved;
+            name_moved_spans(*_indexed, _proj, _moved);
+            _update_intervals(_moved);
+        } else {
+            _update_intervals(_patch);
+        }
+    }
+    _applied = index;
+    _record_checkpoint();
+}
+
+// commits from first to last included that are replaced by result
+struct project_container::squash_range {
+    std::size_t first;
+    std::size_t last;
+    std::string message;
+    project_commit result;
+};
+
+void project_container::_squash(std::vector<squash_range>& ranges)
+{
+    FMTDXC_PHASE(squash);
+    if (ranges.empty())
+        return;
+
+    // ranges are independent, they are composed in parallel when an executor is set
+    std::vector<std::function<void()>> _tasks;
+    for (auto& _range : ranges) {
+        _tasks.emplace_back([this, &_range]() {
+            _range.result = make_commit([&](project_commit& _result) {
+                _result.message = _range.message;
+                _result.timestamp = _load(_range.last).timestamp;
+                for (std::size_t _index = _range.first; _index <= _range.last; ++_index)
+                    compose_into(_result.forward, _load(_index).forward);
+                // undoing the range undoes its last commit first
+                for (std::size_t _index = _range.last + 1; _index > _range.first; --_index)
+                    compose_into(_result.backward, _load(_index - 1).backward);
+            });
+        });
+    }
+    if (_executor) {
+        _executor(_tasks);
+    } else {
+        for (auto& _task : _tasks)
+            _task();
+    }
+
+    // states inside a range disappear, the following ones move down
+    auto _moved = [&ranges](const std::size_t state) -> std::optional<std::size_t> {
+        std::size_t _removed = 0;
+        for (auto& _range : ranges) {
+            if (state > _range.first && state <= _range.last)
+                return std::nullopt;
+            if (state > _range.last)
+                _removed += _range.last - _range.first;
+        }
+        return state - _removed;
+    };
+    std::vector<commit_slot> _commits_after;
+    _commits_after.reserve(_commits.size());
+    std::size_t _index = 0;
+    for (auto& _range : ranges) {
+        for (; _index < _range.first; ++_index)
+            _commits_after.push_back(std::move(_commits[_index]));
+        _commits_after.push_back({ std::make_shared<const project_commit>(std::move(_range.result)), 0, nullptr });
+        _index = _range.last + 1;
+    }
+    for (; _index < _commits.size(); ++_index)
+        _commits_after.push_back(std::move(_commits[_index]));
+    _commits = std::move(_commits_after);
+
+    std::map<std::size_t, project> _checkpoints_after;
+    for (auto& [state, checkpoint] : _checkpoints)
+        if (const auto _state = _moved(state))
+            _checkpoints_after.emplace(*_state, std::move(checkpoint));
+    _checkpoints = std::move(_checkpoints_after);
+
+    _applied = *_moved(_applied);
+    _journal.synced = std::min(_journal.synced, ranges.front().first);
+    _compacted = std::min(_compacted, ranges.front().first);
+}
+
+void project_container::squash(const std::size_t first, const std::size_t last, const std::string& message)
+{
+    if (first > last || last >= _commits.size())
+        throw std::out_of_range("fmtdxc: invalid range of commits to squash");
+    if (_applied > first && _applied <= last)
+        throw std::logic_error("fmtdxc: can not squash commits around the applied state");
+    std::vector<squash_range> _ranges;
+    _ranges.push_back({ first, last, message, {} });
+    _squash(_ranges);
+}
+
+const interval_index* project_container::get_interval_index() const { return _intervals.get(); }
+
+void project_container::set_interval_index(const bool enabled)
+{
+    if (!enabled)
+        _intervals.reset();
+    else if (!_intervals)
+        _intervals = std::make_unique<interval_index>(_proj);
+}
+
+std::optional<compaction_policy> project_container::get_compaction_policy() const { return _compaction_policy; }
+
+void project_container::set_compaction_policy(const std::optional<compaction_policy>& policy)
+{
+    _compaction_policy = policy;
+    _compacted = 0;
+}
+
+std::size_t project_container::compact_history(const std::chrono::time_point<std::chrono::system_clock>& now)
+{
+    if (!_compaction_policy || _compaction_policy->squash_period.count() <= 0)
+        return 0;
+
+    // only periods that ended before the cutoff are complete and can be squashed
+    const auto _period = _compaction_policy->squash_period;
+    const auto _period_of = [_period](const std::chrono::time_point<std::chrono::system_clock>& timestamp) {
+        auto _count = timestamp.time_since_epoch() / _period;
+        if (timestamp.time_since_epoch() < _count * _period)
+            --_count;
+        return _count;
+    };
+    const auto _cutoff = _period_of(now - _compaction_policy->keep_all_for);
+
+    std::vector<squash_range> _ranges;
+    std::size_t _index = _compacted;
+    while (_index < _commits.size()) {
+        const auto _current = _period_of(get_commit_timestamp(_index));
+        if (_current >= _cutoff)
+            break;
+        std::size_t _last = _index;
+        while (_last + 1 < _commits.size() && _period_of(get_commit_timestamp(_last + 1)) == _current)
+            ++_last;
+        if (_applied > _index && _applied <= _last)
+            break;
+        if (_last > _index)
+            _ranges.push_back({ _index, _last, get_commit_message(_last), {} });
+        _index = _last + 1;
+    }
+    std::size_t _removed = 0;
+    for (auto& _range : _ranges)
+        _removed += _range.last - _range.first;
+    const std::size_t _watermark = _index - _removed;
+    _squash(_ranges);
+    _compacted = _watermark;
+    return _removed;
+}
+
+// ---------- edit sessions ----------
+
+// keeps the value a field had before the session and writes the new one to the project and the forward patch,
+// fields that the session did not change yet are not recorded when they already hold the value and fields set
+// back to that value are no longer recorded
+template <typename T>
+static void record_field(T& current, std::optional<T>& forward, std::optional<T>& backward, const T& value)
+{
+    if (!backward && !forward && !differs(current, value))
+        return;
+    if (backward && !differs(*backward, value)) {
+        forward.reset();
+        backward.reset();
+        current = value;
+        return;
+    }
+    if (!backward)
+        backward = current;
+    forward = value;
+    current = value;
+}
+
+// the entities on the path to an edited one share a fresh stamp, like apply, untracked ones stay untracked
+template <typename... entities_t>
+static std::uint64_t stamp_path(entities_t&... entities)
+{
+    const std::uint64_t _stamp = next_generation();
+    (refresh_generation(entities, _stamp), ...);
+    return _stamp;
+}
+
+template <typename edit_t>
+static void edit_audio_clip(project& value, sparse_project& forward, sparse_project& backward, const std::uint32_t sequencer, const std::uint32_t clip, edit_t&& edit)
+{
+    auto& _sequencer = value.audio_sequencers.at(sequencer);
+    auto& _clip = _sequencer.clips.at(clip);
+    stamp_path(value, _sequencer, _clip);
+    edit(_clip, forward.audio_sequencers[sequencer].clips[clip], backward.audio_sequencers[sequencer].clips[clip]);
+}
+
+template <typename edit_t>
+static void edit_midi_clip(project& value, sparse_project& forward, sparse_project& backward, const std::uint32_t sequencer, const std::uint32_t clip, edit_t&& edit)
+{
+    auto& _sequencer = value.midi_sequencers.at(sequencer);
+    auto& _clip = _sequencer.clips.at(clip);
+    stamp_path(value, _sequencer, _clip);
+    edit(_clip, forward.midi_sequencers[sequencer].clips[clip], backward.midi_sequencers[sequencer].clips[clip]);
+}
+
+template <typename edit_t>
+static void edit_midi_note(project& value, sparse_project& forward, sparse_project& backward, const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, edit_t&& edit)
+{
+    auto& _sequencer = value.midi_sequencers.at(sequencer);
+    auto& _clip = _sequencer.clips.at(clip);
+    auto& _note = _clip.notes.at(note);
+    stamp_path(value, _sequencer, _clip, _note);
+    auto& _forward = forward.midi_sequencers[sequencer].clips[clip];
+    // the entry is applied before the operations of the forward patch, edits take their deltas off it
+    edit(_note, _forward.notes[note], backward.midi_sequencers[sequencer].clips[clip].notes[note], note_operation_deltas(_forward.operations, note));
+}
+
+template <typename edit_t>
+static void edit_mixer_track(project& value, sparse_project& forward, sparse_project& backward, const std::uint32_t track, edit_t&& edit)
+{
+    auto& _track = value.mixer_tracks.at(track);
+    stamp_path(value, _track);
+    edit(_track, forward.mixer_tracks[track], backward.mixer_tracks[track]);
+}
+
+// one operation per run of consecutive notes in id order that start within [first_tick, last_tick),
+// checked before anything is edited
+static std::vector<midi_note_operation> select_note_runs(const project::midi_clip& clip, const std::uint64_t first_tick, const std::uint64_t last_tick, const std::int64_t start_delta, const std::int32_t pitch_delta)
+{
+    std::vector<midi_note_operation> _runs;
+    if (!start_delta && !pitch_delta)
+        return _runs;
+    // the backward patch holds the negated deltas
+    if (start_delta == std::numeric_limits<std::int64_t>::min())
+        throw std::out_of_range("fmtdxc: midi note operation delta out of range");
+    bool _previous = false;
+    for (auto& [nid, note] : clip.notes) {
+        const bool _selected = note.start_tick >= first_tick && note.start_tick < last_tick;
+        if (_selected) {
+            if (start_delta < 0 ? note.start_tick < static_cast<std::uint64_t>(-(start_delta + 1)) + 1 : note.start_tick > std::numeric_limits<std::uint64_t>::max() - static_cast<std::uint64_t>(start_delta))
+                throw std::out_of_range("fmtdxc: shifted midi note out of the tick range");
+            const std::int64_t _pitch = static_cast<std::int64_t>(note.pitch) + pitch_delta;
+            if (_pitch < 0 || _pitch > std::numeric_limits<std::uint16_t>::max())
+                throw std::out_of_range("fmtdxc: transposed midi note out of the pitch range");
+            if (_previous)
+                _runs.back().last_note = nid;
+            else
+                _runs.push_back({ nid, nid, start_delta, pitch_delta });
+        }
+        _previous = _selected;
+    }
+    return _runs;
+}
+
+// operations of the forward and backward patches of a midi clip once runs are appended to them,
+// folded before anything is edited since folding deltas can overflow
+struct folded_note_operations {
+    sparse_project::note_operations forward;
+    sparse_project::note_operations backward;
+};
+
+// splits the operations that cover a note around it, so that they no longer touch it
+static void exclude_note(sparse_project::note_operations& operations, const std::uint32_t note)
+{
+    sparse_project::note_operations _split;
+    _split.reserve(operations.size() + 1);
+    for (auto& _operation : operations) {
+        if (note < _operation.first_note || note > _operation.last_note) {
+            _split.push_back(_operation);
+            continue;
+        }
+        if (note > _operation.first_note)
+            _split.push_back({ _operation.first_note, note - 1, _operation.start_delta, _operation.pitch_delta });
+        if (note < _operation.last_note)
+            _split.push_back({ note + 1, _operation.last_note, _operation.start_delta, _operation.pitch_delta });
+    }
+    operations = std::move(_split);
+}
+
+// backward patches do not name the notes added by the session, like diff does for entities that base does not hold,
+// so that their inverse operations must not cover them either
+template <typename added_t>
+static folded_note_operations fold_note_runs(sparse_project& forward, sparse_project& backward, const std::uint32_t sequencer, const std::uint32_t clip, const std::vector<midi_note_operation>& runs, const added_t& added)
+{
+    folded_note_operations _folded { forward.midi_sequencers[sequencer].clips[clip].operations, backward.midi_sequencers[sequencer].clips[clip].operations };
+    for (auto& _run : runs) {
+        append_note_operation(_folded.forward, _run);
+        append_note_operation(_folded.backward, inverse_note_operation(_run));
+    }
+    for (auto& _key : added) {
+        if (_key.sequencer == sequencer && _key.clip == clip)
+            exclude_note(_folded.backward, _key.note);
+    }
+    return _folded;
+}
+
+// operations are appended to the forward patch and their inverse to the backward patch, where it
+// is applied after the entries that it covers so that their deltas are added to them
+static void edit_midi_notes(project& value, sparse_project& forward, sparse_project& backward, const std::uint32_t sequencer, const std::uint32_t clip, const std::vector<midi_note_operation>& runs, folded_note_operations&& folded)
+{
+    auto& _sequencer = value.midi_sequencers.at(sequencer);
+    auto& _clip = _sequencer.clips.at(clip);
+    auto& _forward = forward.midi_sequencers[sequencer].clips[clip];
+    auto& _backward = backward.midi_sequencers[sequencer].clips[clip];
+    const std::uint64_t _stamp = stamp_path(value, _sequencer, _clip);
+    for (auto& _run : runs) {
+        for_each_operated_note(_clip.notes, _run, [&_run, _stamp](std::uint32_t, project::midi_note& _note) {
+            refresh_generation(_note, _stamp);
+            shift_note(_note, _run);
+        });
+        for_each_operated_note(_backward.notes, _run, [&_run](std::uint32_t, sparse_project::midi_note& _entry) { shift_note(_entry, _run); });
+    }
+    _forward.operations = std::move(folded.forward);
+    _backward.operations = std::move(folded.backward);
+}
+
+edit_session::edit_session(project_container& container)
+    : _container(container)
+{
+}
+
+// destructors must not throw, sessions that must know whether reverting failed discard explicitly
+edit_session::~edit_session()
+{
+    if (!_edits)
+        return;
+    try {
+        discard();
+    } catch (...) {
+    }
+}
+
+std::size_t edit_session::get_edit_count() const { return _edits; }
+
+// the state before the first edit is the one checkpointed for the commit
+void edit_session::_begin_edit()
+{
+    if (!_edits++) {
+        _container.end_gesture();
+        _container._record_checkpoint();
+    }
+}
+
+void edit_session::set_audio_clip_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t start_tick)
+{
+    _begin_edit();
+    edit_audio_clip(_container._proj, _forward, _backward, sequencer, clip, [start_tick](auto& _clip, auto& _forward, auto& _backward) {
+        record_field(_clip.start_tick, _forward.start_tick, _backward.start_tick, start_tick);
+    });
+}
+
+void edit_session::set_audio_clip_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t length_ticks)
+{
+    _begin_edit();
+    edit_audio_clip(_container._proj, _forward, _backward, sequencer, clip, [length_ticks](auto& _clip, auto& _forward, auto& _backward) {
+        record_field(_clip.length_ticks, _forward.length_ticks, _backward.length_ticks, length_ticks);
+    });
+}
+
+void edit_session::set_audio_clip_db(const std::uint32_t sequencer, const std::uint32_t clip, const double db)
+{
+    _begin_edit();
+    edit_audio_clip(_container._proj, _forward, _backward, sequencer, clip, [db](auto& _clip, auto& _forward, auto& _backward) {
+        record_field(_clip.db, _forward.db, _backward.db, db);
+    });
+}
+
+void edit_session::set_midi_clip_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t start_tick)
+{
+    _begin_edit();
+    edit_midi_clip(_container._proj, _forward, _backward, sequencer, clip, [start_tick](auto& _clip, auto& _forward, auto& _backward) {
+        record_field(_clip.start_tick, _forward.start_tick, _backward.start_tick, start_tick);
+    });
+}
+
+void edit_session::set_midi_clip_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t length_ticks)
+{
+    _begin_edit();
+    edit_midi_clip(_container._proj, _forward, _backward, sequencer, clip, [length_ticks](auto& _clip, auto& _forward, auto& _backward) {
+        record_field(_clip.length_ticks, _forward.length_ticks, _backward.length_ticks, length_ticks);
+    });
+}
+
+void edit_session::set_midi_note_start(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint64_t start_tick)
+{
+    _begin_edit();
+    edit_midi_note(_container._proj, _forward, _backward, sequencer, clip, note, [start_tick](auto& _note, auto& _forward, auto& _backward, const auto& _deltas) {
+        record_field(_note.start_tick, _forward.start_tick, _backward.start_tick, start_tick);
+        if (_forward.start_tick)
+            *_forward.start_tick -= static_cast<std::uint64_t>(_deltas.start_delta);
+    });
+}
+
+void edit_session::set_midi_note_length(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint64_t length_ticks)
+{
+    _begin_edit();
+    edit_midi_note(_container._proj, _forward, _backward, sequencer, clip, note, [length_ticks](auto& _note, auto& _forward, auto& _backward, const auto&) {
+        record_field(_note.length_ticks, _forward.length_ticks, _backward.length_ticks, length_ticks);
+    });
+}
+
+void edit_session::set_midi_note_pitch(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const std::uint16_t pitch)
+{
+    _begin_edit();
+    edit_midi_note(_container._proj, _forward, _backward, sequencer, clip, note, [pitch](auto& _note, auto& _forward, auto& _backward, const auto& _deltas) {
+        record_field(_note.pitch, _forward.pitch, _backward.pitch, pitch);
+        if (_forward.pitch)
+            *_forward.pitch = static_cast<std::uint16_t>(*_forward.pitch - static_cast<std::uint32_t>(_deltas.pitch_delta));
+    });
+}
+
+void edit_session::set_midi_note_velocity(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const float velocity)
+{
+    _begin_edit();
+    edit_midi_note(_container._proj, _forward, _backward, sequencer, clip, note, [velocity](auto& _note, auto& _forward, auto& _backward, const auto&) {
+        record_field(_note.velocity, _forward.velocity, _backward.velocity, velocity);
+    });
+}
+
+void edit_session::set_mixer_track_db(const std::uint32_t track, const double db)
+{
+    _begin_edit();
+    edit_mixer_track(_container._proj, _forward, _backward, track, [db](auto& _track, auto& _forward, auto& _backward) {
+        record_field(_track.db, _forward.db, _backward.db, db);
+    });
+}
+
+void edit_session::set_mixer_track_pan(const std::uint32_t track, const double pan)
+{
+    _begin_edit();
+    edit_mixer_track(_container._proj, _forward, _backward, track, [pan](auto& _track, auto& _forward, auto& _backward) {
+        record_field(_track.pan, _forward.pan, _backward.pan, pan);
+    });
+}
+
+void edit_session::shift_midi_notes(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t first_tick, const std::uint64_t last_tick, const std::int64_t delta)
+{
+    const auto _runs = select_note_runs(std::as_const(_container._proj).midi_sequencers.at(sequencer).clips.at(clip), first_tick, last_tick, delta, 0);
+    if (_runs.empty())
+        return;
+    auto _folded = fold_note_runs(_forward, _backward, sequencer, clip, _runs, _added);
+    _begin_edit();
+    edit_midi_notes(_container._proj, _forward, _backward, sequencer, clip, _runs, std::move(_folded));
+}
+
+void edit_session::transpose_midi_notes(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint64_t first_tick, const std::uint64_t last_tick, const std::int32_t semitones)
+{
+    const auto _runs = select_note_runs(std::as_const(_container._proj).midi_sequencers.at(sequencer).clips.at(clip), first_tick, last_tick, 0, semitones);
+    if (_runs.empty())
+        return;
+    auto _folded = fold_note_runs(_forward, _backward, sequencer, clip, _runs, _added);
+    _begin_edit();
+    edit_midi_notes(_container._proj, _forward, _backward, sequencer, clip, _runs, std::move(_folded));
+}
+
+// added notes are only patched forward, as diff does for entities that base does not hold
+void edit_session::add_midi_note(const std::uint32_t sequencer, const std::uint32_t clip, const std::uint32_t note, const project::midi_note& value)
+{
+    auto& _clip = _container._proj.midi_sequencers.at(sequencer).clips.at(clip);
+    if (_clip.notes.find(note) != _clip.notes.end())
+        throw std::logic_error("fmtdxc: midi clip already holds this note");
+    // operations recorded before the note was added must not cover it, so that the entry holds its fields as they are
+    // and undoing leaves it as it was added, split before anything is edited since splitting allocates
+    auto _forward_operations = _forward.midi_sequencers[sequencer].clips[clip].operations;
+    auto _backward_operations = _backward.midi_sequencers[sequencer].clips[clip].operations;
+    exclude_note(_forward_operations, note);
+    exclude_note(_backward_operations, note);
+    _added.reserve(_added.size() + 1);
+    _begin_edit();
+    edit_midi_clip(_container._proj, _forward, _backward, sequencer, clip, [&](auto& _clip, auto& _forward, auto& _backward) {
+        FMTDXC_RESOURCE_SCOPE(_clip.notes);
+        auto& _note = _clip.notes[note];
+        _note = value;
+        _note.generation = 0; // untracked, like the notes that apply adds
+        _forward.notes[note] = full_patch_midi_note(value);
+        _forward.operations = std::move(_forward_operations);
+        _backward.operations = std::move(_backward_operations);
+    });
+    _added.push_back({ sequencer, clip, note });
+}
+
+void edit_session::commit(const std::string& message)
+{
+    FMTDXC_PHASE(commit);
+    if (!_edits)
+        return;
+    // skip no-op commits, the project did not change so that the redo tail still follows it
+    if (is_empty_patch(_forward)) {
+        _forward = {};
+        _backward = {};
+        _added.clear();
+        _edits = 0;
+        return;
+    }
+    _container._truncate();
+    project_commit _commit = make_commit([this, &message](project_commit& _commit) {
+        _commit.message = message;
+        _commit.timestamp = std::chrono::system_clock::now();
+        compose(_commit.forward, std::move(_forward));
+        compose(_commit.backward, std::move(_backward));
+    });
+    _forward = {};
+    _backward = {};
+    _added.clear();
+    _edits = 0;
+    _container._update_intervals(_commit.forward);
+    _container._push_commit(std::move(_commit));
+}
+
+// the backward patch only names entities that the session found and holds operations that were checked
+// when they were recorded, so that reverting looks nothing up that can be missing. Reverting still allocates
+// when maps are shared with copies of the project and when the interval index is updated, the session is
+// emptied first so that a revert that threw is never applied again
+void edit_session::discard()
+{
+    sparse_project _forward_patch = std::move(_forward);
+    sparse_project _backward_patch = std::move(_backward);
+    std::vector<note_key> _added_notes = std::move(_added);
+    _forward = {};
+    _backward = {};
+    _added.clear();
+    _edits = 0;
+    apply(_container._proj, _backward_patch);
+    for (auto& _key : _added_notes) {
+        auto _sequencer = _container._proj.midi_sequencers.find(_key.sequencer);
+        if (_sequencer == _container._proj.midi_sequencers.end())
+            continue;
+        auto _clip = _sequencer->second.clips.find(_key.clip);
+        if (_clip != _sequencer->second.clips.end())
+            _clip->second.notes.erase(_key.note);
+    }
+    // forward names the added notes that were removed
+    _container._update_intervals(_backward_patch);
+    _container._update_intervals(_forward_patch);
+}
 }
@@ -0,0 +1,139 @@
+#include "internal.hpp"
+
+#include <algorithm>
+
+namespace fmtdxc {
+
+#if defined(FMTDXC_INSTRUMENTATION)
+
+struct instrumentation_registry {
+    std::mutex mutex;
+    std::vector<const instrumentation_block*> blocks;
+    instrumentation_slots retired {}; // from the blocks of threads that exited
+    instrumentation_slots baseline {}; // from the last reset
+    std::shared_ptr<const instrumentation_sink> sink;
+};
+
+static instrumentation_registry& get_instrumentation_registry()
+{
+    static instrumentation_registry _registry;
+    return _registry;
+}
+
+instrumentation_block::instrumentation_block()
+{
+    instrumentation_registry& _registry = get_instrumentation_registry();
+    std::lock_guard<std::mutex> _lock(_registry.mutex);
+    _registry.blocks.push_back(this);
+}
+
+instrumentation_block::~instrumentation_block()
+{
+    instrumentation_registry& _registry = get_instrumentation_registry();
+    std::lock_guard<std::mutex> _lock(_registry.mutex);
+    for (std::size_t _slot = 0; _slot < slot_count; ++_slot)
+        _registry.retired[_slot] += slots[_slot].load(std::memory_order_relaxed);
+    _registry.blocks.erase(std::find(_registry.blocks.begin(), _registry.blocks.end(), this));
+}
+
+// the registry mutex must be held
+static instrumentation_slots sum_instrumentation_blocks(const instrumentation_registry& registry)
+{
+    instrumentation_slots _slots = registry.retired;
+    for (const instrumentation_block* _block : registry.blocks)
+        for (std::size_t _slot = 0; _slot < slot_count; ++_slot)
+            _slots[_slot] += _block->slots[_slot].load(std::memory_order_relaxed);
+    return _slots;
+}
+
+static instrumentation_slots sum_instrumentation_blocks()
+{
+    instrumentation_registry& _registry = get_instrumentation_registry();
+    std::lock_guard<std::mutex> _lock(_registry.mutex);
+    return sum_instrumentation_blocks(_registry);
+}
+
+static instrumentation_stats make_instrumentation_stats(const instrumentation_slots& slots, const instrumentation_slots& since)
+{
+    auto _get = [&](const std::size_t slot) { return slots[slot] - since[slot]; };
+    instrumentation_stats _stats {};
+    _stats.nodes_visited = _get(slot_nodes_visited);
+    _stats.audio_sequencers_diffed = _get(slot_audio_sequencers_diffed);
+    _stats.audio_clips_diffed = _get(slot_audio_clips_diffed);
+    _stats.midi_sequencers_diffed = _get(slot_midi_sequencers_diffed);
+    _stats.midi_clips_diffed = _get(slot_midi_clips_diffed);
+    _stats.midi_notes_diffed = _get(slot_midi_notes_diffed);
+    _stats.mixer_tracks_diffed = _get(slot_mixer_tracks_diffed);
+    _stats.audio_effects_diffed = _get(slot_audio_effects_diffed);
+    _stats.mixer_routings_diffed = _get(slot_mixer_routings_diffed);
+    _stats.collected_audio_files_diffed = _get(slot_collected_audio_files_diffed);
+    _stats.patch_entities = _get(slot_patch_entities);
+    _stats.bytes_encoded = _get(slot_bytes_encoded);
+    _stats.bytes_decoded = _get(slot_bytes_decoded);
+    _stats.entities_allocated = _get(slot_entities_allocated) + _stats.patch_entities;
+    for (std::size_t _phase = 0; _phase < instrumentation_phase_count; ++_phase) {
+        _stats.phases[_phase].calls = _get(slot_phase_calls + _phase);
+        _stats.phases[_phase].time = std::chrono::nanoseconds(_get(slot_phase_nanoseconds + _phase));
+    }
+    return _stats;
+}
+
+static std::size_t& get_instrumentation_depth()
+{
+    thread_local std::size_t _depth = 0;
+    return _depth;
+}
+
+instrumentation_scope::instrumentation_scope(const instrumentation_phase phase)
+    : _phase(phase)
+    , _outermost(get_instrumentation_depth()++ == 0)
+{
+    if (_outermost)
+        _sink = std::atomic_load(&get_instrumentation_registry().sink);
+    if (_sink)
+        _before = sum_instrumentation_blocks();
+    _start = std::chrono::steady_clock::now();
+}
+
+instrumentation_scope::~instrumentation_scope()
+{
+    const std::chrono::steady_clock::duration _elapsed = std::chrono::steady_clock::now() - _start;
+    instrumentation_add(slot_phase_calls + static_cast<std::size_t>(_phase), 1);
+    instrumentation_add(slot_phase_nanoseconds + static_cast<std::size_t>(_phase), std::chrono::duration_cast<std::chrono::nanoseconds>(_elapsed).count());
+    --get_instrumentation_depth();
+    if (_sink)
+        (*_sink)(_phase, make_instrumentation_stats(sum_instrumentation_blocks(), _before));
+}
+
+#endif
+
+instrumentation_stats get_instrumentation_stats()
+{
+#if defined(FMTDXC_INSTRUMENTATION)
+    instrumentation_registry& _registry = get_instrumentation_registry();
+    std::lock_guard<std::mutex> _lock(_registry.mutex);
+    return make_instrumentation_stats(sum_instrumentation_blocks(_registry), _registry.baseline);
+#else
+    return {};
+#endif
+}
+
+void reset_instrumentation_stats()
+{
+#if defined(FMTDXC_INSTRUMENTATION)
+    instrumentation_registry& _registry = get_instrumentation_registry();
+    std::lock_guard<std::mutex> _lock(_registry.mutex);
+    _registry.baseline = sum_instrumentation_blocks(_registry);
+#endif
+}
+
+void set_instrumentation_sink(const instrumentation_sink& sink)
+{
+#if defined(FMTDXC_INSTRUMENTATION)
+    std::atomic_store(&get_instrumentation_registry().sink, sink ? std::make_shared<const instrumentation_sink>(sink) : std::shared_ptr<const instrumentation_sink>());
+#else
+    (void)sink;
+#endif
+}
+
+}
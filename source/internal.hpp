@@ -0,0 +1,566 @@
+#pragma once
+
+// internals shared by the source files of the library, not part of its interface
+
+#include <fmtdxc/fmtdxc.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fmtdxc {
+
+// ---------- instrumentation ----------
+
+#if defined(FMTDXC_INSTRUMENTATION)
+
+// counters in the order of instrumentation_stats, then calls and nanoseconds of each phase
+enum instrumentation_slot : std::size_t {
+    slot_nodes_visited,
+    slot_audio_sequencers_diffed,
+    slot_audio_clips_diffed,
+    slot_midi_sequencers_diffed,
+    slot_midi_clips_diffed,
+    slot_midi_notes_diffed,
+    slot_mixer_tracks_diffed,
+    slot_audio_effects_diffed,
+    slot_mixer_routings_diffed,
+    slot_collected_audio_files_diffed,
+    slot_patch_entities,
+    slot_bytes_encoded,
+    slot_bytes_decoded,
+    slot_entities_allocated,
+    slot_phase_calls,
+    slot_phase_nanoseconds = slot_phase_calls + instrumentation_phase_count,
+    slot_count = slot_phase_nanoseconds + instrumentation_phase_count
+};
+
+using instrumentation_slots = std::array<std::uint64_t, slot_count>;
+
+// only written by its own thread so that counting needs no atomic read-modify-write
+struct instrumentation_block {
+    std::array<std::atomic<std::uint64_t>, slot_count> slots {};
+    instrumentation_block();
+    ~instrumentation_block();
+};
+
+inline void instrumentation_add(const std::size_t slot, const std::uint64_t amount)
+{
+    thread_local instrumentation_block _block;
+    std::atomic<std::uint64_t>& _value = _block.slots[slot];
+    _value.store(_value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+template <typename T>
+constexpr std::size_t diffed_slot()
+{
+    if constexpr (std::is_same_v<T, project::audio_sequencer>)
+        return slot_audio_sequencers_diffed;
+    else if constexpr (std::is_same_v<T, project::audio_clip>)
+        return slot_audio_clips_diffed;
+    else if constexpr (std::is_same_v<T, project::midi_sequencer>)
+        return slot_midi_sequencers_diffed;
+    else if constexpr (std::is_same_v<T, project::midi_clip>)
+        return slot_midi_clips_diffed;
+    else if constexpr (std::is_same_v<T, project::midi_note>)
+        return slot_midi_notes_diffed;
+    else if constexpr (std::is_same_v<T, project::mixer_track>)
+        return slot_mixer_tracks_diffed;
+    else if constexpr (std::is_same_v<T, project::audio_effect>)
+        return slot_audio_effects_diffed;
+    else if constexpr (std::is_same_v<T, project::mixer_routing>)
+        return slot_mixer_routings_diffed;
+    else
+        return slot_collected_audio_files_diffed;
+}
+
+// times a phase and reports the outermost phase of each thread to the sink
+struct instrumentation_scope {
+    instrumentation_scope(const instrumentation_phase phase);
+    ~instrumentation_scope();
+
+private:
+    instrumentation_phase _phase;
+    bool _outermost;
+    std::shared_ptr<const instrumentation_sink> _sink;
+    instrumentation_slots _before;
+    std::chrono::steady_clock::time_point _start;
+};
+
+// counts how much a size grew between its construction and its destruction
+template <typename size_fn_t>
+struct instrumentation_growth {
+    instrumentation_growth(const std::size_t slot, size_fn_t size)
+        : _slot(slot)
+        , _size(std::move(size))
+        , _start(_size())
+    {
+    }
+
+    ~instrumentation_growth()
+    {
+        const std::uint64_t _end = _size();
+        if (_end > _start)
+            instrumentation_add(_slot, _end - _start);
+    }
+
+private:
+    std::size_t _slot;
+    size_fn_t _size;
+    std::uint64_t _start;
+};
+
+#define FMTDXC_CONCAT_IMPL(a, b) a##b
+#define FMTDXC_CONCAT(a, b) FMTDXC_CONCAT_IMPL(a, b)
+#define FMTDXC_COUNT(counter, amount) instrumentation_add(slot_##counter, static_cast<std::uint64_t>(amount))
+#define FMTDXC_COUNT_DIFFED(entity_t) instrumentation_add(diffed_slot<entity_t>(), 1)
+#define FMTDXC_COUNT_GROWTH(counter, size) const instrumentation_growth FMTDXC_CONCAT(_instrumentation_growth_, __LINE__)(slot_##counter, [&]() { return static_cast<std::uint64_t>(size); })
+#define FMTDXC_PHASE(phase) const instrumentation_scope _instrumentation_scope(instrumentation_phase::phase)
+
+#else
+
+#define FMTDXC_COUNT(counter, amount) ((void)0)
+#define FMTDXC_COUNT_DIFFED(entity_t) ((void)0)
+#define FMTDXC_COUNT_GROWTH(counter, size) ((void)0)
+#define FMTDXC_PHASE(phase) ((void)0)
+
+#endif
+
+// ---------- memory resources ----------
+
+#if defined(FMTDXC_PMR)
+
+// empty while the calling thread allocates from the default resource
+inline std::shared_ptr<std::pmr::memory_resource>& get_thread_resource()
+{
+    thread_local std::shared_ptr<std::pmr::memory_resource> _resource;
+    return _resource;
+}
+
+inline std::shared_ptr<std::pmr::memory_resource> make_arena()
+{
+    return std::make_shared<std::pmr::monotonic_buffer_resource>();
+}
+
+// allocates from a scratch arena that is released when the scope ends, objects allocated from it must not outlive the scope
+struct scratch_scope {
+    scratch_scope(std::shared_ptr<std::pmr::monotonic_buffer_resource>& scratch)
+        : _scratch(scratch ? scratch : scratch = std::make_shared<std::pmr::monotonic_buffer_resource>())
+        , _scope(_scratch)
+    {
+    }
+
+    ~scratch_scope()
+    {
+        _scratch->release();
+    }
+
+private:
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> _scratch;
+    resource_scope _scope;
+};
+
+// tasks get an arena of their own when the calling thread allocates from a resource of its own,
+// memory resources are not thread safe
+template <typename task_t>
+inline std::function<void()> make_task(task_t&& task)
+{
+    if (!get_thread_resource())
+        return std::forward<task_t>(task);
+    return [task = std::forward<task_t>(task)]() {
+        const resource_scope _scope(make_arena());
+        task();
+    };
+}
+
+#define FMTDXC_ARENA_SCOPE() const resource_scope _arena_scope(make_arena())
+#define FMTDXC_SCRATCH_SCOPE(scratch) const scratch_scope _scratch_scope(scratch)
+#define FMTDXC_RESOURCE_SCOPE(map) const resource_scope _resource_scope((map).get_allocator().get_resource())
+
+#else
+
+template <typename task_t>
+inline std::function<void()> make_task(task_t&& task)
+{
+    return std::forward<task_t>(task);
+}
+
+#define FMTDXC_ARENA_SCOPE() ((void)0)
+#define FMTDXC_SCRATCH_SCOPE(scratch) ((void)0)
+#define FMTDXC_RESOURCE_SCOPE(map) ((void)0)
+
+#endif
+
+inline bool differs(double a, double b, double eps = 1e-9)
+{
+    return std::fabs(a - b) > eps;
+}
+
+inline bool differs(float a, float b, float eps = 1e-6f)
+{
+    return std::fabs(a - b) > eps;
+}
+
+template <typename T>
+inline bool differs(const T& a, const T& b)
+{
+    return a != b;
+}
+
+template <typename T>
+inline void set_if(T& dst, const std::optional<T>& maybe)
+{
+    if (maybe)
+        dst = *maybe;
+}
+
+template <typename T>
+inline void set_if(T& dst, std::optional<T>&& maybe)
+{
+    if (maybe)
+        dst = std::move(*maybe);
+}
+
+// forwards a member of a patch with the value category of the patch it belongs to
+template <typename patch_t, typename T>
+inline decltype(auto) forward_member(T& member)
+{
+    if constexpr (std::is_lvalue_reference_v<patch_t>)
+        return static_cast<const T&>(member);
+    else
+        return std::move(member);
+}
+
+// ---------- field lists ----------
+
+// members of each record in archive order, listed once for the dense and the sparse record. The diff, apply,
+// compose, merge, emptiness and serialization of record values are generated from these lists, while maps of
+// child entities are walked by each entity on its own, such as the effects and routings of mixer tracks
+template <typename record_t>
+struct record_fields {
+    static constexpr bool is_record = false;
+};
+
+#define FMTDXC_FIELD(member) visit(#member, [](auto& record) -> auto& { return record.member; })
+
+#define FMTDXC_RECORD_FIELDS(Nested, BODY)                           \
+    struct Nested##_fields {                                         \
+        static constexpr bool is_record = true;                      \
+        template <typename visit_t>                                  \
+        static void visit(visit_t&& visit) { BODY }                  \
+    };                                                               \
+    template <>                                                      \
+    struct record_fields<project::Nested> : Nested##_fields {        \
+        static constexpr bool is_sparse = false;                     \
+    };                                                               \
+    template <>                                                      \
+    struct record_fields<sparse_project::Nested> : Nested##_fields { \
+        static constexpr bool is_sparse = true;                      \
+    };
+
+FMTDXC_RECORD_FIELDS(audio_effect, {
+    FMTDXC_FIELD(name);
+})
+
+FMTDXC_RECORD_FIELDS(midi_instrument, {
+    FMTDXC_FIELD(name);
+})
+
+FMTDXC_RECORD_FIELDS(collected_audio_file, {
+    FMTDXC_FIELD(data);
+    FMTDXC_FIELD(collected_relative_path);
+})
+
+FMTDXC_RECORD_FIELDS(audio_clip, {
+    FMTDXC_FIELD(name);
+    FMTDXC_FIELD(start_tick);
+    FMTDXC_FIELD(length_ticks);
+    FMTDXC_FIELD(file);
+    FMTDXC_FIELD(file_start_frame);
+    FMTDXC_FIELD(db);
+    FMTDXC_FIELD(is_loop);
+})
+
+FMTDXC_RECORD_FIELDS(midi_mpe, {
+    FMTDXC_FIELD(channel);
+    FMTDXC_FIELD(pressure);
+    FMTDXC_FIELD(slide);
+    FMTDXC_FIELD(timbre);
+})
+
+FMTDXC_RECORD_FIELDS(midi_note, {
+    FMTDXC_FIELD(start_tick);
+    FMTDXC_FIELD(length_ticks);
+    FMTDXC_FIELD(pitch);
+    FMTDXC_FIELD(velocity);
+    FMTDXC_FIELD(mpe);
+})
+
+FMTDXC_RECORD_FIELDS(midi_clip, {
+    FMTDXC_FIELD(name);
+    FMTDXC_FIELD(start_tick);
+    FMTDXC_FIELD(length_ticks);
+    FMTDXC_FIELD(notes);
+    FMTDXC_FIELD(operations);
+})
+
+FMTDXC_RECORD_FIELDS(audio_sequencer, {
+    FMTDXC_FIELD(name);
+    FMTDXC_FIELD(clips);
+    FMTDXC_FIELD(output);
+})
+
+FMTDXC_RECORD_FIELDS(midi_sequencer, {
+    FMTDXC_FIELD(name);
+    FMTDXC_FIELD(instrument);
+    FMTDXC_FIELD(clips);
+    FMTDXC_FIELD(output);
+})
+
+FMTDXC_RECORD_FIELDS(mixer_routing, {
+    FMTDXC_FIELD(db);
+    FMTDXC_FIELD(output);
+})
+
+FMTDXC_RECORD_FIELDS(mixer_track, {
+    FMTDXC_FIELD(name);
+    FMTDXC_FIELD(db);
+    FMTDXC_FIELD(pan);
+    FMTDXC_FIELD(effects);
+    FMTDXC_FIELD(routings);
+})
+
+// the root layouts of the containers are archived by hand, its list only drives diff, apply, compose and merge
+struct project_fields {
+    static constexpr bool is_record = true;
+    template <typename visit_t>
+    static void visit(visit_t&& visit)
+    {
+        FMTDXC_FIELD(name);
+        FMTDXC_FIELD(ppq);
+        FMTDXC_FIELD(audio_sequencers);
+        FMTDXC_FIELD(midi_sequencers);
+        FMTDXC_FIELD(mixer_tracks);
+        FMTDXC_FIELD(collected_audio_files);
+        FMTDXC_FIELD(master_track_id);
+    }
+};
+
+template <>
+struct record_fields<project> : project_fields {
+    static constexpr bool is_sparse = false;
+};
+
+template <>
+struct record_fields<sparse_project> : project_fields {
+    static constexpr bool is_sparse = true;
+};
+
+template <typename T>
+struct is_optional : std::false_type { };
+
+template <typename T>
+struct is_optional<std::optional<T>> : std::true_type { };
+
+template <typename T, typename = void>
+struct is_entity_map : std::false_type { };
+
+template <typename T>
+struct is_entity_map<T, std::void_t<typename T::mapped_type>> : std::true_type { };
+
+template <typename T>
+using member_type = std::remove_cv_t<std::remove_reference_t<T>>;
+
+// values are the members that a record holds by itself, as opposed to its maps of child entities and note operations
+template <typename T>
+inline constexpr bool is_value_member = !is_entity_map<T>::value && !std::is_same_v<T, std::monostate> && !std::is_same_v<T, std::vector<midi_note_operation>>;
+
+// nested records such as midi_mpe are values that hold values of their own
+template <typename T>
+inline constexpr bool is_nested_record = record_fields<T>::is_record;
+
+// compared exactly, unlike differs, so that values close to the default still round trip
+template <typename record_t>
+inline bool is_default_record(const record_t& x)
+{
+    const record_t _default {};
+    bool _is_default = true;
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        using value_t = member_type<decltype(field(x))>;
+        if constexpr (is_nested_record<value_t>)
+            _is_default = _is_default && is_default_record(field(x));
+        else if constexpr (is_value_member<value_t>)
+            _is_default = _is_default && field(x) == field(_default);
+    });
+    return _is_default;
+}
+
+template <typename record_t>
+inline bool is_empty_record(const record_t& x)
+{
+    bool _empty = true;
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        const auto& _member = field(x);
+        using member_t = member_type<decltype(_member)>;
+        if constexpr (is_optional<member_t>::value) {
+            if constexpr (is_nested_record<typename member_t::value_type>)
+                _empty = _empty && (!_member || is_empty_record(*_member));
+            else
+                _empty = _empty && !_member;
+        } else if constexpr (!std::is_same_v<member_t, std::monostate>) {
+            _empty = _empty && _member.empty();
+        }
+    });
+    return _empty;
+}
+
+// nested records are only patched when they hold something else than their defaults
+template <typename record_t, typename sparse_record_t>
+inline void full_patch_fields(const record_t& s, sparse_record_t& p)
+{
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        const auto& _value = field(s);
+        using value_t = member_type<decltype(_value)>;
+        if constexpr (is_nested_record<value_t>) {
+            if (!is_default_record(_value))
+                full_patch_fields(_value, field(p).emplace());
+        } else if constexpr (is_value_member<value_t>) {
+            field(p) = _value;
+        }
+    });
+}
+
+inline bool is_empty_audio_clip(const sparse_project::audio_clip& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_midi_note(const sparse_project::midi_note& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_midi_clip(const sparse_project::midi_clip& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_audio_sequencer(const sparse_project::audio_sequencer& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_midi_sequencer(const sparse_project::midi_sequencer& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_audio_effect(const sparse_project::audio_effect& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_mixer_routing(const sparse_project::mixer_routing& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_mixer_track(const sparse_project::mixer_track& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty_collected_audio_file(const sparse_project::collected_audio_file& x)
+{
+    return is_empty_record(x);
+}
+
+inline bool is_empty(const sparse_project& x)
+{
+    return is_empty_record(x);
+}
+
+// patches built in place can hold entries of entities whose edits did not change anything,
+// unlike the ones diff builds where empty entries are never inserted
+template <typename record_t>
+inline bool is_empty_patch(const record_t& x)
+{
+    bool _empty = true;
+    record_fields<record_t>::visit([&](const char*, auto&& field) {
+        const auto& _member = field(x);
+        using member_t = member_type<decltype(_member)>;
+        if constexpr (is_entity_map<member_t>::value) {
+            for (auto& [_id, _entry] : _member)
+                _empty = _empty && is_empty_patch(_entry);
+        } else if constexpr (is_optional<member_t>::value) {
+            if constexpr (is_nested_record<typename member_t::value_type>)
+                _empty = _empty && (!_member || is_empty_record(*_member));
+            else
+                _empty = _empty && !_member;
+        } else if constexpr (!std::is_same_v<member_t, std::monostate>) {
+            _empty = _empty && _member.empty();
+        }
+    });
+    return _empty;
+}
+
+// ---------- note operations ----------
+
+// visits the notes of a map whose ids are covered by an operation
+template <typename notes_t, typename visit_t>
+inline void for_each_operated_note(notes_t& notes, const midi_note_operation& operation, visit_t&& visit)
+{
+    for (auto _note = notes.lower_bound(operation.first_note); _note != notes.end() && _note->first <= operation.last_note; ++_note)
+        visit(_note->first, _note->second);
+}
+
+// ---------- interning ----------
+
+// strings of version::alpha_interned payloads in the order they were first encoded. The table of a
+// container only grows, so that records copied as is from its file stay valid in the files written after
+struct string_table {
+    std::vector<std::string> values;
+    std::unordered_map<std::string, std::uint32_t> indices;
+
+    std::uint32_t insert(const std::string& value)
+    {
+        auto [_it, _inserted] = indices.emplace(value, static_cast<std::uint32_t>(values.size()));
+        if (_inserted)
+            values.push_back(value);
+        return _it->second;
+    }
+
+    const std::string& at(const std::uint64_t index) const
+    {
+        if (index >= values.size())
+            throw std::runtime_error("fmtdxc: invalid string index in dawxchange container");
+        return values[static_cast<std::size_t>(index)];
+    }
+};
+
+// ---------- commits ----------
+
+// the patches of each commit allocate from an arena of their own when FMTDXC_PMR is defined,
+// the arena is released at once when the commit is truncated, squashed or destroyed
+template <typename fill_t>
+inline project_commit make_commit(fill_t&& fill)
+{
+    FMTDXC_ARENA_SCOPE();
+    project_commit _commit;
+    fill(_commit);
+    return _commit;
+}
+
+}
@@ -0,0 +1,307 @@
+#include "internal.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace fmtdxc {
+
+// ---------- interval index ----------
+
+// treap ordered by start tick then key, where each node also holds the largest end tick of its subtree
+// so that queries skip the subtrees that end before the queried range
+struct interval_tree {
+    static constexpr std::uint32_t none = std::numeric_limits<std::uint32_t>::max();
+
+    struct node {
+        std::uint64_t start;
+        std::uint64_t end;
+        std::uint64_t max_end;
+        std::uint64_t key;
+        std::uint32_t priority;
+        std::uint32_t left;
+        std::uint32_t right;
+    };
+
+    std::vector<node> nodes;
+    std::vector<std::uint32_t> released;
+    std::unordered_map<std::uint64_t, std::uint32_t> slots;
+    std::uint32_t root = none;
+    std::uint32_t seed = 0x9e3779b9u;
+
+    void assign(const std::uint64_t key, const std::uint64_t start, const std::uint64_t length)
+    {
+        // zero length entities span their start tick
+        const std::uint64_t _max = std::numeric_limits<std::uint64_t>::max();
+        const std::uint64_t _end = std::max<std::uint64_t>(length, 1) > _max - start ? _max : start + std::max<std::uint64_t>(length, 1);
+        auto _slot = slots.find(key);
+        if (_slot != slots.end()) {
+            const node& _node = nodes[_slot->second];
+            if (_node.start == start && _node.end == _end)
+                return;
+            remove(key);
+        }
+        std::uint32_t _index;
+        if (released.empty()) {
+            _index = static_cast<std::uint32_t>(nodes.size());
+            nodes.emplace_back();
+        } else {
+            _index = released.back();
+            released.pop_back();
+        }
+        // xorshift priorities keep the treap balanced in expectation
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        nodes[_index] = { start, _end, _end, key, seed, none, none };
+        slots.emplace(key, _index);
+        root = _insert(root, _index);
+    }
+
+    void remove(const std::uint64_t key)
+    {
+        auto _slot = slots.find(key);
+        if (_slot == slots.end())
+            return;
+        root = _erase(root, nodes[_slot->second].start, key);
+        released.push_back(_slot->second);
+        slots.erase(_slot);
+    }
+
+    template <typename visit_t>
+    void find(const std::uint64_t first, const std::uint64_t last, visit_t&& visit) const
+    {
+        _find(root, first, last, visit);
+    }
+
+private:
+    static bool _less(const std::uint64_t start, const std::uint64_t key, const node& other)
+    {
+        return start < other.start || (start == other.start && key < other.key);
+    }
+
+    static bool _less(const node& value, const std::uint64_t start, const std::uint64_t key)
+    {
+        return value.start < start || (value.start == start && value.key < key);
+    }
+
+    void _pull(const std::uint32_t index)
+    {
+        node& _node = nodes[index];
+        _node.max_end = _node.end;
+        if (_node.left != none)
+            _node.max_end = std::max(_node.max_end, nodes[_node.left].max_end);
+        if (_node.right != none)
+            _node.max_end = std::max(_node.max_end, nodes[_node.right].max_end);
+    }
+
+    // splits a subtree into the nodes ordered before the pivot and the others
+    void _split(const std::uint32_t index, const std::uint64_t start, const std::uint64_t key, std::uint32_t& left, std::uint32_t& right)
+    {
+        if (index == none) {
+            left = right = none;
+            return;
+        }
+        if (_less(nodes[index], start, key)) {
+            _split(nodes[index].right, start, key, nodes[index].right, right);
+            left = index;
+        } else {
+            _split(nodes[index].left, start, key, left, nodes[index].left);
+            right = index;
+        }
+        _pull(index);
+    }
+
+    std::uint32_t _merge(const std::uint32_t left, const std::uint32_t right)
+    {
+        if (left == none)
+            return right;
+        if (right == none)
+            return left;
+        if (nodes[left].priority > nodes[right].priority) {
+            nodes[left].right = _merge(nodes[left].right, right);
+            _pull(left);
+            return left;
+        }
+        nodes[right].left = _merge(left, nodes[right].left);
+        _pull(right);
+        return right;
+    }
+
+    std::uint32_t _insert(const std::uint32_t index, const std::uint32_t inserted)
+    {
+        if (index == none)
+            return inserted;
+        node& _inserted = nodes[inserted];
+        if (_inserted.priority > nodes[index].priority) {
+            _split(index, _inserted.start, _inserted.key, _inserted.left, _inserted.right);
+            _pull(inserted);
+            return inserted;
+        }
+        if (_less(_inserted.start, _inserted.key, nodes[index]))
+            nodes[index].left = _insert(nodes[index].left, inserted);
+        else
+            nodes[index].right = _insert(nodes[index].right, inserted);
+        _pull(index);
+        return index;
+    }
+
+    std::uint32_t _erase(const std::uint32_t index, const std::uint64_t start, const std::uint64_t key)
+    {
+        if (index == none)
+            return none;
+        if (nodes[index].key == key && nodes[index].start == start)
+            return _merge(nodes[index].left, nodes[index].right);
+        if (_less(start, key, nodes[index]))
+            nodes[index].left = _erase(nodes[index].left, start, key);
+        else
+            nodes[index].right = _erase(nodes[index].right, start, key);
+        _pull(index);
+        return index;
+    }
+
+    template <typename visit_t>
+    void _find(const std::uint32_t index, const std::uint64_t first, const std::uint64_t last, visit_t& visit) const
+    {
+        if (index == none || nodes[index].max_end <= first)
+            return;
+        const node& _node = nodes[index];
+        _find(_node.left, first, last, visit);
+        // the right subtree starts after this node
+        if (_node.start >= last)
+            return;
+        if (_node.end > first)
+            visit(_node);
+        _find(_node.right, first, last, visit);
+    }
+};
+
+static std::uint64_t clip_key(const std::uint32_t sequencer, const std::uint32_t clip)
+{
+    return (static_cast<std::uint64_t>(sequencer) << 32) | clip;
+}
+
+static clip_ref to_clip_ref(const std::uint64_t key)
+{
+    return { static_cast<std::uint32_t>(key >> 32), static_cast<std::uint32_t>(key) };
+}
+
+struct interval_index::state {
+    interval_tree audio_clips;
+    interval_tree midi_clips;
+    std::unordered_map<std::uint64_t, interval_tree> notes; // by key of their midi clip
+};
+
+interval_index::interval_index()
+    : _state(std::make_unique<state>())
+{
+}
+
+interval_index::interval_index(const project& value)
+    : interval_index()
+{
+    build(value);
+}
+
+interval_index::interval_index(interval_index&& other) = default;
+
+interval_index& interval_index::operator=(interval_index&& other) = default;
+
+interval_index::~interval_index() = default;
+
+void interval_index::build(const project& value)
+{
+    *_state = state {};
+    for (auto& [asid, as] : value.audio_sequencers)
+        for (auto& [cid, clip] : as.clips)
+            _state->audio_clips.assign(clip_key(asid, cid), clip.start_tick, clip.length_ticks);
+    for (auto& [msid, ms] : value.midi_sequencers) {
+        for (auto& [cid, clip] : ms.clips) {
+            _state->midi_clips.assign(clip_key(msid, cid), clip.start_tick, clip.length_ticks);
+            interval_tree& _notes = _state->notes[clip_key(msid, cid)];
+            for (auto& [nid, note] : clip.notes)
+                _notes.assign(nid, note.start_tick, note.length_ticks);
+        }
+    }
+}
+
+// only the entities named in diffs are visited, their ticks are read back from the project they were applied to.
+// Entities named in diffs that the project does not hold were deleted from it
+void interval_index::update(const project& value, const sparse_project& diffs)
+{
+    for (auto& [asid, asp] : diffs.audio_sequencers) {
+        auto _sequencer = value.audio_sequencers.find(asid);
+        for (auto& [cid, cp] : asp.clips) {
+            const project::audio_clip* _clip = nullptr;
+            if (_sequencer != value.audio_sequencers.end()) {
+                auto _found = _sequencer->second.clips.find(cid);
+                if (_found != _sequencer->second.clips.end())
+                    _clip = &_found->second;
+            }
+            if (_clip)
+                _state->audio_clips.assign(clip_key(asid, cid), _clip->start_tick, _clip->length_ticks);
+            else
+                _state->audio_clips.remove(clip_key(asid, cid));
+        }
+    }
+    for (auto& [msid, msp] : diffs.midi_sequencers) {
+        auto _sequencer = value.midi_sequencers.find(msid);
+        for (auto& [cid, cp] : msp.clips) {
+            const project::midi_clip* _clip = nullptr;
+            if (_sequencer != value.midi_sequencers.end()) {
+                auto _found = _sequencer->second.clips.find(cid);
+                if (_found != _sequencer->second.clips.end())
+                    _clip = &_found->second;
+            }
+            if (!_clip) {
+                _state->midi_clips.remove(clip_key(msid, cid));
+                _state->notes.erase(clip_key(msid, cid));
+                continue;
+            }
+            _state->midi_clips.assign(clip_key(msid, cid), _clip->start_tick, _clip->length_ticks);
+            if (cp.notes.empty() && cp.operations.empty())
+                continue;
+            interval_tree& _notes = _state->notes[clip_key(msid, cid)];
+            for (auto& [nid, np] : cp.notes) {
+                auto _note = _clip->notes.find(nid);
+                if (_note != _clip->notes.end())
+                    _notes.assign(nid, _note->second.start_tick, _note->second.length_ticks);
+                else
+                    _notes.remove(nid);
+            }
+            // operations move notes that the patch does not name
+            for (auto& _operation : cp.operations)
+                for_each_operated_note(_clip->notes, _operation, [&_notes](const std::uint32_t _id, const project::midi_note& _note) { _notes.assign(_id, _note.start_tick, _note.length_ticks); });
+        }
+    }
+}
+
+void interval_index::find_audio_clips(const std::uint64_t first, const std::uint64_t last, std::vector<clip_ref>& result) const
+{
+    _state->audio_clips.find(first, last, [&result](const interval_tree::node& _clip) { result.push_back(to_clip_ref(_clip.key)); });
+}
+
+void interval_index::find_midi_clips(const std::uint64_t first, const std::uint64_t last, std::vector<clip_ref>& result) const
+{
+    _state->midi_clips.find(first, last, [&result](const interval_tree::node& _clip) { result.push_back(to_clip_ref(_clip.key)); });
+}
+
+void interval_index::find_midi_notes(const std::uint64_t first, const std::uint64_t last, std::vector<note_ref>& result) const
+{
+    _state->midi_clips.find(first, last, [this, first, last, &result](const interval_tree::node& _clip) {
+        auto _notes = _state->notes.find(_clip.key);
+        if (_notes == _state->notes.end())
+            return;
+        // the clip starts before last, notes are searched in ticks relative to it
+        const clip_ref _ref = to_clip_ref(_clip.key);
+        _notes->second.find(first > _clip.start ? first - _clip.start : 0, last - _clip.start, [&_ref, &result](const interval_tree::node& _note) {
+            result.push_back({ _ref.sequencer, _ref.clip, static_cast<std::uint32_t>(_note.key) });
+        });
+    });
+}
+
+void apply(project& base, const sparse_project& diffs, interval_index& index)
+{
+    apply(base, diffs);
+    index.update(base, diffs);
+}
+}
@@ -0,0 +1,100 @@
+#include <fmtdxc/fmtdxc.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace fmtdxc {
+
+// ---------- thread_pool methods ----------
+struct thread_pool::state {
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::deque<std::function<void()>> queue;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+};
+
+thread_pool::thread_pool(const std::size_t thread_count)
+    : _state(std::make_unique<state>())
+{
+    std::size_t _count = thread_count ? thread_count : std::thread::hardware_concurrency();
+    // the thread calling run() also works on the batch
+    for (std::size_t _i = 1; _i < _count; ++_i) {
+        _state->threads.emplace_back([s = _state.get()]() {
+            std::unique_lock<std::mutex> _lock(s->mutex);
+            while (true) {
+                s->wake.wait(_lock, [s]() { return s->stopping || !s->queue.empty(); });
+                if (s->queue.empty())
+                    return;
+                auto _task = std::move(s->queue.front());
+                s->queue.pop_front();
+                _lock.unlock();
+                _task();
+                _lock.lock();
+            }
+        });
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    {
+        std::lock_guard<std::mutex> _lock(_state->mutex);
+        _state->stopping = true;
+    }
+    _state->wake.notify_all();
+    for (auto& _thread : _state->threads)
+        _thread.join();
+}
+
+std::size_t thread_pool::get_thread_count() const { return _state->threads.size() + 1; }
+
+void thread_pool::run(const std::vector<std::function<void()>>& tasks)
+{
+    std::size_t _remaining = tasks.size();
+    std::exception_ptr _error;
+    {
+        std::lock_guard<std::mutex> _lock(_state->mutex);
+        for (auto& _task : tasks) {
+            _state->queue.emplace_back([this, &_task, &_remaining, &_error]() {
+                std::exception_ptr _task_error;
+                try {
+                    _task();
+                } catch (...) {
+                    _task_error = std::current_exception();
+                }
+                std::lock_guard<std::mutex> _lock(_state->mutex);
+                if (_task_error && !_error)
+                    _error = _task_error;
+                if (--_remaining == 0)
+                    _state->done.notify_all();
+            });
+        }
+    }
+    _state->wake.notify_all();
+
+    std::unique_lock<std::mutex> _lock(_state->mutex);
+    while (_remaining > 0) {
+        if (!_state->queue.empty()) {
+            auto _task = std::move(_state->queue.front());
+            _state->queue.pop_front();
+            _lock.unlock();
+            _task();
+            _lock.lock();
+        } else {
+            _state->done.wait(_lock);
+        }
+    }
+    if (_error)
+        std::rethrow_exception(_error);
+}
+
+executor make_executor(thread_pool& pool)
+{
+    return [&pool](const std::vector<std::function<void()>>& tasks) { pool.run(tasks); };
+}
+}
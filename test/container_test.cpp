@@ -0,0 +1,372 @@
+#include "fmtdxc_test.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+static std::filesystem::path temp_path(const std::string& name)
+{
+    const std::filesystem::path _path = std::filesystem::temp_directory_path() / ("fmtdxc_" + name);
+    std::filesystem::remove(_path);
+    return _path;
+}
+
+static void round_trip(const version ver)
+{
+    std::vector<project> _states { make_project(60) };
+    project_container _container(_states.front());
+    const std::vector<char> _bytes(100000, 'x');
+    const blob_digest _digest = _container.put_blob(_bytes.data(), _bytes.size());
+    for (std::uint32_t _index = 1; _index < 8; ++_index) {
+        _states.push_back(edit_project(_states.back(), 60 + _index, 6));
+        if (_index == 3)
+            _states.back().collected_audio_files[0].data = _digest;
+        _container.commit("edit " + std::to_string(_index), _states.back());
+    }
+    _container.undo();
+    _container.undo();
+
+    std::stringstream _stream;
+    export_container(_stream, _container, ver);
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    FMTDXC_CHECK(_detected == ver);
+    FMTDXC_CHECK(_imported.get_commit_count() == _container.get_commit_count());
+    FMTDXC_CHECK(_imported.get_applied_count() == _container.get_applied_count());
+    for (std::size_t _index = 0; _index < _container.get_commit_count(); ++_index)
+        FMTDXC_CHECK(_imported.get_commit_message(_index) == _container.get_commit_message(_index));
+    for (std::size_t _index = _states.size(); _index-- > 0;) {
+        _imported.checkout(_index);
+        if (ver == version::alpha)
+            FMTDXC_CHECK(same(alpha_view(_imported.get_project()), alpha_view(_states[_index])));
+        else
+            FMTDXC_CHECK(same(_imported.get_project(), _states[_index]));
+    }
+    if (ver != version::alpha)
+        FMTDXC_CHECK(_imported.get_blob(_digest) == _bytes);
+
+    // files are memory mapped and decode commits on demand
+    if (ver != version::alpha) {
+        const std::filesystem::path _path = temp_path("round_trip.dxc");
+        {
+            std::ofstream _file(_path, std::ios::binary);
+            export_container(_file, _container, ver);
+        }
+        project_container _mapped;
+        import_container(_path, _mapped, _detected);
+        FMTDXC_CHECK(_detected == ver);
+        FMTDXC_CHECK(same(_mapped.get_project(), _container.get_project()));
+        _mapped.checkout(0);
+        FMTDXC_CHECK(same(_mapped.get_project(), _states.front()));
+        _mapped.checkout(_states.size() - 1);
+        FMTDXC_CHECK(same(_mapped.get_project(), _states.back()));
+        FMTDXC_CHECK(_mapped.get_blob(_digest) == _bytes);
+        std::filesystem::remove(_path);
+    }
+}
+
+static void journal_torn_tail()
+{
+    const std::filesystem::path _path = temp_path("journal.dxc");
+    std::vector<project> _states { make_project(70) };
+    project_container _container(_states.front());
+    compact_container(_path, _container);
+    for (std::uint32_t _index = 1; _index < 4; ++_index) {
+        _states.push_back(edit_project(_states.back(), 70 + _index, 6));
+        _container.commit("edit", _states.back());
+        append_journal(_path, _container);
+    }
+    const auto _intact = std::filesystem::file_size(_path);
+    _states.push_back(edit_project(_states.back(), 80, 6));
+    _container.commit("torn", _states.back());
+    append_journal(_path, _container);
+    FMTDXC_CHECK(std::filesystem::file_size(_path) > _intact);
+
+    {
+        project_container _imported;
+        version _detected;
+        import_container(_path, _imported, _detected);
+        FMTDXC_CHECK(_imported.get_commit_count() == 4);
+        FMTDXC_CHECK(same(_imported.get_project(), _states.back()));
+    }
+
+    // readers replay the journal before streaming its commits
+    {
+        container_reader _reader(_path);
+        FMTDXC_CHECK(_reader.get_commit_count() == 4 && _reader.get_applied_count() == 4);
+        FMTDXC_CHECK(same(_reader.get_project(), _states.back()));
+        std::size_t _read = 0;
+        while (_reader.read_commit())
+            ++_read;
+        FMTDXC_CHECK(_read == 4);
+    }
+
+    // an append interrupted anywhere in its last record leaves the commits journaled before it
+    const auto _full = std::filesystem::file_size(_path);
+    for (const auto _size : { _full - 1, _intact + (_full - _intact) / 2, _intact + 1 }) {
+        std::filesystem::resize_file(_path, _size);
+        project_container _imported;
+        version _detected;
+        import_container(_path, _imported, _detected);
+        FMTDXC_CHECK(_imported.get_commit_count() == 3);
+        FMTDXC_CHECK(_imported.get_applied_count() == 3);
+        FMTDXC_CHECK(same(_imported.get_project(), _states[3]));
+        _imported.checkout(0);
+        FMTDXC_CHECK(same(_imported.get_project(), _states.front()));
+    }
+
+    // the torn tail is overwritten by the next append
+    {
+        project_container _imported;
+        version _detected;
+        import_container(_path, _imported, _detected);
+        const project _next = edit_project(_imported.get_project(), 90, 6);
+        _imported.commit("after", _next);
+        append_journal(_path, _imported);
+        project_container _reimported;
+        import_container(_path, _reimported, _detected);
+        FMTDXC_CHECK(_reimported.get_commit_count() == 4);
+        FMTDXC_CHECK(same(_reimported.get_project(), _next));
+
+        // journaled undos are replayed backward
+        _reimported.undo();
+        append_journal(_path, _reimported);
+        project_container _undone;
+        import_container(_path, _undone, _detected);
+        FMTDXC_CHECK(_undone.get_commit_count() == 4 && _undone.get_applied_count() == 3);
+        FMTDXC_CHECK(same(_undone.get_project(), _states[3]));
+    }
+    std::filesystem::remove(_path);
+}
+
+// blobs are split into chunks of 64 KiB that are stored once however many blobs hold them
+static void blob_chunks_are_deduplicated()
+{
+    constexpr std::size_t _chunk = 64 * 1024;
+    std::vector<char> _first(4 * _chunk);
+    const char _fills[] = { 'a', 'b', 'a', 'c' };
+    for (std::size_t _index = 0; _index < _first.size(); ++_index)
+        _first[_index] = _fills[_index / _chunk];
+    std::vector<char> _second = _first;
+    std::fill(_second.begin() + 3 * _chunk, _second.end(), 'd');
+    _second.insert(_second.end(), 100, 'a');
+
+    project_container _container(make_project(75));
+    const blob_digest _digest = _container.put_blob(_first.data(), _first.size());
+    FMTDXC_CHECK(_container.put_blob(_first.data(), _first.size()) == _digest);
+    blob_stats _stats = _container.get_blob_stats();
+    FMTDXC_CHECK(_stats.blobs == 1 && _stats.chunks == 3 && _stats.bytes == 3 * _chunk);
+
+    const blob_digest _other = _container.put_blob(_second.data(), _second.size());
+    FMTDXC_CHECK(_other != _digest);
+    _stats = _container.get_blob_stats();
+    FMTDXC_CHECK(_stats.blobs == 2 && _stats.chunks == 5 && _stats.bytes == 4 * _chunk + 100);
+    FMTDXC_CHECK(_container.get_blob_size(_other) == _second.size());
+    FMTDXC_CHECK(_container.get_blob(_digest) == _first);
+    FMTDXC_CHECK(_container.get_blob(_other) == _second);
+
+    // exported containers keep the chunks deduplicated
+    project _next = _container.get_project();
+    _next.collected_audio_files[0].data = _digest;
+    _next.collected_audio_files[1].data = _other;
+    _container.commit("collect", _next);
+    std::stringstream _stream;
+    export_container(_stream, _container, version::alpha_indexed);
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    _stats = _imported.get_blob_stats();
+    FMTDXC_CHECK(_stats.blobs == 2 && _stats.chunks == 5 && _stats.bytes == 4 * _chunk + 100);
+    FMTDXC_CHECK(_imported.get_blob(_other) == _second);
+}
+
+static project_container make_exported(std::vector<project>& states, const std::uint32_t seed)
+{
+    states = { make_project(seed) };
+    project_container _container(states.front());
+    for (std::uint32_t _index = 1; _index < 6; ++_index) {
+        states.push_back(edit_project(states.back(), seed + _index, 6));
+        _container.commit("edit " + std::to_string(_index), states.back());
+    }
+    return _container;
+}
+
+static void export_async_reports_progress()
+{
+    std::vector<project> _states;
+    project_container _container = make_exported(_states, 110);
+    std::stringstream _stream;
+    std::vector<std::size_t> _written;
+    std::size_t _total = 0;
+    export_task _task = export_container_async(_stream, _container, version::alpha_indexed, [&](const std::size_t written, const std::size_t total) {
+        _written.push_back(written);
+        _total = total;
+    });
+    _task.get_future().get();
+    FMTDXC_CHECK(!_written.empty() && _total > 1);
+    for (std::size_t _index = 0; _index < _written.size(); ++_index)
+        FMTDXC_CHECK(_written[_index] == _index + 1);
+    FMTDXC_CHECK(_written.back() == _total);
+
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    FMTDXC_CHECK(_imported.get_commit_count() == 5);
+    FMTDXC_CHECK(same(_imported.get_project(), _states.back()));
+}
+
+static void export_async_cancels()
+{
+    std::vector<project> _states;
+    project_container _container = make_exported(_states, 120);
+    std::stringstream _stream;
+    std::promise<void> _started, _released;
+    std::shared_future<void> _release = _released.get_future().share();
+    export_task _task = export_container_async(_stream, _container, version::alpha_indexed, [&_started, _release](const std::size_t written, const std::size_t) {
+        if (written == 1) {
+            _started.set_value();
+            _release.wait();
+        }
+    });
+    _started.get_future().wait();
+    _task.cancel();
+    _released.set_value();
+    bool _threw = false;
+    try {
+        _task.get_future().get();
+    } catch (const std::runtime_error&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw);
+}
+
+// the export writes the container as it was when it started while commits continue on the calling thread
+static void export_async_while_committing()
+{
+    std::vector<project> _states;
+    project_container _container = make_exported(_states, 130);
+    _container.undo();
+    std::stringstream _stream;
+    std::promise<void> _started, _released;
+    std::shared_future<void> _release = _released.get_future().share();
+    export_task _task = export_container_async(_stream, _container, version::alpha_interned, [&_started, _release](const std::size_t written, const std::size_t) {
+        if (written == 1) {
+            _started.set_value();
+            _release.wait();
+        }
+    });
+    _started.get_future().wait();
+    project _next = _container.get_project();
+    for (std::uint32_t _index = 0; _index < 4; ++_index) {
+        _next = edit_project(_next, 140 + _index, 6);
+        _container.commit("after", _next);
+    }
+    _container.undo();
+    _released.set_value();
+    _task.get_future().get();
+
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    FMTDXC_CHECK(_imported.get_commit_count() == 5);
+    FMTDXC_CHECK(_imported.get_applied_count() == 4);
+    FMTDXC_CHECK(same(_imported.get_project(), _states[4]));
+    _imported.redo();
+    FMTDXC_CHECK(same(_imported.get_project(), _states[5]));
+    FMTDXC_CHECK(_container.get_commit_count() == 8);
+}
+
+// decoding a commit keeps its message, and concurrent readers decode each commit once
+static void lazy_commits_keep_references()
+{
+    std::vector<project> _states;
+    project_container _container = make_exported(_states, 150);
+    std::stringstream _stream;
+    export_container(_stream, _container, version::alpha_indexed);
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+
+    const std::string& _message = _imported.get_commit_message(0);
+    const std::string _expected = _message;
+    const project_commit& _commit = _imported.get_commit(0);
+    for (auto& _each : _imported.get_commits())
+        FMTDXC_CHECK(!_each.message.empty());
+    _imported.undo();
+    _imported.redo();
+    std::stringstream _exported;
+    export_container(_exported, _imported, version::alpha_columnar);
+    FMTDXC_CHECK(&_message == &_imported.get_commit_message(0) && _message == _expected);
+    FMTDXC_CHECK(&_commit == &_imported.get_commit(0));
+
+    project_container _shared;
+    _stream.clear();
+    _stream.seekg(0);
+    import_container(_stream, _shared, _detected);
+    std::vector<const project_commit*> _decoded(4 * _shared.get_commit_count());
+    std::vector<std::thread> _threads;
+    for (std::size_t _thread = 0; _thread < 4; ++_thread) {
+        _threads.emplace_back([&_shared, &_decoded, _thread]() {
+            for (std::size_t _index = 0; _index < _shared.get_commit_count(); ++_index)
+                _decoded[_thread * _shared.get_commit_count() + _index] = &_shared.get_commit(_index);
+        });
+    }
+    for (auto& _thread : _threads)
+        _thread.join();
+    for (std::size_t _index = 0; _index < _decoded.size(); ++_index)
+        FMTDXC_CHECK(_decoded[_index] == &_shared.get_commit(_index % _shared.get_commit_count()));
+}
+
+// note start ticks are written as deltas, ticks above INT64_MAX must survive them in dense and sparse columns
+static void large_ticks_round_trip(const version ver)
+{
+    constexpr std::uint64_t _max = std::numeric_limits<std::uint64_t>::max();
+    project _base = make_project(170, 1, 1, 4);
+    auto& _notes = _base.midi_sequencers.begin()->second.clips.begin()->second.notes;
+    _notes[0].start_tick = _max - 1;
+    _notes[2].start_tick = 3;
+    _notes[4].start_tick = static_cast<std::uint64_t>(std::numeric_limits<std::int64_t>::max()) + 1;
+    _notes[6].start_tick = _max;
+    project_container _container(_base);
+    project _next = _base;
+    auto& _next_notes = _next.midi_sequencers.begin()->second.clips.begin()->second.notes;
+    _next_notes[0].start_tick = 0;
+    _next_notes[2].start_tick = _max;
+    _next_notes[6].start_tick = 1;
+    _container.commit("wrap", _next);
+
+    std::stringstream _stream;
+    export_container(_stream, _container, ver);
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    FMTDXC_CHECK(same(_imported.get_project(), _next));
+    _imported.undo();
+    FMTDXC_CHECK(same(_imported.get_project(), _base));
+}
+
+int main()
+{
+    round_trip(version::alpha);
+    round_trip(version::alpha_indexed);
+    round_trip(version::alpha_columnar);
+    round_trip(version::alpha_interned);
+    journal_torn_tail();
+    blob_chunks_are_deduplicated();
+    export_async_reports_progress();
+    export_async_cancels();
+    export_async_while_committing();
+    lazy_commits_keep_references();
+    large_ticks_round_trip(version::alpha_columnar);
+    large_ticks_round_trip(version::alpha_interned);
+    return 0;
+}
@@ -0,0 +1,204 @@
+#include "fmtdxc_test.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <variant>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+struct exported {
+    std::vector<project> states;
+    project_container container;
+};
+
+static void make_exported(exported& value, const std::uint32_t seed)
+{
+    value.states = { make_project(seed) };
+    value.container = project_container(value.states.front());
+    for (std::uint32_t _index = 1; _index < 6; ++_index) {
+        value.states.push_back(edit_project(value.states.back(), seed + _index, 6));
+        value.container.commit("edit " + std::to_string(_index), value.states.back());
+    }
+    value.container.undo();
+}
+
+// compares what the version holds, version::alpha only archives part of the projects
+static bool same_as_written(const project& a, const project& b, const version ver)
+{
+    return ver == version::alpha ? same(alpha_view(a), alpha_view(b)) : same(a, b);
+}
+
+static void check_imported(std::istream& stream, const exported& value, const version ver)
+{
+    project_container _imported;
+    version _detected;
+    import_container(stream, _imported, _detected);
+    FMTDXC_CHECK(_detected == ver);
+    FMTDXC_CHECK(_imported.get_commit_count() == value.container.get_commit_count());
+    FMTDXC_CHECK(_imported.get_applied_count() == value.container.get_applied_count());
+    for (std::size_t _index = 0; _index < _imported.get_commit_count(); ++_index) {
+        FMTDXC_CHECK(_imported.get_commit_message(_index) == value.container.get_commit_message(_index));
+        FMTDXC_CHECK(_imported.get_commit_timestamp(_index) == value.container.get_commit_timestamp(_index));
+    }
+    for (std::size_t _index = value.states.size(); _index-- > 0;) {
+        _imported.checkout(_index);
+        FMTDXC_CHECK(same_as_written(_imported.get_project(), value.states[_index], ver));
+    }
+}
+
+// a reader and a writer copy a container one commit at a time
+static void reader_feeds_writer(const version ver)
+{
+    exported _value;
+    make_exported(_value, 190);
+    std::stringstream _input;
+    export_container(_input, _value.container, ver);
+
+    container_reader _reader(_input);
+    FMTDXC_CHECK(_reader.get_version() == ver);
+    FMTDXC_CHECK(_reader.get_applied_count() == 4 && _reader.get_commit_count() == 5);
+    FMTDXC_CHECK(same_as_written(_reader.get_project(), _value.states[4], ver));
+    std::stringstream _output;
+    container_writer _writer(_output, ver, _reader.get_project(), _reader.get_applied_count(), _reader.get_commit_count());
+    while (std::shared_ptr<const project_commit> _commit = _reader.read_commit()) {
+        FMTDXC_CHECK(_commit->message == _value.container.get_commit_message(_reader.get_commit_index() - 1));
+        _writer.write_commit(*_commit);
+    }
+    FMTDXC_CHECK(_reader.get_commit_index() == 5);
+    FMTDXC_CHECK(!_reader.read_commit());
+    _writer.finish();
+    check_imported(_output, _value, ver);
+
+    // commits read without their patches only hold their metadata
+    std::stringstream _again;
+    export_container(_again, _value.container, ver);
+    container_reader _metadata(_again);
+    while (std::shared_ptr<const project_commit> _commit = _metadata.read_commit(false)) {
+        FMTDXC_CHECK(_commit->message == _value.container.get_commit_message(_metadata.get_commit_index() - 1));
+        FMTDXC_CHECK(_commit->forward.mixer_tracks.empty() && _commit->backward.mixer_tracks.empty() && !_commit->forward.name);
+    }
+}
+
+// a container goes through json lines and back to the same version
+static void json_lines_round_trip(const version ver)
+{
+    exported _value;
+    make_exported(_value, 200);
+    std::stringstream _json;
+    container_info _info;
+    _info.ver = ver;
+    _info.applied = _value.container.get_applied_count();
+    _info.commit_count = _value.container.get_commit_count();
+    _info.last_commit = _info.commit_count;
+    export_json_line(_json, _info);
+    export_json_line(_json, _value.container.get_project());
+    for (std::size_t _index = 0; _index < _info.commit_count; ++_index)
+        export_json_line(_json, _value.container.get_commit(_index));
+
+    json_line _line;
+    FMTDXC_CHECK(import_json_line(_json, _line) && std::holds_alternative<container_info>(_line));
+    const container_info _read = std::get<container_info>(_line);
+    FMTDXC_CHECK(_read.ver == ver && _read.applied == 4 && _read.commit_count == 5 && _read.first_commit == 0 && _read.last_commit == 5);
+    FMTDXC_CHECK(_read.has_project && _read.has_patches);
+    FMTDXC_CHECK(import_json_line(_json, _line) && std::holds_alternative<project>(_line));
+    FMTDXC_CHECK(same(std::get<project>(_line), _value.states[4]));
+    std::stringstream _output;
+    container_writer _writer(_output, _read.ver, std::get<project>(_line), _read.applied, _read.commit_count);
+    std::size_t _count = 0;
+    while (import_json_line(_json, _line)) {
+        FMTDXC_CHECK(std::holds_alternative<project_commit>(_line));
+        _writer.write_commit(std::get<project_commit>(_line));
+        ++_count;
+    }
+    FMTDXC_CHECK(_count == 5);
+    _writer.finish();
+    check_imported(_output, _value, ver);
+}
+
+static std::string quote(const std::filesystem::path& path)
+{
+    return "\"" + path.string() + "\"";
+}
+
+static int run(const std::string& command)
+{
+    return std::system(command.c_str());
+}
+
+static std::vector<json_line> read_lines(const std::filesystem::path& path)
+{
+    std::ifstream _file(path, std::ios::binary);
+    std::vector<json_line> _lines;
+    json_line _line;
+    while (import_json_line(_file, _line))
+        _lines.push_back(_line);
+    return _lines;
+}
+
+// the converters are given as arguments by ctest
+static void tools_convert(const std::string& dxcc2json, const std::string& json2dxcc)
+{
+    const std::filesystem::path _directory = std::filesystem::temp_directory_path() / "fmtdxc_convert";
+    std::filesystem::remove_all(_directory);
+    std::filesystem::create_directories(_directory);
+    exported _value;
+    make_exported(_value, 210);
+    {
+        std::ofstream _file(_directory / "input.dxcc", std::ios::binary);
+        export_container(_file, _value.container, version::alpha_indexed);
+    }
+
+    // a complete conversion goes back to a container of any version
+    FMTDXC_CHECK(run(dxcc2json + " " + quote(_directory / "input.dxcc") + " " + quote(_directory / "full.json")) == 0);
+    FMTDXC_CHECK(run(json2dxcc + " --version alpha_columnar " + quote(_directory / "full.json") + " " + quote(_directory / "output.dxcc")) == 0);
+    {
+        std::ifstream _file(_directory / "output.dxcc", std::ios::binary);
+        check_imported(_file, _value, version::alpha_columnar);
+    }
+
+    // a range of commits only holds these commits and can not be written back
+    FMTDXC_CHECK(run(dxcc2json + " --commits 1:3 " + quote(_directory / "input.dxcc") + " " + quote(_directory / "range.json")) == 0);
+    std::vector<json_line> _lines = read_lines(_directory / "range.json");
+    FMTDXC_CHECK(_lines.size() == 4);
+    const container_info _range = std::get<container_info>(_lines[0]);
+    FMTDXC_CHECK(_range.first_commit == 1 && _range.last_commit == 3 && _range.commit_count == 5 && _range.has_patches);
+    FMTDXC_CHECK(same(std::get<project>(_lines[1]), _value.states[4]));
+    FMTDXC_CHECK(std::get<project_commit>(_lines[2]).message == "edit 2" && std::get<project_commit>(_lines[3]).message == "edit 3");
+    project _replayed = _value.states[1];
+    apply(_replayed, std::get<project_commit>(_lines[2]).forward);
+    apply(_replayed, std::get<project_commit>(_lines[3]).forward);
+    FMTDXC_CHECK(same(_replayed, _value.states[3]));
+    FMTDXC_CHECK(run(json2dxcc + " " + quote(_directory / "range.json") + " " + quote(_directory / "range.dxcc")) != 0);
+
+    // metadata only holds the messages and timestamps of the commits
+    FMTDXC_CHECK(run(dxcc2json + " --metadata-only " + quote(_directory / "input.dxcc") + " " + quote(_directory / "metadata.json")) == 0);
+    _lines = read_lines(_directory / "metadata.json");
+    FMTDXC_CHECK(_lines.size() == 6);
+    const container_info _metadata = std::get<container_info>(_lines[0]);
+    FMTDXC_CHECK(!_metadata.has_project && !_metadata.has_patches && _metadata.last_commit == 5);
+    for (std::size_t _index = 1; _index < _lines.size(); ++_index) {
+        const project_commit& _commit = std::get<project_commit>(_lines[_index]);
+        FMTDXC_CHECK(_commit.message == "edit " + std::to_string(_index));
+        FMTDXC_CHECK(_commit.timestamp == _value.container.get_commit_timestamp(_index - 1));
+        FMTDXC_CHECK(_commit.forward.midi_sequencers.empty() && _commit.forward.mixer_tracks.empty());
+    }
+    FMTDXC_CHECK(run(json2dxcc + " " + quote(_directory / "metadata.json") + " " + quote(_directory / "metadata.dxcc")) != 0);
+    std::filesystem::remove_all(_directory);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc == 3) {
+        tools_convert(argv[1], argv[2]);
+        return 0;
+    }
+    for (const version _version : { version::alpha, version::alpha_indexed, version::alpha_columnar, version::alpha_interned }) {
+        reader_feeds_writer(_version);
+        json_lines_round_trip(_version);
+    }
+    return 0;
+}
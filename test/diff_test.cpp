@@ -0,0 +1,301 @@
+#include "fmtdxc_test.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+static void apply_in_place_and_moved()
+{
+    const project _base = make_project(0);
+    const project _other = edit_project(_base, 1, 40);
+    sparse_project _forward;
+    diff(_base, _other, _forward);
+
+    project _applied;
+    apply(_base, _forward, _applied);
+    FMTDXC_CHECK(same(_applied, _other));
+    project _in_place = _base;
+    apply(_in_place, _forward);
+    FMTDXC_CHECK(same(_in_place, _other));
+
+    // moving the base or the patch out gives the same project
+    project _from_moved;
+    apply(project(_base), _forward, _from_moved);
+    FMTDXC_CHECK(same(_from_moved, _other));
+    project _moved = _base;
+    apply(_moved, std::move(_forward));
+    FMTDXC_CHECK(same(_moved, _other));
+}
+
+static void forward_and_backward_round_trip()
+{
+    const project _base = make_project(1);
+    const project _other = edit_project(_base, 2, 40);
+    sparse_project _forward, _backward;
+    diff(_base, _other, _forward, _backward);
+
+    project _applied;
+    apply(_base, _forward, _applied);
+    FMTDXC_CHECK(same(_applied, _other));
+    apply(_applied, _backward);
+    FMTDXC_CHECK(same(_applied, _base));
+
+    // the backward patch of overwritten mode only restores the fields that the forward patch sets
+    sparse_project _overwritten;
+    diff(_base, _other, _forward, _overwritten, backward_mode::overwritten);
+    apply(_applied, _forward);
+    apply(_applied, _overwritten);
+    FMTDXC_CHECK(same(_applied, _base));
+}
+
+static void same_projects_diff_empty()
+{
+    const project _base = make_project(3);
+    sparse_project _forward, _backward;
+    diff(_base, _base, _forward, _backward);
+    project _applied = _base;
+    apply(_applied, _forward);
+    FMTDXC_CHECK(same(_applied, _base));
+    FMTDXC_CHECK(_forward.midi_sequencers.empty() && _forward.audio_sequencers.empty() && _forward.mixer_tracks.empty() && !_forward.name);
+    FMTDXC_CHECK(_backward.midi_sequencers.empty() && _backward.audio_sequencers.empty() && _backward.mixer_tracks.empty() && !_backward.name);
+}
+
+static void added_entities_are_patched_forward()
+{
+    const project _base = make_project(4);
+    project _other = _base;
+    auto& _clip = _other.midi_sequencers.begin()->second.clips[900];
+    _clip.name = "new";
+    _clip.length_ticks = 960;
+    _clip.notes[0].pitch = 60;
+    _clip.notes[0].mpe.channel = 2;
+    _other.mixer_tracks[100].name = "bus";
+    sparse_project _forward;
+    diff(_base, _other, _forward);
+    project _applied = _base;
+    apply(_applied, _forward);
+    FMTDXC_CHECK(same(_applied, _other));
+}
+
+static void parallel_diff_matches_serial()
+{
+    const project _base = make_project(5, 12);
+    project _other = edit_project(_base, 6, 60);
+    // with chunks of 2, the removed sequencers 7 and 13 and track 4 start chunks of the base, the added
+    // sequencers 6 and 12 start chunks of the other project and its added tracks 12 and 13 end and start its last ones
+    _other.midi_sequencers.erase(7);
+    _other.midi_sequencers.erase(13);
+    _other.midi_sequencers[6] = _base.midi_sequencers.at(1);
+    _other.midi_sequencers[12] = _base.midi_sequencers.at(4);
+    _other.mixer_tracks.erase(4);
+    _other.mixer_tracks[12].name = "bus";
+    _other.mixer_tracks[13].name = "aux";
+    sparse_project _serial_forward, _serial_backward, _parallel_forward, _parallel_backward;
+    diff(_base, _other, _serial_forward, _serial_backward);
+    thread_pool _pool(4);
+    diff(_base, _other, _parallel_forward, _parallel_backward, make_executor(_pool), backward_mode::full, 2);
+    FMTDXC_CHECK(same(_parallel_forward, _serial_forward));
+    FMTDXC_CHECK(same(_parallel_backward, _serial_backward));
+    FMTDXC_CHECK(_parallel_forward.midi_sequencers.count(6) == 1 && _parallel_forward.midi_sequencers.count(7) == 0);
+    FMTDXC_CHECK(_parallel_backward.midi_sequencers.count(7) == 1 && _parallel_backward.mixer_tracks.count(4) == 1);
+}
+
+// subtrees stamped with the same generation on both sides are skipped, touched ones are diffed
+static void untouched_generations_are_skipped()
+{
+    project _base = make_project(6);
+    for (auto& [_id, _sequencer] : _base.midi_sequencers)
+        touch(_sequencer);
+    touch(_base);
+    project _other = _base;
+    auto& _untouched = _other.midi_sequencers.begin()->second;
+    auto& _touched = std::prev(_other.midi_sequencers.end())->second;
+    const std::uint32_t _touched_id = std::prev(_other.midi_sequencers.end())->first;
+    _untouched.name = "untouched";
+    _touched.name = "touched";
+
+    // the project itself was not touched, so nothing is compared
+    sparse_project _forward, _backward;
+    diff(_base, _other, _forward, _backward);
+    FMTDXC_CHECK(_forward.midi_sequencers.empty() && _backward.midi_sequencers.empty());
+
+    touch(_touched);
+    touch(_other);
+    diff(_base, _other, _forward, _backward);
+    FMTDXC_CHECK(_forward.midi_sequencers.size() == 1 && _forward.midi_sequencers.count(_touched_id) == 1);
+    FMTDXC_CHECK(_forward.midi_sequencers.at(_touched_id).name == std::string("touched"));
+    FMTDXC_CHECK(_backward.midi_sequencers.at(_touched_id).name == _base.midi_sequencers.at(_touched_id).name);
+
+    // untracked entities are always compared
+    project _untracked = _other;
+    _untracked.generation = 0;
+    diff(_base, _untracked, _forward, _backward);
+    FMTDXC_CHECK(_forward.midi_sequencers.size() == 1);
+    _untouched.generation = 0;
+    diff(_base, _other, _forward, _backward);
+    FMTDXC_CHECK(_forward.midi_sequencers.size() == 2);
+}
+
+static std::uint8_t compare_note_scalar(const midi_note_columns& a, const midi_note_columns& b, const std::size_t index)
+{
+    std::uint8_t _mask = 0;
+    if (a.start_ticks[index] != b.start_ticks[index])
+        _mask |= midi_note_mask::start_tick;
+    if (a.length_ticks[index] != b.length_ticks[index])
+        _mask |= midi_note_mask::length_ticks;
+    if (a.pitches[index] != b.pitches[index])
+        _mask |= midi_note_mask::pitch;
+    if (std::fabs(a.velocities[index] - b.velocities[index]) > 1e-6f)
+        _mask |= midi_note_mask::velocity;
+    return _mask;
+}
+
+// note counts that are not a multiple of the vector width also exercise the scalar tail
+static void note_columns_match_scalar()
+{
+    for (const std::uint32_t _count : { 3u, 64u, 203u }) {
+        const project _base = make_project(7, 1, 1, _count);
+        const project::midi_clip& _clip = _base.midi_sequencers.begin()->second.clips.begin()->second;
+        project::midi_clip _edited = _clip;
+        std::uint32_t _index = 0;
+        for (auto& [_id, _note] : _edited.notes) {
+            switch (_index++ % 7) {
+            case 0:
+                _note.start_tick += 1;
+                break;
+            case 1:
+                _note.length_ticks += 1ull << 40;
+                break;
+            case 2:
+                _note.pitch = static_cast<std::uint16_t>(_note.pitch ^ 0x100);
+                break;
+            case 3:
+                _note.velocity += 0.25f;
+                break;
+            case 4:
+                // below the epsilon of velocities
+                _note.velocity += 1e-7f;
+                break;
+            case 5:
+                _note.start_tick ^= 1ull << 63;
+                _note.pitch = static_cast<std::uint16_t>(_note.pitch + 1);
+                _note.velocity = -_note.velocity - 1.0f;
+                break;
+            default:
+                break;
+            }
+        }
+
+        midi_note_columns _a, _b;
+        to_columns(_clip, _a);
+        to_columns(_edited, _b);
+        FMTDXC_CHECK(_a.ids.size() == _count);
+        std::vector<std::uint8_t> _masks;
+        compare_note_columns(_a, _b, _masks);
+        FMTDXC_CHECK(_masks.size() == _count);
+        for (std::size_t _note = 0; _note < _count; ++_note)
+            FMTDXC_CHECK(_masks[_note] == compare_note_scalar(_a, _b, _note));
+
+        // dense clips diff through the kernel and give the same patch as the note by note diff of other clips
+        project _other = _base;
+        _other.midi_sequencers.begin()->second.clips.begin()->second = _edited;
+        sparse_project _forward, _backward;
+        diff(_base, _other, _forward, _backward);
+        const auto& _notes = _forward.midi_sequencers.begin()->second.clips.begin()->second.notes;
+        std::size_t _changed = 0;
+        for (std::size_t _note = 0; _note < _count; ++_note) {
+            if (!_masks[_note])
+                continue;
+            ++_changed;
+            const auto& _patch = _notes.at(_a.ids[_note]);
+            FMTDXC_CHECK(bool(_patch.start_tick) == bool(_masks[_note] & midi_note_mask::start_tick));
+            FMTDXC_CHECK(bool(_patch.length_ticks) == bool(_masks[_note] & midi_note_mask::length_ticks));
+            FMTDXC_CHECK(bool(_patch.pitch) == bool(_masks[_note] & midi_note_mask::pitch));
+            FMTDXC_CHECK(bool(_patch.velocity) == bool(_masks[_note] & midi_note_mask::velocity));
+        }
+        FMTDXC_CHECK(_notes.size() == _changed);
+
+        // notes whose velocity only moved within the epsilon keep their value
+        project _expected = _other;
+        auto& _expected_notes = _expected.midi_sequencers.begin()->second.clips.begin()->second.notes;
+        for (std::size_t _note = 0; _note < _count; ++_note)
+            if (!_masks[_note])
+                _expected_notes.at(_a.ids[_note]) = _clip.notes.at(_a.ids[_note]);
+        project _applied = _base;
+        apply(_applied, _forward);
+        FMTDXC_CHECK(same(_applied, _expected));
+        apply(_applied, _backward);
+        FMTDXC_CHECK(same(_applied, _base));
+    }
+}
+
+static void compose_applies_like_both()
+{
+    const project _first = make_project(8);
+    const project _second = edit_project(_first, 9, 30);
+    const project _third = edit_project(_second, 10, 30);
+    sparse_project _a, _b, _composed;
+    diff(_first, _second, _a);
+    diff(_second, _third, _b);
+    compose(_a, _b, _composed);
+    project _applied = _first;
+    apply(_applied, _composed);
+    FMTDXC_CHECK(same(_applied, _third));
+
+    // composing in place and from a moved patch gives the same patch
+    compose(_a, std::move(_b));
+    _applied = _first;
+    apply(_applied, _a);
+    FMTDXC_CHECK(same(_applied, _third));
+}
+
+// the effects and routings of mixer tracks are diffed, applied and composed like the other entities
+static void mixer_track_children_are_diffed()
+{
+    const project _base = make_project(11);
+    project _other = _base;
+    auto& _track = _other.mixer_tracks.begin()->second;
+    _track.effects.at(0).name = "compressor";
+    _track.effects[5].name = "reverb";
+    _track.routings.at(1).db = -12;
+    _track.routings.at(1).output = 2;
+    sparse_project _forward, _backward;
+    diff(_base, _other, _forward, _backward);
+    FMTDXC_CHECK(_forward.mixer_tracks.size() == 1);
+    project _applied = _base;
+    apply(_applied, _forward);
+    FMTDXC_CHECK(same(_applied, _other));
+    apply(_applied, _backward);
+    FMTDXC_CHECK(same_map(_applied.mixer_tracks.begin()->second.routings, _base.mixer_tracks.begin()->second.routings));
+    FMTDXC_CHECK(_applied.mixer_tracks.begin()->second.effects.at(0).name == "eq");
+
+    project _third = _other;
+    _third.mixer_tracks.begin()->second.routings.at(1).db = -24;
+    sparse_project _second, _composed;
+    diff(_other, _third, _second);
+    compose(_forward, _second, _composed);
+    _applied = _base;
+    apply(_applied, _composed);
+    FMTDXC_CHECK(same(_applied, _third));
+
+    project_container _container(_base);
+    _container.commit("routing", _third);
+    _container.undo();
+    _container.redo();
+    FMTDXC_CHECK(same(_container.get_project(), _third));
+}
+
+int main()
+{
+    apply_in_place_and_moved();
+    forward_and_backward_round_trip();
+    same_projects_diff_empty();
+    added_entities_are_patched_forward();
+    parallel_diff_matches_serial();
+    untouched_generations_are_skipped();
+    note_columns_match_scalar();
+    compose_applies_like_both();
+    mixer_track_children_are_diffed();
+    return 0;
+}
@@ -0,0 +1,364 @@
+#include "fmtdxc_test.hpp"
+
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+using namespace fmtdxc_test;
+
+static void commit_matches_plain_commit()
+{
+    const project _base = make_project(200);
+    project_container _session_container(_base);
+    project_container _plain_container(_base);
+    _session_container.set_interval_index(true);
+
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const auto& _clips = _base.midi_sequencers.begin()->second.clips;
+    const std::uint32_t _clip = _clips.begin()->first;
+    const std::uint32_t _note = _clips.begin()->second.notes.begin()->first;
+    const std::uint32_t _audio = _base.audio_sequencers.begin()->first;
+    const std::uint32_t _audio_clip = _base.audio_sequencers.begin()->second.clips.begin()->first;
+    const std::uint32_t _track = _base.mixer_tracks.begin()->first;
+    project::midi_note _added;
+    _added.start_tick = 480;
+    _added.length_ticks = 120;
+    _added.pitch = 64;
+    _added.velocity = 0.75f;
+    _added.mpe = {};
+
+    {
+        edit_session _session(_session_container);
+        _session.set_midi_note_pitch(_sequencer, _clip, _note, 12);
+        _session.set_midi_note_velocity(_sequencer, _clip, _note, 0.5f);
+        _session.set_audio_clip_start(_audio, _audio_clip, 96);
+        _session.set_mixer_track_db(_track, -12);
+        _session.shift_midi_notes(_sequencer, _clip, 0, 5000, 240);
+        _session.add_midi_note(_sequencer, _clip, 100000, _added);
+        FMTDXC_CHECK(_session.get_edit_count() == 6);
+        _session.commit("session");
+        FMTDXC_CHECK(_session.get_edit_count() == 0);
+    }
+
+    project _next = _base;
+    auto& _notes = _next.midi_sequencers.at(_sequencer).clips.at(_clip).notes;
+    _notes.at(_note).pitch = 12;
+    _notes.at(_note).velocity = 0.5f;
+    _next.audio_sequencers.at(_audio).clips.at(_audio_clip).start_tick = 96;
+    _next.mixer_tracks.at(_track).db = -12;
+    for (auto& [_id, _value] : _notes)
+        if (_value.start_tick < 5000)
+            _value.start_tick += 240;
+    _notes[100000] = _added;
+    _plain_container.commit("plain", _next);
+
+    FMTDXC_CHECK(_session_container.get_commit_count() == 1);
+    FMTDXC_CHECK(same(_session_container.get_project(), _next));
+    _session_container.undo();
+    _plain_container.undo();
+    FMTDXC_CHECK(same(_session_container.get_project(), _plain_container.get_project()));
+    _session_container.redo();
+    FMTDXC_CHECK(same(_session_container.get_project(), _next));
+}
+
+// destroying a session discards its edits, which must not throw
+static_assert(std::is_nothrow_destructible_v<edit_session>);
+
+static void discard_restores()
+{
+    const project _base = make_project(201);
+    project_container _container(_base);
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const std::uint32_t _clip = _base.midi_sequencers.begin()->second.clips.begin()->first;
+    {
+        edit_session _session(_container);
+        _session.transpose_midi_notes(_sequencer, _clip, 0, 10000, 2);
+        _session.add_midi_note(_sequencer, _clip, 100000, {});
+        _session.set_midi_clip_length(_sequencer, _clip, 42);
+    }
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+    FMTDXC_CHECK(_container.get_commit_count() == 0);
+
+    // an explicit discard empties the session, so that destroying it reverts nothing twice
+    {
+        edit_session _session(_container);
+        _session.shift_midi_notes(_sequencer, _clip, 0, 10000, 3);
+        _session.discard();
+        FMTDXC_CHECK(_session.get_edit_count() == 0);
+        FMTDXC_CHECK(same(_container.get_project(), _base));
+    }
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+}
+
+static void invalid_edits_throw()
+{
+    const project _base = make_project(202);
+    project_container _container(_base);
+    const auto& _sequencer = *_base.midi_sequencers.begin();
+    const auto& _clip = *_sequencer.second.clips.begin();
+    edit_session _session(_container);
+    bool _threw = false;
+    try {
+        _session.add_midi_note(_sequencer.first, _clip.first, _clip.second.notes.begin()->first, {});
+    } catch (const std::logic_error&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw && _session.get_edit_count() == 0);
+    _threw = false;
+    try {
+        _session.shift_midi_notes(_sequencer.first, _clip.first, 0, 10000, -1000000);
+    } catch (const std::out_of_range&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw && _session.get_edit_count() == 0);
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+}
+
+// commits of copies that were edited without touching their generations still diff the edited entities
+static void plain_commit_after_session()
+{
+    const project _base = make_project(203);
+    project_container _container(_base);
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const std::uint32_t _clip = _base.midi_sequencers.begin()->second.clips.begin()->first;
+    const std::uint32_t _note = _base.midi_sequencers.begin()->second.clips.begin()->second.notes.begin()->first;
+    const std::uint32_t _track = _base.mixer_tracks.begin()->first;
+    {
+        edit_session _session(_container);
+        _session.set_midi_note_pitch(_sequencer, _clip, _note, 10);
+        _session.transpose_midi_notes(_sequencer, _clip, 0, 10000, 1);
+        _session.set_mixer_track_db(_track, -20);
+        _session.add_midi_note(_sequencer, _clip, 100000, {});
+        _session.commit("session");
+    }
+    const project _after_session = _container.get_project();
+
+    project _next = _container.get_project();
+    auto& _notes = _next.midi_sequencers.at(_sequencer).clips.at(_clip).notes;
+    _notes.at(_note).pitch = 90;
+    _notes.at(100000).velocity = 0.5f;
+    _next.mixer_tracks.at(_track).db = -30;
+    _container.commit("plain", _next);
+    FMTDXC_CHECK(_container.get_commit_count() == 2);
+    FMTDXC_CHECK(same(_container.get_project(), _next));
+    _container.undo();
+    FMTDXC_CHECK(same(_container.get_project(), _after_session));
+}
+
+static void added_note_keeps_mpe()
+{
+    const project _base = make_project(204);
+    project_container _container(_base);
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const std::uint32_t _clip = _base.midi_sequencers.begin()->second.clips.begin()->first;
+    project::midi_note _added;
+    _added.start_tick = 100;
+    _added.length_ticks = 10;
+    _added.pitch = 60;
+    _added.velocity = 1.0f;
+    _added.mpe.channel = 3;
+    _added.mpe.pressure = 0.25f;
+    _added.mpe.slide = 0.5f;
+    _added.mpe.timbre = 0.75f;
+    {
+        edit_session _session(_container);
+        _session.shift_midi_notes(_sequencer, _clip, 0, 1000, 5);
+        _session.add_midi_note(_sequencer, _clip, 100000, _added);
+        _session.commit("add");
+    }
+    FMTDXC_CHECK(same(_container.get_project().midi_sequencers.at(_sequencer).clips.at(_clip).notes.at(100000), _added));
+    const project _after = _container.get_project();
+    _container.undo();
+    _container.redo();
+    FMTDXC_CHECK(same(_container.get_project(), _after));
+
+    // the committed patch restores the note on a project that does not hold it
+    project _replayed = _base;
+    apply(_replayed, _container.get_commit(0).forward);
+    FMTDXC_CHECK(same(_replayed, _after));
+}
+
+static void unchanged_commit_is_skipped()
+{
+    const project _base = make_project(205);
+    project_container _container(_base);
+    const project _next = edit_project(_base, 206, 4);
+    _container.commit("edit", _next);
+    _container.undo();
+
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const auto& _clip = *_base.midi_sequencers.begin()->second.clips.begin();
+    const auto& _note = *_clip.second.notes.begin();
+    const auto& _track = *_base.mixer_tracks.begin();
+    {
+        edit_session _session(_container);
+        _session.set_midi_note_pitch(_sequencer, _clip.first, _note.first, _note.second.pitch);
+        _session.set_midi_note_start(_sequencer, _clip.first, _note.first, _note.second.start_tick);
+        _session.set_mixer_track_db(_track.first, _track.second.db);
+        _session.shift_midi_notes(_sequencer, _clip.first, 0, 10000, 0);
+        _session.commit("nothing");
+        FMTDXC_CHECK(_session.get_edit_count() == 0);
+    }
+    FMTDXC_CHECK(_container.get_commit_count() == 1);
+    FMTDXC_CHECK(_container.can_redo());
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+    _container.redo();
+    FMTDXC_CHECK(same(_container.get_project(), _next));
+}
+
+// fields set back to the value they had before the session are left out of the patches
+static void reverted_fields_are_not_recorded()
+{
+    const project _base = make_project(207);
+    project_container _container(_base);
+    const project _next = edit_project(_base, 208, 4);
+    _container.commit("edit", _next);
+    _container.undo();
+
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const auto& _clip = *_base.midi_sequencers.begin()->second.clips.begin();
+    const auto& _note = *_clip.second.notes.begin();
+    const auto& _track = *_base.mixer_tracks.begin();
+    {
+        edit_session _session(_container);
+        _session.set_midi_note_pitch(_sequencer, _clip.first, _note.first, static_cast<std::uint16_t>(_note.second.pitch + 1));
+        _session.set_midi_note_pitch(_sequencer, _clip.first, _note.first, _note.second.pitch);
+        _session.set_mixer_track_db(_track.first, _track.second.db - 6);
+        _session.set_mixer_track_db(_track.first, _track.second.db);
+        _session.commit("reverted");
+    }
+    FMTDXC_CHECK(_container.get_commit_count() == 1);
+    FMTDXC_CHECK(_container.can_redo());
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+
+    // a field reverted after a shift is compared with its shifted value
+    project _expected = _base;
+    auto& _notes = _expected.midi_sequencers.at(_sequencer).clips.at(_clip.first).notes;
+    for (auto& [_id, _value] : _notes)
+        _value.start_tick += 240;
+    _notes.at(_note.first).velocity = 0.25f;
+    {
+        edit_session _session(_container);
+        _session.set_midi_note_start(_sequencer, _clip.first, _note.first, _note.second.start_tick + 10);
+        _session.set_midi_note_velocity(_sequencer, _clip.first, _note.first, 0.25f);
+        _session.shift_midi_notes(_sequencer, _clip.first, 0, std::numeric_limits<std::uint64_t>::max(), 240);
+        _session.set_midi_note_start(_sequencer, _clip.first, _note.first, _note.second.start_tick + 240);
+        _session.commit("velocity");
+    }
+    FMTDXC_CHECK(_container.get_commit_count() == 1);
+    FMTDXC_CHECK(same(_container.get_project(), _expected));
+    const auto& _forward = _container.get_commit(0).forward.midi_sequencers.at(_sequencer).clips.at(_clip.first).notes.at(_note.first);
+    const auto& _backward = _container.get_commit(0).backward.midi_sequencers.at(_sequencer).clips.at(_clip.first).notes.at(_note.first);
+    FMTDXC_CHECK(!_forward.start_tick && !_backward.start_tick && _forward.velocity && _backward.velocity);
+    _container.undo();
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+    _container.redo();
+    FMTDXC_CHECK(same(_container.get_project(), _expected));
+}
+
+// deltas that can not be negated or folded are rejected before anything is edited
+static void operation_deltas_out_of_range()
+{
+    project _base;
+    _base.midi_sequencers[0].clips[0].notes[0].start_tick = std::numeric_limits<std::uint64_t>::max() - 1;
+    _base.midi_sequencers[0].clips[0].notes[1].start_tick = std::numeric_limits<std::uint64_t>::max() - 1;
+    project_container _container(_base);
+    edit_session _session(_container);
+    bool _threw = false;
+    try {
+        _session.shift_midi_notes(0, 0, 0, std::numeric_limits<std::uint64_t>::max(), std::numeric_limits<std::int64_t>::min());
+    } catch (const std::out_of_range&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw && _session.get_edit_count() == 0);
+
+    // two shifts that each fit fold into a delta past the range of std::int64_t
+    _session.shift_midi_notes(0, 0, 0, std::numeric_limits<std::uint64_t>::max(), -std::numeric_limits<std::int64_t>::max());
+    const project _shifted = _container.get_project();
+    _threw = false;
+    try {
+        _session.shift_midi_notes(0, 0, 0, std::numeric_limits<std::uint64_t>::max(), -2);
+    } catch (const std::out_of_range&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw && _session.get_edit_count() == 1);
+    FMTDXC_CHECK(same(_container.get_project(), _shifted));
+    _session.commit("shift");
+    _container.undo();
+    FMTDXC_CHECK(same(_container.get_project(), _base));
+    _container.redo();
+    FMTDXC_CHECK(same(_container.get_project(), _shifted));
+
+    // patches holding such deltas are rejected when composed
+    sparse_project _first, _second;
+    _first.midi_sequencers[0].clips[0].operations.push_back({ 0, 1, std::numeric_limits<std::int64_t>::max(), 0 });
+    _second.midi_sequencers[0].clips[0].operations.push_back({ 0, 1, 1, 0 });
+    _threw = false;
+    try {
+        compose(_first, _second);
+    } catch (const std::out_of_range&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw);
+}
+
+// notes added inside a run of recorded operations are left out of them, undoing leaves them as they were added
+static void added_note_inside_run()
+{
+    project _base;
+    auto& _base_notes = _base.midi_sequencers[0].clips[0].notes;
+    for (std::uint32_t _id = 0; _id <= 4; _id += 2)
+        _base_notes[_id].start_tick = 1000 + _id;
+    project_container _session_container(_base);
+    project_container _plain_container(_base);
+    project::midi_note _added;
+    _added.start_tick = 100;
+
+    {
+        edit_session _session(_session_container);
+        _session.shift_midi_notes(0, 0, 0, 100000, 500);
+        _session.add_midi_note(0, 0, 3, _added);
+        _session.shift_midi_notes(0, 0, 0, 100000, 7);
+        _session.commit("session");
+    }
+
+    project _next = _base;
+    auto& _notes = _next.midi_sequencers.at(0).clips.at(0).notes;
+    for (auto& [_id, _value] : _notes)
+        _value.start_tick += 507;
+    _notes[3] = _added;
+    _notes.at(3).start_tick = 107;
+    _plain_container.commit("plain", _next);
+
+    FMTDXC_CHECK(same(_session_container.get_project(), _next));
+    _session_container.undo();
+    _plain_container.undo();
+    FMTDXC_CHECK(_session_container.get_project().midi_sequencers.at(0).clips.at(0).notes.at(3).start_tick == 107);
+    FMTDXC_CHECK(same(_session_container.get_project(), _plain_container.get_project()));
+    _session_container.redo();
+    FMTDXC_CHECK(same(_session_container.get_project(), _next));
+
+    // discarding removes the added note and restores the others
+    {
+        edit_session _session(_session_container);
+        _session.shift_midi_notes(0, 0, 0, 100000, -50);
+        _session.add_midi_note(0, 0, 5, _added);
+        _session.shift_midi_notes(0, 0, 0, 100000, 3);
+    }
+    FMTDXC_CHECK(same(_session_container.get_project(), _next));
+}
+
+int main()
+{
+    commit_matches_plain_commit();
+    discard_restores();
+    invalid_edits_throw();
+    plain_commit_after_session();
+    added_note_keeps_mpe();
+    unchanged_commit_is_skipped();
+    reverted_fields_are_not_recorded();
+    operation_deltas_out_of_range();
+    added_note_inside_run();
+    return 0;
+}
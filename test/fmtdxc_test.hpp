@@ -0,0 +1,298 @@
+#pragma once
+
+#include <fmtdxc/fmtdxc.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+// checks stay enabled in release builds, unlike assert
+#define FMTDXC_CHECK(condition) ((condition) ? (void)0 : fmtdxc_test::fail(#condition, __FILE__, __LINE__))
+
+namespace fmtdxc_test {
+
+using namespace fmtdxc;
+
+[[noreturn]] inline void fail(const char* condition, const char* file, const int line)
+{
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, condition);
+    std::exit(1);
+}
+
+// projects compare field by field, generation stamps are not part of the content
+inline bool same(const project::midi_mpe& a, const project::midi_mpe& b)
+{
+    return a.channel == b.channel && a.pressure == b.pressure && a.slide == b.slide && a.timbre == b.timbre;
+}
+
+inline bool same(const project::midi_note& a, const project::midi_note& b)
+{
+    return a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && a.pitch == b.pitch && a.velocity == b.velocity && same(a.mpe, b.mpe);
+}
+
+inline bool same(const project::audio_clip& a, const project::audio_clip& b)
+{
+    return a.name == b.name && a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && a.file == b.file && a.file_start_frame == b.file_start_frame && a.db == b.db && a.is_loop == b.is_loop;
+}
+
+inline bool same(const project::audio_effect& a, const project::audio_effect& b)
+{
+    return a.name == b.name;
+}
+
+inline bool same(const project::mixer_routing& a, const project::mixer_routing& b)
+{
+    return a.db == b.db && a.output == b.output;
+}
+
+inline bool same(const project::collected_audio_file& a, const project::collected_audio_file& b)
+{
+    return a.data == b.data && a.collected_relative_path == b.collected_relative_path;
+}
+
+// patches compare field by field too, a field must be set on both sides or on neither
+inline bool same(const sparse_project::midi_mpe& a, const sparse_project::midi_mpe& b)
+{
+    return a.channel == b.channel && a.pressure == b.pressure && a.slide == b.slide && a.timbre == b.timbre;
+}
+
+inline bool same(const sparse_project::midi_instrument& a, const sparse_project::midi_instrument& b)
+{
+    return a.name == b.name;
+}
+
+template <typename T>
+bool same_value(const std::optional<T>& a, const std::optional<T>& b)
+{
+    return a.has_value() == b.has_value() && (!a || same(*a, *b));
+}
+
+inline bool same(const sparse_project::midi_note& a, const sparse_project::midi_note& b)
+{
+    return a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && a.pitch == b.pitch && a.velocity == b.velocity && same_value(a.mpe, b.mpe);
+}
+
+inline bool same(const std::vector<midi_note_operation>& a, const std::vector<midi_note_operation>& b)
+{
+    if (a.size() != b.size())
+        return false;
+    for (std::size_t _index = 0; _index < a.size(); ++_index)
+        if (a[_index].first_note != b[_index].first_note || a[_index].last_note != b[_index].last_note
+            || a[_index].start_delta != b[_index].start_delta || a[_index].pitch_delta != b[_index].pitch_delta)
+            return false;
+    return true;
+}
+
+inline bool same(const sparse_project::audio_clip& a, const sparse_project::audio_clip& b)
+{
+    return a.name == b.name && a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && a.file == b.file && a.file_start_frame == b.file_start_frame && a.db == b.db && a.is_loop == b.is_loop;
+}
+
+inline bool same(const sparse_project::audio_effect& a, const sparse_project::audio_effect& b)
+{
+    return a.name == b.name;
+}
+
+inline bool same(const sparse_project::mixer_routing& a, const sparse_project::mixer_routing& b)
+{
+    return a.db == b.db && a.output == b.output;
+}
+
+inline bool same(const sparse_project::collected_audio_file& a, const sparse_project::collected_audio_file& b)
+{
+    return a.data == b.data && a.collected_relative_path == b.collected_relative_path;
+}
+
+bool same(const project::midi_clip& a, const project::midi_clip& b);
+bool same(const project::audio_sequencer& a, const project::audio_sequencer& b);
+bool same(const project::midi_sequencer& a, const project::midi_sequencer& b);
+bool same(const project::mixer_track& a, const project::mixer_track& b);
+bool same(const sparse_project::midi_clip& a, const sparse_project::midi_clip& b);
+bool same(const sparse_project::audio_sequencer& a, const sparse_project::audio_sequencer& b);
+bool same(const sparse_project::midi_sequencer& a, const sparse_project::midi_sequencer& b);
+bool same(const sparse_project::mixer_track& a, const sparse_project::mixer_track& b);
+
+template <typename map_t>
+bool same_map(const map_t& a, const map_t& b)
+{
+    if (a.size() != b.size())
+        return false;
+    auto _a = a.begin();
+    auto _b = b.begin();
+    for (; _a != a.end(); ++_a, ++_b)
+        if (_a->first != _b->first || !same(_a->second, _b->second))
+            return false;
+    return true;
+}
+
+inline bool same(const project::midi_clip& a, const project::midi_clip& b)
+{
+    return a.name == b.name && a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && same_map(a.notes, b.notes);
+}
+
+inline bool same(const project::audio_sequencer& a, const project::audio_sequencer& b)
+{
+    return a.name == b.name && a.output == b.output && same_map(a.clips, b.clips);
+}
+
+inline bool same(const project::midi_sequencer& a, const project::midi_sequencer& b)
+{
+    return a.name == b.name && a.output == b.output && a.instrument.name == b.instrument.name && same_map(a.clips, b.clips);
+}
+
+inline bool same(const project::mixer_track& a, const project::mixer_track& b)
+{
+    return a.name == b.name && a.db == b.db && a.pan == b.pan && same_map(a.effects, b.effects) && same_map(a.routings, b.routings);
+}
+
+inline bool same(const project& a, const project& b)
+{
+    return a.name == b.name && a.ppq == b.ppq && a.master_track_id == b.master_track_id
+        && same_map(a.audio_sequencers, b.audio_sequencers) && same_map(a.midi_sequencers, b.midi_sequencers)
+        && same_map(a.mixer_tracks, b.mixer_tracks) && same_map(a.collected_audio_files, b.collected_audio_files);
+}
+
+inline bool same(const sparse_project::midi_clip& a, const sparse_project::midi_clip& b)
+{
+    return a.name == b.name && a.start_tick == b.start_tick && a.length_ticks == b.length_ticks && same_map(a.notes, b.notes) && same(a.operations, b.operations);
+}
+
+inline bool same(const sparse_project::audio_sequencer& a, const sparse_project::audio_sequencer& b)
+{
+    return a.name == b.name && a.output == b.output && same_map(a.clips, b.clips);
+}
+
+inline bool same(const sparse_project::midi_sequencer& a, const sparse_project::midi_sequencer& b)
+{
+    return a.name == b.name && a.output == b.output && same_value(a.instrument, b.instrument) && same_map(a.clips, b.clips);
+}
+
+inline bool same(const sparse_project::mixer_track& a, const sparse_project::mixer_track& b)
+{
+    return a.name == b.name && a.db == b.db && a.pan == b.pan && same_map(a.effects, b.effects) && same_map(a.routings, b.routings);
+}
+
+inline bool same(const sparse_project& a, const sparse_project& b)
+{
+    return a.name == b.name && a.ppq == b.ppq && a.master_track_id == b.master_track_id
+        && same_map(a.audio_sequencers, b.audio_sequencers) && same_map(a.midi_sequencers, b.midi_sequencers)
+        && same_map(a.mixer_tracks, b.mixer_tracks) && same_map(a.collected_audio_files, b.collected_audio_files);
+}
+
+// version::alpha only archives the name, ppq and mixer tracks of projects and patches
+inline project alpha_view(const project& value)
+{
+    project _view = value;
+    _view.audio_sequencers = {};
+    _view.midi_sequencers = {};
+    _view.collected_audio_files = {};
+    return _view;
+}
+
+inline project make_project(const std::uint32_t seed, const std::uint32_t sequencers = 4, const std::uint32_t clips = 3, const std::uint32_t notes = 80)
+{
+    std::mt19937 _random(seed);
+    project _project;
+    _project.name = "project";
+    _project.ppq = 960;
+    _project.master_track_id = 0;
+    for (std::uint32_t _sequencer = 0; _sequencer < sequencers; ++_sequencer) {
+        auto& _track = _project.mixer_tracks[_sequencer];
+        _track.name = "track " + std::to_string(_sequencer);
+        _track.db = -double(_random() % 12);
+        _track.pan = 0;
+        _track.effects[0].name = "eq";
+        _track.routings[1].db = -6;
+        _track.routings[1].output = 0;
+
+        auto& _audio = _project.audio_sequencers[_sequencer * 2];
+        _audio.name = "audio " + std::to_string(_sequencer);
+        _audio.output = _sequencer;
+        auto& _midi = _project.midi_sequencers[_sequencer * 3 + 1];
+        _midi.name = "midi " + std::to_string(_sequencer);
+        _midi.output = _sequencer;
+        _midi.instrument.name = "piano";
+        for (std::uint32_t _clip = 0; _clip < clips; ++_clip) {
+            auto& _audio_clip = _audio.clips[_clip];
+            _audio_clip.name = "take";
+            _audio_clip.start_tick = _random() % 100000;
+            _audio_clip.length_ticks = 1 + _random() % 10000;
+            _audio_clip.file = "audio/take" + std::to_string(_random() % 4) + ".wav";
+            _audio_clip.file_start_frame = _random() % 48000;
+            _audio_clip.db = 0;
+            _audio_clip.is_loop = _clip % 2 == 0;
+
+            auto& _midi_clip = _midi.clips[_clip * 5];
+            _midi_clip.name = "pattern";
+            _midi_clip.start_tick = _random() % 100000;
+            _midi_clip.length_ticks = 1 + _random() % 10000;
+            for (std::uint32_t _note = 0; _note < notes; ++_note) {
+                auto& _value = _midi_clip.notes[_note * 2];
+                _value.start_tick = _random() % 10000;
+                _value.length_ticks = 1 + _random() % 480;
+                _value.pitch = static_cast<std::uint16_t>(_random() % 128);
+                _value.velocity = static_cast<float>(_random() % 128) / 127.0f;
+                _value.mpe = {};
+                if (_note % 9 == 0) {
+                    _value.mpe.channel = 1 + _random() % 15;
+                    _value.mpe.pressure = 0.5f;
+                }
+            }
+        }
+    }
+    _project.collected_audio_files[0].collected_relative_path = "audio/take0.wav";
+    return _project;
+}
+
+// changes values of existing entities only, since patches do not model deletes and undoing adds keeps them
+inline project edit_project(const project& value, const std::uint32_t seed, const int edits = 10)
+{
+    std::mt19937 _random(seed);
+    project _project = value;
+    for (int _edit = 0; _edit < edits; ++_edit) {
+        switch (_random() % 6) {
+        case 0: {
+            auto _sequencer = std::next(_project.midi_sequencers.begin(), _random() % _project.midi_sequencers.size());
+            auto _clip = std::next(_sequencer->second.clips.begin(), _random() % _sequencer->second.clips.size());
+            auto _note = std::next(_clip->second.notes.begin(), _random() % _clip->second.notes.size());
+            _note->second.pitch = static_cast<std::uint16_t>(_random() % 128);
+            _note->second.velocity = static_cast<float>(_random() % 128) / 127.0f;
+            break;
+        }
+        case 1: {
+            auto _sequencer = std::next(_project.midi_sequencers.begin(), _random() % _project.midi_sequencers.size());
+            auto _clip = std::next(_sequencer->second.clips.begin(), _random() % _sequencer->second.clips.size());
+            auto _note = std::next(_clip->second.notes.begin(), _random() % _clip->second.notes.size());
+            _note->second.mpe.timbre = static_cast<float>(_random() % 100) / 100.0f;
+            break;
+        }
+        case 2: {
+            auto _track = std::next(_project.mixer_tracks.begin(), _random() % _project.mixer_tracks.size());
+            _track->second.db = -double(_random() % 60);
+            break;
+        }
+        case 3: {
+            auto _sequencer = std::next(_project.audio_sequencers.begin(), _random() % _project.audio_sequencers.size());
+            auto _clip = std::next(_sequencer->second.clips.begin(), _random() % _sequencer->second.clips.size());
+            _clip->second.start_tick += _random() % 960;
+            _clip->second.file = "audio/bounce.wav";
+            break;
+        }
+        case 4: {
+            auto _sequencer = std::next(_project.midi_sequencers.begin(), _random() % _project.midi_sequencers.size());
+            _sequencer->second.instrument.name = "synth " + std::to_string(_random() % 3);
+            break;
+        }
+        default:
+            _project.name = "project " + std::to_string(_random() % 5);
+            break;
+        }
+    }
+    return _project;
+}
+
+}
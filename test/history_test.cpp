@@ -0,0 +1,228 @@
+#include "fmtdxc_test.hpp"
+
+#include <vector>
+
+using namespace fmtdxc_test;
+
+static std::vector<project> make_states(const std::uint32_t seed, const std::size_t count)
+{
+    std::vector<project> _states { make_project(seed) };
+    for (std::size_t _index = 1; _index < count; ++_index)
+        _states.push_back(edit_project(_states.back(), seed + static_cast<std::uint32_t>(_index), 8));
+    return _states;
+}
+
+static void undo_redo_checkout(const backward_mode mode, const std::size_t checkpoint_interval)
+{
+    const std::vector<project> _states = make_states(10, 12);
+    project_container _container(_states.front());
+    _container.set_backward_mode(mode);
+    _container.set_checkpoint_interval(checkpoint_interval);
+    for (std::size_t _index = 1; _index < _states.size(); ++_index)
+        _container.commit("edit " + std::to_string(_index), _states[_index]);
+    FMTDXC_CHECK(_container.get_commit_count() == _states.size() - 1);
+    FMTDXC_CHECK(_container.get_applied_count() == _states.size() - 1);
+    FMTDXC_CHECK(same(_container.get_project(), _states.back()));
+
+    for (std::size_t _index = _states.size() - 1; _index > 0; --_index) {
+        FMTDXC_CHECK(_container.can_undo());
+        _container.undo();
+        FMTDXC_CHECK(same(_container.get_project(), _states[_index - 1]));
+    }
+    FMTDXC_CHECK(!_container.can_undo());
+    for (std::size_t _index = 1; _index < _states.size(); ++_index) {
+        FMTDXC_CHECK(_container.can_redo());
+        _container.redo();
+        FMTDXC_CHECK(same(_container.get_project(), _states[_index]));
+    }
+    FMTDXC_CHECK(!_container.can_redo());
+
+    const std::size_t _order[] = { 3, 0, 11, 7, 8, 1, 5, 5, 10, 2 };
+    for (const std::size_t _index : _order) {
+        _container.checkout(_index);
+        FMTDXC_CHECK(_container.get_applied_count() == _index);
+        FMTDXC_CHECK(same(_container.get_project(), _states[_index]));
+    }
+}
+
+static void commit_after_undo_truncates()
+{
+    const std::vector<project> _states = make_states(20, 5);
+    project_container _container(_states.front());
+    for (std::size_t _index = 1; _index < _states.size(); ++_index)
+        _container.commit("edit", _states[_index]);
+    _container.undo();
+    _container.undo();
+    const project _branch = edit_project(_states[2], 99, 5);
+    _container.commit("branch", _branch);
+    FMTDXC_CHECK(_container.get_commit_count() == 3);
+    FMTDXC_CHECK(_container.get_applied_count() == 3);
+    FMTDXC_CHECK(!_container.can_redo());
+    FMTDXC_CHECK(same(_container.get_project(), _branch));
+    _container.undo();
+    FMTDXC_CHECK(same(_container.get_project(), _states[2]));
+}
+
+static void unchanged_commit_is_skipped()
+{
+    const project _base = make_project(30);
+    project_container _container(_base);
+    _container.commit("nothing", _base);
+    FMTDXC_CHECK(_container.get_commit_count() == 0);
+    FMTDXC_CHECK(_container.get_applied_count() == 0);
+    FMTDXC_CHECK(!_container.can_undo());
+}
+
+// checkpoints are full copies taken every interval applied commits, truncating the history drops the ones past it
+static void checkpoints_follow_interval()
+{
+    const std::vector<project> _states = make_states(35, 11);
+    project_container _container(_states.front());
+    FMTDXC_CHECK(_container.get_checkpoint_stats().count == 0);
+    _container.set_checkpoint_interval(3);
+    for (std::size_t _index = 1; _index < _states.size(); ++_index)
+        _container.commit("edit", _states[_index]);
+    const checkpoint_stats _stats = _container.get_checkpoint_stats();
+    FMTDXC_CHECK(_stats.count == 4);
+    FMTDXC_CHECK(_stats.bytes > 0);
+
+    _container.checkout(7);
+    const project _branch = edit_project(_container.get_project(), 36, 4);
+    _container.commit("branch", _branch);
+    FMTDXC_CHECK(_container.get_checkpoint_stats().count == 3);
+    _container.checkout(1);
+    FMTDXC_CHECK(same(_container.get_project(), _states[1]));
+    _container.checkout(8);
+    FMTDXC_CHECK(same(_container.get_project(), _branch));
+
+    _container.set_checkpoint_interval(0);
+    FMTDXC_CHECK(_container.get_checkpoint_stats().count == 0 && _container.get_checkpoint_stats().bytes == 0);
+    _container.checkout(6);
+    FMTDXC_CHECK(same(_container.get_project(), _states[6]));
+}
+
+static void squash_keeps_states()
+{
+    const std::vector<project> _states = make_states(40, 8);
+    project_container _container(_states.front());
+    for (std::size_t _index = 1; _index < _states.size(); ++_index)
+        _container.commit("edit", _states[_index]);
+    _container.squash(1, 5, "squashed");
+    FMTDXC_CHECK(_container.get_commit_count() == 3);
+    FMTDXC_CHECK(_container.get_commit_message(1) == "squashed");
+    FMTDXC_CHECK(same(_container.get_project(), _states.back()));
+    _container.checkout(2);
+    FMTDXC_CHECK(same(_container.get_project(), _states[6]));
+    _container.checkout(1);
+    FMTDXC_CHECK(same(_container.get_project(), _states[1]));
+    _container.checkout(0);
+    FMTDXC_CHECK(same(_container.get_project(), _states[0]));
+}
+
+// two commits per hour for six hours, the hours that ended before the last one are squashed
+static void compaction_folds_old_periods()
+{
+    const std::vector<project> _states = make_states(45, 13);
+    const std::chrono::system_clock::time_point _now(std::chrono::hours(500000));
+    std::vector<project_commit> _commits(_states.size() - 1);
+    for (std::size_t _index = 1; _index < _states.size(); ++_index) {
+        project_commit& _commit = _commits[_index - 1];
+        _commit.message = "edit " + std::to_string(_index);
+        _commit.timestamp = _now - std::chrono::hours(6) + std::chrono::minutes(30) * (_index - 1);
+        diff(_states[_index - 1], _states[_index], _commit.forward, _commit.backward);
+    }
+    project_container _container(_states.front(), _commits);
+    _container.checkout(_commits.size());
+    FMTDXC_CHECK(_container.compact_history(_now) == 0);
+
+    compaction_policy _policy;
+    _policy.keep_all_for = std::chrono::hours(1);
+    _policy.squash_period = std::chrono::hours(1);
+    _container.set_compaction_policy(_policy);
+    // committing does not compact, only compact_history does
+    _container.undo();
+    _container.commit(_commits.back());
+    FMTDXC_CHECK(_container.get_commit_count() == 12);
+    FMTDXC_CHECK(_container.compact_history(_now) == 5);
+    FMTDXC_CHECK(_container.compact_history(_now) == 0);
+    FMTDXC_CHECK(_container.get_commit_count() == 7);
+    FMTDXC_CHECK(_container.get_commit_message(0) == "edit 2");
+    FMTDXC_CHECK(_container.get_commit_message(6) == "edit 12");
+    FMTDXC_CHECK(same(_container.get_project(), _states.back()));
+
+    const std::size_t _kept[] = { 0, 2, 4, 6, 8, 10, 11, 12 };
+    for (std::size_t _index = 7; _index > 0; --_index) {
+        _container.undo();
+        FMTDXC_CHECK(same(_container.get_project(), _states[_kept[_index - 1]]));
+    }
+    FMTDXC_CHECK(!_container.can_undo());
+    for (std::size_t _index = 1; _index < 8; ++_index) {
+        _container.redo();
+        FMTDXC_CHECK(same(_container.get_project(), _states[_kept[_index]]));
+    }
+}
+
+static void gesture_folds_commits()
+{
+    const std::vector<project> _states = make_states(50, 6);
+    project_container _container(_states.front());
+    _container.begin_gesture("drag");
+    for (std::size_t _index = 1; _index < _states.size(); ++_index) {
+        // steps given as temporaries are moved into the gesture
+        if (_index % 2)
+            _container.commit("step", project(_states[_index]));
+        else
+            _container.commit("step", _states[_index]);
+        FMTDXC_CHECK(same(_container.get_project(), _states[_index]));
+    }
+    _container.end_gesture();
+    FMTDXC_CHECK(_container.get_commit_count() == 1);
+    FMTDXC_CHECK(_container.get_commit_message(0) == "drag");
+    FMTDXC_CHECK(same(_container.get_project(), _states.back()));
+    _container.undo();
+    FMTDXC_CHECK(same(_container.get_project(), _states.front()));
+
+    // cancelled gestures commit nothing and keep the redo tail
+    _container.begin_gesture("cancelled");
+    _container.commit("step", _states[2]);
+    _container.cancel_gesture();
+    FMTDXC_CHECK(_container.can_redo());
+    FMTDXC_CHECK(same(_container.get_project(), _states.front()));
+}
+
+static void commits_view()
+{
+    const std::vector<project> _states = make_states(60, 5);
+    project_container _container(_states.front());
+    FMTDXC_CHECK(_container.get_commits().empty());
+    for (std::size_t _index = 1; _index < _states.size(); ++_index)
+        _container.commit("edit " + std::to_string(_index), _states[_index]);
+    const commit_range _commits = _container.get_commits();
+    FMTDXC_CHECK(_commits.size() == 4);
+    std::size_t _index = 0;
+    project _replayed = _states.front();
+    for (const project_commit& _commit : _commits) {
+        FMTDXC_CHECK(&_commit == &_commits[_index]);
+        FMTDXC_CHECK(_commit.message == _container.get_commit_message(_index));
+        apply(_replayed, _commit.forward);
+        FMTDXC_CHECK(same(_replayed, _states[++_index]));
+    }
+    FMTDXC_CHECK(_index == _commits.size());
+    FMTDXC_CHECK(std::distance(_commits.begin(), _commits.end()) == 4);
+}
+
+int main()
+{
+    undo_redo_checkout(backward_mode::full, 0);
+    undo_redo_checkout(backward_mode::overwritten, 0);
+    undo_redo_checkout(backward_mode::full, 3);
+    undo_redo_checkout(backward_mode::overwritten, 4);
+    commit_after_undo_truncates();
+    unchanged_commit_is_skipped();
+    checkpoints_follow_interval();
+    squash_keeps_states();
+    compaction_folds_old_periods();
+    gesture_folds_commits();
+    commits_view();
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "fmtdxc_test.hpp"
+
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace fmtdxc_test;
+
+#if defined(FMTDXC_PMR)
+
+// counts the bytes that are currently allocated from it
+struct counting_resource : std::pmr::memory_resource {
+    std::size_t allocated = 0;
+
+private:
+    void* do_allocate(const std::size_t bytes, const std::size_t alignment) override
+    {
+        allocated += bytes;
+        return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* pointer, const std::size_t bytes, const std::size_t alignment) override
+    {
+        allocated -= bytes;
+        std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+static void scopes_select_the_resource()
+{
+    const std::shared_ptr<std::pmr::memory_resource> _default = get_current_resource();
+    const auto _resource = std::make_shared<counting_resource>();
+    {
+        std::optional<project> _project;
+        {
+            const resource_scope _scope(_resource);
+            FMTDXC_CHECK(get_current_resource() == _resource);
+            _project = make_project(160, 2, 2, 10);
+        }
+        FMTDXC_CHECK(get_current_resource() == _default);
+        FMTDXC_CHECK(_resource->allocated > 0);
+        FMTDXC_CHECK(_project->midi_sequencers.get_allocator().get_resource() == _resource);
+
+        const project _copy = *_project;
+#if defined(FMTDXC_COW_ID_MAP)
+        // copies share the maps they were copied from until they are written to
+        FMTDXC_CHECK(_copy.midi_sequencers.get_allocator().get_resource() == _resource);
+#else
+        // copies allocate from the resource that is current where they are made
+        FMTDXC_CHECK(_copy.midi_sequencers.get_allocator().get_resource() == _default);
+#endif
+        FMTDXC_CHECK(same(_copy, *_project));
+    }
+    FMTDXC_CHECK(_resource->allocated == 0);
+}
+
+// each commit allocates its patches from an arena that goes away with the commit
+static void commits_allocate_from_arenas()
+{
+    const project _base = make_project(161);
+    project_container _container(_base);
+    project _next = _base;
+    for (int _index = 0; _index < 2; ++_index) {
+        _next.midi_sequencers.begin()->second.clips.begin()->second.notes.begin()->second.pitch = static_cast<std::uint16_t>(_index);
+        _container.commit("edit", _next);
+    }
+    const auto _first = _container.get_commit(0).forward.midi_sequencers.get_allocator().get_resource();
+    const std::weak_ptr<std::pmr::memory_resource> _second = _container.get_commit(1).forward.midi_sequencers.get_allocator().get_resource();
+    FMTDXC_CHECK(dynamic_cast<std::pmr::monotonic_buffer_resource*>(_first.get()) != nullptr);
+    FMTDXC_CHECK(dynamic_cast<std::pmr::monotonic_buffer_resource*>(_second.lock().get()) != nullptr);
+    FMTDXC_CHECK(_first != _second.lock() && _first != get_current_resource());
+    FMTDXC_CHECK(_container.get_project().midi_sequencers.get_allocator().get_resource() == get_current_resource());
+
+    _container.undo();
+    _container.commit("branch", edit_project(_container.get_project(), 162, 4));
+    FMTDXC_CHECK(_second.expired());
+    FMTDXC_CHECK(_container.get_commit(0).forward.midi_sequencers.get_allocator().get_resource() == _first);
+}
+
+#endif
+
+static void flat_map_keeps_ids_sorted()
+{
+    flat_id_map<std::string> _map;
+    FMTDXC_CHECK(_map.empty() && _map.find(0) == _map.end() && _map.count(0) == 0);
+
+    // inserted in any order, iterated in id order
+    FMTDXC_CHECK(_map.emplace(5, "five").second);
+    FMTDXC_CHECK(_map.emplace(1, "one").second);
+    _map[3] = "three";
+    FMTDXC_CHECK(!_map.emplace(3, "other").second && _map.at(3) == "three");
+    _map.emplace_hint(_map.end(), 9, "nine");
+    _map.emplace_hint(_map.end(), 7, "seven");
+    FMTDXC_CHECK(_map.size() == 5);
+    const std::uint32_t _sorted[] = { 1, 3, 5, 7, 9 };
+    std::size_t _index = 0;
+    for (auto& [_id, _value] : _map)
+        FMTDXC_CHECK(_id == _sorted[_index++]);
+
+    // lookups
+    FMTDXC_CHECK(_map.find(7)->second == "seven" && _map.find(4) == _map.end());
+    FMTDXC_CHECK(_map.lower_bound(4)->first == 5 && _map.upper_bound(5)->first == 7 && _map.lower_bound(10) == _map.end());
+    bool _threw = false;
+    try {
+        (void)_map.at(4);
+    } catch (const std::out_of_range&) {
+        _threw = true;
+    }
+    FMTDXC_CHECK(_threw);
+
+    // erasing keeps the others in order
+    FMTDXC_CHECK(_map.erase(3) == 1 && _map.erase(3) == 0);
+    auto _next = _map.erase(_map.find(1));
+    FMTDXC_CHECK(_next == _map.begin() && _next->first == 5);
+    _map.erase(std::prev(_map.end()));
+    const std::uint32_t _kept[] = { 5, 7 };
+    _index = 0;
+    for (auto& [_id, _value] : _map)
+        FMTDXC_CHECK(_id == _kept[_index++]);
+    FMTDXC_CHECK(_index == 2 && _map.at(5) == "five" && _map.at(7) == "seven");
+
+    // ids erased can be inserted again
+    _map[1] = "again";
+    FMTDXC_CHECK(_map.begin()->first == 1 && _map.begin()->second == "again" && _map.size() == 3);
+
+    flat_id_map<std::string> _copy = _map;
+    FMTDXC_CHECK(_copy == _map);
+    _copy.erase(7);
+    FMTDXC_CHECK(_copy != _map && _map.count(7) == 1);
+    _copy.clear();
+    FMTDXC_CHECK(_copy.empty() && _copy.begin() == _copy.end());
+}
+
+static void cow_copies_share_until_written()
+{
+    cow_id_map<std::string> _a;
+    _a[1] = "one";
+    _a[2] = "two";
+    cow_id_map<std::string> _b = _a;
+    FMTDXC_CHECK(_b.shares(_a) && _b == _a);
+
+    // reading through a const map does not copy
+    const cow_id_map<std::string>& _read = _b;
+    FMTDXC_CHECK(_read.at(1) == "one" && _read.find(3) == _read.end());
+    FMTDXC_CHECK(_b.shares(_a));
+
+    _b[3] = "three";
+    FMTDXC_CHECK(!_b.shares(_a) && _b != _a);
+    FMTDXC_CHECK(_a.size() == 2 && _b.size() == 3 && _a.count(3) == 0);
+    cow_id_map<std::string> _c = _a;
+    _c.erase(1);
+    FMTDXC_CHECK(!_c.shares(_a) && _a.at(1) == "one");
+
+    // writing to a nested map only copies the maps on the path to it
+    cow_id_map<cow_id_map<std::string>> _outer;
+    _outer[0][1] = "x";
+    _outer[5][1] = "y";
+    cow_id_map<cow_id_map<std::string>> _copy = _outer;
+    _copy[0][1] = "z";
+    const auto& _from = std::as_const(_outer);
+    const auto& _to = std::as_const(_copy);
+    FMTDXC_CHECK(!_to.shares(_from));
+    FMTDXC_CHECK(!_to.at(0).shares(_from.at(0)) && _from.at(0).at(1) == "x" && _to.at(0).at(1) == "z");
+    FMTDXC_CHECK(_to.at(5).shares(_from.at(5)));
+}
+
+#if defined(FMTDXC_COW_ID_MAP)
+
+static void project_copies_share_structure()
+{
+    const project _base = make_project(170);
+    project _copy = _base;
+    FMTDXC_CHECK(_copy.midi_sequencers.shares(_base.midi_sequencers) && _copy.mixer_tracks.shares(_base.mixer_tracks));
+
+    const std::uint32_t _edited = _base.midi_sequencers.begin()->first;
+    const std::uint32_t _other = std::prev(_base.midi_sequencers.end())->first;
+    const auto& _clip = *_base.midi_sequencers.at(_edited).clips.begin();
+    const std::uint32_t _note = _clip.second.notes.begin()->first;
+    const std::uint16_t _pitch = _clip.second.notes.at(_note).pitch;
+    _copy.midi_sequencers.at(_edited).clips.at(_clip.first).notes.at(_note).pitch = static_cast<std::uint16_t>(_pitch + 1);
+
+    const project& _view = _copy;
+    FMTDXC_CHECK(!_view.midi_sequencers.shares(_base.midi_sequencers));
+    FMTDXC_CHECK(_view.audio_sequencers.shares(_base.audio_sequencers) && _view.mixer_tracks.shares(_base.mixer_tracks));
+    FMTDXC_CHECK(!_view.midi_sequencers.at(_edited).clips.shares(_base.midi_sequencers.at(_edited).clips));
+    FMTDXC_CHECK(_view.midi_sequencers.at(_other).clips.shares(_base.midi_sequencers.at(_other).clips));
+    FMTDXC_CHECK(_base.midi_sequencers.at(_edited).clips.at(_clip.first).notes.at(_note).pitch == _pitch);
+}
+
+#endif
+
+int main()
+{
+#if defined(FMTDXC_PMR)
+    scopes_select_the_resource();
+    commits_allocate_from_arenas();
+#endif
+    flat_map_keeps_ids_sorted();
+    cow_copies_share_until_written();
+#if defined(FMTDXC_COW_ID_MAP)
+    project_copies_share_structure();
+#endif
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "fmtdxc_test.hpp"
+
+#include <sstream>
+#include <utility>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+#if defined(FMTDXC_INSTRUMENTATION)
+static const phase_stats& get_phase(const instrumentation_stats& stats, const instrumentation_phase phase)
+{
+    return stats.phases[static_cast<std::size_t>(phase)];
+}
+#else
+// the stats stay zero when the library is built without FMTDXC_INSTRUMENTATION
+static bool is_zero(const instrumentation_stats& stats)
+{
+    for (const phase_stats& _phase : stats.phases)
+        if (_phase.calls || _phase.time.count())
+            return false;
+    return !stats.nodes_visited && !stats.audio_sequencers_diffed && !stats.audio_clips_diffed && !stats.midi_sequencers_diffed
+        && !stats.midi_clips_diffed && !stats.midi_notes_diffed && !stats.mixer_tracks_diffed && !stats.audio_effects_diffed && !stats.mixer_routings_diffed
+        && !stats.collected_audio_files_diffed && !stats.patch_entities && !stats.bytes_encoded && !stats.bytes_decoded && !stats.entities_allocated;
+}
+#endif
+
+static void diff_and_apply_are_counted()
+{
+    // both sides are built apart so that they share nothing
+    const project _base = make_project(150, 2, 2, 10);
+    project _other = make_project(150, 2, 2, 10);
+    _other.midi_sequencers.begin()->second.clips.begin()->second.notes.begin()->second.pitch = 1;
+    _other.mixer_tracks[100].name = "bus";
+
+    reset_instrumentation_stats();
+    sparse_project _forward, _backward;
+    diff(_base, _other, _forward, _backward);
+    instrumentation_stats _stats = get_instrumentation_stats();
+#if defined(FMTDXC_INSTRUMENTATION)
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::diff).calls == 1);
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::apply).calls == 0);
+    FMTDXC_CHECK(_stats.audio_sequencers_diffed == 2 && _stats.audio_clips_diffed == 4);
+    FMTDXC_CHECK(_stats.midi_sequencers_diffed == 2 && _stats.midi_clips_diffed == 4 && _stats.midi_notes_diffed == 40);
+    FMTDXC_CHECK(_stats.mixer_tracks_diffed == 2 && _stats.collected_audio_files_diffed == 1);
+    FMTDXC_CHECK(_stats.audio_effects_diffed == 2 && _stats.mixer_routings_diffed == 2);
+    FMTDXC_CHECK(_stats.nodes_visited > 0);
+    FMTDXC_CHECK(_stats.patch_entities > 0);
+#else
+    FMTDXC_CHECK(is_zero(_stats));
+#endif
+
+    reset_instrumentation_stats();
+    project _applied = _base;
+    apply(_applied, _forward);
+    _stats = get_instrumentation_stats();
+    FMTDXC_CHECK(same(_applied, _other));
+#if defined(FMTDXC_INSTRUMENTATION)
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::apply).calls == 1);
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::diff).calls == 0);
+    FMTDXC_CHECK(_stats.midi_notes_diffed == 0);
+    // the added mixer track
+    FMTDXC_CHECK(_stats.entities_allocated >= 1);
+#else
+    FMTDXC_CHECK(is_zero(_stats));
+#endif
+}
+
+static void container_io_is_counted()
+{
+    project_container _container(make_project(151));
+    _container.commit("edit", edit_project(_container.get_project(), 152, 6));
+
+    reset_instrumentation_stats();
+    std::stringstream _stream;
+    export_container(_stream, _container, version::alpha_indexed);
+    project_container _imported;
+    version _detected;
+    import_container(_stream, _imported, _detected);
+    const instrumentation_stats _stats = get_instrumentation_stats();
+#if defined(FMTDXC_INSTRUMENTATION)
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::export_container).calls == 1);
+    FMTDXC_CHECK(get_phase(_stats, instrumentation_phase::import_container).calls == 1);
+    FMTDXC_CHECK(_stats.bytes_encoded > 0 && _stats.bytes_decoded > 0);
+#else
+    FMTDXC_CHECK(is_zero(_stats));
+#endif
+}
+
+// the sink receives what each outermost phase gathered, including the phases it ran
+static void sink_receives_outermost_phases()
+{
+    std::vector<std::pair<instrumentation_phase, instrumentation_stats>> _records;
+    set_instrumentation_sink([&_records](const instrumentation_phase phase, const instrumentation_stats& stats) {
+        _records.emplace_back(phase, stats);
+    });
+    const project _base = make_project(153);
+    project_container _container(_base);
+    _container.commit("edit", edit_project(_base, 154, 6));
+    _container.undo();
+#if defined(FMTDXC_INSTRUMENTATION)
+    FMTDXC_CHECK(_records.size() == 2);
+    FMTDXC_CHECK(_records[0].first == instrumentation_phase::commit);
+    FMTDXC_CHECK(get_phase(_records[0].second, instrumentation_phase::commit).calls == 1);
+    FMTDXC_CHECK(get_phase(_records[0].second, instrumentation_phase::diff).calls == 1);
+    FMTDXC_CHECK(_records[0].second.patch_entities > 0);
+    FMTDXC_CHECK(_records[1].first == instrumentation_phase::undo);
+    FMTDXC_CHECK(get_phase(_records[1].second, instrumentation_phase::undo).calls == 1);
+    FMTDXC_CHECK(get_phase(_records[1].second, instrumentation_phase::commit).calls == 0);
+#else
+    FMTDXC_CHECK(_records.empty());
+#endif
+
+    const std::size_t _count = _records.size();
+    set_instrumentation_sink({});
+    _container.redo();
+    FMTDXC_CHECK(_records.size() == _count);
+}
+
+int main()
+{
+    diff_and_apply_are_counted();
+    container_io_is_counted();
+    sink_receives_outermost_phases();
+    return 0;
+}
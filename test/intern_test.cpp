@@ -0,0 +1,134 @@
+#include "fmtdxc_test.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+static void handles_share_pooled_values()
+{
+    const interned<std::string> _a(std::string("pattern"));
+    const interned<std::string> _b("pattern");
+    const interned<std::string> _c(std::string("take"));
+    FMTDXC_CHECK(_a == _b && &_a.get() == &_b.get() && &_a.get() == &intern(std::string("pattern")));
+    FMTDXC_CHECK(_a != _c && _a.get() == "pattern" && _c.get() == "take");
+    FMTDXC_CHECK(_a < _c && !(_c < _a) && !(_a < _b));
+    FMTDXC_CHECK(interned<std::string>() == interned<std::string>(std::string()) && interned<std::string>().empty());
+
+    const interned<std::filesystem::path> _path(std::filesystem::path("audio/take0.wav"));
+    FMTDXC_CHECK(_path == interned<std::filesystem::path>("audio/take0.wav"));
+    FMTDXC_CHECK(_path != interned<std::filesystem::path>("audio/take1.wav"));
+    FMTDXC_CHECK(_path.get() == std::filesystem::path("audio/take0.wav"));
+}
+
+// pooled values are never released, handles stay valid once the values and handles they came from are gone
+static void handles_outlive_their_sources()
+{
+    std::map<std::uint32_t, interned<std::string>> _names;
+    const std::string* _pooled = nullptr;
+    {
+        std::vector<interned<std::string>> _handles;
+        for (int _index = 0; _index < 100; ++_index) {
+            std::string _value = "name " + std::to_string(_index % 10);
+            _handles.emplace_back(_value);
+        }
+        _pooled = &_handles[3].get();
+        for (std::uint32_t _index = 0; _index < _handles.size(); ++_index)
+            _names.emplace(_index, _handles[_index]);
+    }
+    FMTDXC_CHECK(&_names.at(13).get() == _pooled && _names.at(13).get() == "name 3");
+    FMTDXC_CHECK(_names.at(3) == _names.at(93) && _names.at(3) != _names.at(4));
+
+    // values interned from several threads are pooled once
+    std::vector<const std::string*> _found(4);
+    std::vector<std::thread> _threads;
+    for (std::size_t _index = 0; _index < _found.size(); ++_index)
+        _threads.emplace_back([&_found, _index]() {
+            for (int _repeat = 0; _repeat < 1000; ++_repeat)
+                _found[_index] = &interned<std::string>(std::string("shared ") + std::to_string(_repeat)).get();
+        });
+    for (auto& _thread : _threads)
+        _thread.join();
+    for (const std::string* _value : _found)
+        FMTDXC_CHECK(_value == &intern(std::string("shared 999")));
+}
+
+#if defined(FMTDXC_INTERN)
+
+// names and paths of projects are handles, copies of projects share them
+static void projects_hold_handles()
+{
+    const project _base = make_project(180);
+    const project _copy = _base;
+    const auto& _clip = _base.audio_sequencers.begin()->second.clips.begin()->second;
+    const auto& _copied = _copy.audio_sequencers.begin()->second.clips.begin()->second;
+    FMTDXC_CHECK(&_clip.name.get() == &_copied.name.get() && &_clip.file.get() == &_copied.file.get());
+    FMTDXC_CHECK(&_clip.name.get() == &intern(std::string("take")));
+}
+
+#endif
+
+// containers written with version::alpha_interned refer to a string table that is rebuilt when they are read,
+// and that journals appended after a load keep growing
+static void string_table_is_rebuilt_on_load()
+{
+    const std::filesystem::path _path = std::filesystem::temp_directory_path() / "fmtdxc_intern.dxc";
+    std::filesystem::remove(_path);
+    std::vector<project> _states { make_project(181) };
+    {
+        project_container _container(_states.front());
+        _states.push_back(edit_project(_states.back(), 182, 8));
+        _container.commit("edit", _states.back());
+        std::ofstream _file(_path, std::ios::binary);
+        export_container(_file, _container, version::alpha_interned);
+    }
+
+    project_container _imported;
+    version _detected;
+    import_container(_path, _imported, _detected);
+    FMTDXC_CHECK(_detected == version::alpha_interned);
+    FMTDXC_CHECK(same(_imported.get_project(), _states.back()));
+
+    // new names follow the ones read from the file, known names keep their index
+    project _next = _imported.get_project();
+    _next.audio_sequencers.begin()->second.clips.begin()->second.name = "new take";
+    _next.audio_sequencers.begin()->second.clips.begin()->second.file = "audio/new.wav";
+    std::next(_next.audio_sequencers.begin())->second.clips.begin()->second.name = "pattern";
+    _next.midi_sequencers.begin()->second.name = "audio 1";
+    _states.push_back(_next);
+    _imported.commit("rename", _next);
+    append_journal(_path, _imported);
+
+    project_container _reimported;
+    import_container(_path, _reimported, _detected);
+    FMTDXC_CHECK(_reimported.get_commit_count() == 2);
+    for (std::size_t _index = _states.size(); _index-- > 0;) {
+        _reimported.checkout(_index);
+        FMTDXC_CHECK(same(_reimported.get_project(), _states[_index]));
+    }
+
+    // exporting the imported container to a stream writes a table of its own
+    std::stringstream _stream;
+    export_container(_stream, _reimported, version::alpha_interned);
+    project_container _copied;
+    import_container(_stream, _copied, _detected);
+    FMTDXC_CHECK(same(_copied.get_project(), _states.front()));
+    _copied.checkout(2);
+    FMTDXC_CHECK(same(_copied.get_project(), _states.back()));
+    std::filesystem::remove(_path);
+}
+
+int main()
+{
+    handles_share_pooled_values();
+    handles_outlive_their_sources();
+#if defined(FMTDXC_INTERN)
+    projects_hold_handles();
+#endif
+    string_table_is_rebuilt_on_load();
+    return 0;
+}
@@ -0,0 +1,374 @@
+#include "fmtdxc_test.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+using namespace fmtdxc_test;
+
+using found = std::vector<std::tuple<std::uint32_t, std::uint32_t, std::uint32_t>>;
+
+static constexpr std::uint64_t max_tick = std::numeric_limits<std::uint64_t>::max();
+
+// entities of zero length span their start tick, ends past the last tick are clamped to it
+static bool overlaps(const std::uint64_t start, const std::uint64_t length, const std::uint64_t first, const std::uint64_t last)
+{
+    const std::uint64_t _length = std::max<std::uint64_t>(length, 1);
+    const std::uint64_t _end = _length > max_tick - start ? max_tick : start + _length;
+    return start < last && _end > first;
+}
+
+template <typename sequencers_t>
+static found scan_clips(const sequencers_t& sequencers, const std::uint64_t first, const std::uint64_t last)
+{
+    found _found;
+    for (auto& [_sequencer, _value] : sequencers)
+        for (auto& [_clip, _clip_value] : _value.clips)
+            if (overlaps(_clip_value.start_tick, _clip_value.length_ticks, first, last))
+                _found.emplace_back(_sequencer, _clip, 0);
+    return _found;
+}
+
+static found scan_notes(const project& value, const std::uint64_t first, const std::uint64_t last)
+{
+    found _found;
+    for (auto& [_sequencer, _value] : value.midi_sequencers)
+        for (auto& [_clip, _clip_value] : _value.clips) {
+            if (!overlaps(_clip_value.start_tick, _clip_value.length_ticks, first, last))
+                continue;
+            const std::uint64_t _first = first > _clip_value.start_tick ? first - _clip_value.start_tick : 0;
+            for (auto& [_note, _note_value] : _clip_value.notes)
+                if (overlaps(_note_value.start_tick, _note_value.length_ticks, _first, last - _clip_value.start_tick))
+                    _found.emplace_back(_sequencer, _clip, _note);
+        }
+    return _found;
+}
+
+// clips are returned ordered by start tick, the order of the notes found in several clips is not specified
+static found sorted(const std::vector<clip_ref>& clips, const project& value, const bool midi)
+{
+    found _found;
+    std::uint64_t _previous = 0;
+    for (const clip_ref& _clip : clips) {
+        const std::uint64_t _start = midi ? value.midi_sequencers.at(_clip.sequencer).clips.at(_clip.clip).start_tick
+                                          : value.audio_sequencers.at(_clip.sequencer).clips.at(_clip.clip).start_tick;
+        FMTDXC_CHECK(_start >= _previous);
+        _previous = _start;
+        _found.emplace_back(_clip.sequencer, _clip.clip, 0);
+    }
+    std::sort(_found.begin(), _found.end());
+    return _found;
+}
+
+static found sorted(const std::vector<note_ref>& notes)
+{
+    found _found;
+    for (const note_ref& _note : notes)
+        _found.emplace_back(_note.sequencer, _note.clip, _note.note);
+    std::sort(_found.begin(), _found.end());
+    return _found;
+}
+
+static found sorted(found value)
+{
+    std::sort(value.begin(), value.end());
+    return value;
+}
+
+// compares the queries of an index with a scan of the project it indexes
+static void check_index(const interval_index& index, const project& value)
+{
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> _ranges { { 0, max_tick }, { 0, 1 }, { 500, 500 }, { max_tick - 1, max_tick } };
+    for (std::uint64_t _first = 0; _first < 120000; _first += 7919)
+        _ranges.emplace_back(_first, _first + 1 + _first % 3000);
+    std::vector<clip_ref> _clips;
+    std::vector<note_ref> _notes;
+    for (auto [_first, _last] : _ranges) {
+        _clips.clear();
+        index.find_audio_clips(_first, _last, _clips);
+        FMTDXC_CHECK(sorted(_clips, value, false) == sorted(scan_clips(value.audio_sequencers, _first, _last)));
+        _clips.clear();
+        index.find_midi_clips(_first, _last, _clips);
+        FMTDXC_CHECK(sorted(_clips, value, true) == sorted(scan_clips(value.midi_sequencers, _first, _last)));
+        _notes.clear();
+        index.find_midi_notes(_first, _last, _notes);
+        FMTDXC_CHECK(sorted(_notes) == sorted(scan_notes(value, _first, _last)));
+    }
+}
+
+// moves and resizes clips and notes, and adds some of them
+static project move_entities(const project& value, const std::uint32_t seed)
+{
+    std::mt19937 _random(seed);
+    project _project = value;
+    for (int _edit = 0; _edit < 12; ++_edit) {
+        auto _midi = std::next(_project.midi_sequencers.begin(), _random() % _project.midi_sequencers.size());
+        auto _midi_clip = std::next(_midi->second.clips.begin(), _random() % _midi->second.clips.size());
+        switch (_random() % 5) {
+        case 0: {
+            auto _audio = std::next(_project.audio_sequencers.begin(), _random() % _project.audio_sequencers.size());
+            auto _clip = std::next(_audio->second.clips.begin(), _random() % _audio->second.clips.size());
+            _clip->second.start_tick = _random() % 110000;
+            _clip->second.length_ticks = _random() % 2 ? 0 : _random() % 10000;
+            break;
+        }
+        case 1:
+            _midi_clip->second.start_tick = _random() % 110000;
+            _midi_clip->second.length_ticks = _random() % 10000;
+            break;
+        case 2: {
+            auto _note = std::next(_midi_clip->second.notes.begin(), _random() % _midi_clip->second.notes.size());
+            _note->second.start_tick = _random() % 12000;
+            _note->second.length_ticks = _random() % 480;
+            break;
+        }
+        case 3: {
+            auto& _note = _midi_clip->second.notes[1 + 2 * (_random() % 100)];
+            _note.start_tick = _random() % 12000;
+            _note.length_ticks = 1 + _random() % 480;
+            break;
+        }
+        default: {
+            auto& _clip = _midi->second.clips[1 + 5 * (_random() % 10)];
+            _clip.start_tick = _random() % 110000;
+            _clip.length_ticks = 1 + _random() % 10000;
+            _clip.notes[0].start_tick = _random() % 10000;
+            _clip.notes[0].length_ticks = 1 + _random() % 480;
+            break;
+        }
+        }
+    }
+    return _project;
+}
+
+static void queries_match_scan()
+{
+    const project _base = make_project(220);
+    const interval_index _index(_base);
+    check_index(_index, _base);
+
+    interval_index _moved;
+    _moved = interval_index(_base);
+    check_index(_moved, _base);
+    _moved.build(move_entities(_base, 221));
+    _moved.build(_base);
+    check_index(_moved, _base);
+}
+
+// indexes updated by applying patches match the ones built from the patched projects
+static void apply_updates_index()
+{
+    project _value = make_project(222);
+    interval_index _index(_value);
+    for (std::uint32_t _step = 0; _step < 10; ++_step) {
+        const project _next = move_entities(_value, 223 + _step);
+        sparse_project _forward, _backward;
+        diff(_value, _next, _forward, _backward);
+        apply(_value, _forward, _index);
+        FMTDXC_CHECK(same(_value, _next));
+        check_index(_index, _value);
+        if (_step % 3 == 0) {
+            // added entities are kept by backward patches
+            apply(_value, _backward, _index);
+            check_index(_index, _value);
+            apply(_value, _forward, _index);
+            check_index(_index, _value);
+        }
+    }
+
+    // entities named in a patch that the project no longer holds are removed
+    sparse_project _deleted;
+    auto _midi = _value.midi_sequencers.begin();
+    const std::uint32_t _clip = _midi->second.clips.begin()->first;
+    const std::uint32_t _note = std::next(_midi->second.clips.begin())->second.notes.begin()->first;
+    _deleted.midi_sequencers[_midi->first].clips[_clip];
+    _deleted.midi_sequencers[_midi->first].clips[std::next(_midi->second.clips.begin())->first].notes[_note];
+    _midi->second.clips.erase(_clip);
+    _midi->second.clips.begin()->second.notes.erase(_note);
+    auto _audio = _value.audio_sequencers.begin();
+    for (auto& [_id, _clip_value] : _audio->second.clips)
+        _deleted.audio_sequencers[_audio->first].clips[_id];
+    _value.audio_sequencers.erase(_audio);
+    _index.update(_value, _deleted);
+    check_index(_index, _value);
+}
+
+static void spans_are_clamped()
+{
+    project _value;
+    auto& _audio = _value.audio_sequencers[0].clips;
+    _audio[0].start_tick = 500;
+    _audio[0].length_ticks = 0;
+    _audio[1].start_tick = max_tick - 10;
+    _audio[1].length_ticks = 100;
+    _audio[2].start_tick = max_tick;
+    _audio[2].length_ticks = 0;
+    auto& _clip = _value.midi_sequencers[0].clips[0];
+    _clip.start_tick = 1000;
+    _clip.length_ticks = 100;
+    _clip.notes[0].start_tick = 10;
+    _clip.notes[0].length_ticks = 5;
+    _clip.notes[1].start_tick = 50;
+    _clip.notes[1].length_ticks = 0;
+    auto& _late = _value.midi_sequencers[0].clips[1];
+    _late.start_tick = max_tick - 1;
+    _late.length_ticks = 10;
+    _late.notes[0].start_tick = 0;
+    _late.notes[0].length_ticks = max_tick;
+    const interval_index _index(_value);
+    check_index(_index, _value);
+
+    std::vector<clip_ref> _clips;
+    _index.find_audio_clips(500, 501, _clips);
+    FMTDXC_CHECK(_clips.size() == 1 && _clips[0].clip == 0);
+    _clips.clear();
+    _index.find_audio_clips(0, 500, _clips);
+    _index.find_audio_clips(501, max_tick - 10, _clips);
+    FMTDXC_CHECK(_clips.empty());
+    _index.find_audio_clips(max_tick - 1, max_tick, _clips);
+    FMTDXC_CHECK(_clips.size() == 1 && _clips[0].clip == 1);
+
+    // notes are found in ticks relative to their clip
+    std::vector<note_ref> _notes;
+    _index.find_midi_notes(1010, 1011, _notes);
+    FMTDXC_CHECK(_notes.size() == 1 && _notes[0].clip == 0 && _notes[0].note == 0);
+    _notes.clear();
+    _index.find_midi_notes(0, 1010, _notes);
+    _index.find_midi_notes(1015, 1050, _notes);
+    _index.find_midi_notes(1051, 2000, _notes);
+    FMTDXC_CHECK(_notes.empty());
+    _index.find_midi_notes(1050, 1051, _notes);
+    FMTDXC_CHECK(_notes.size() == 1 && _notes[0].note == 1);
+    _notes.clear();
+    _index.find_midi_notes(max_tick - 1, max_tick, _notes);
+    FMTDXC_CHECK(_notes.size() == 1 && _notes[0].clip == 1 && _notes[0].note == 0);
+}
+
+static void check_container(const project_container& container)
+{
+    FMTDXC_CHECK(container.get_interval_index() != nullptr);
+    check_index(*container.get_interval_index(), container.get_project());
+}
+
+// the index of a container follows commits that move and delete entities, undo, redo and checkouts
+static void container_index_follows_history(const backward_mode mode)
+{
+    project_container _container(make_project(230));
+    _container.set_backward_mode(mode);
+    _container.set_checkpoint_interval(3);
+    FMTDXC_CHECK(_container.get_interval_index() == nullptr);
+    _container.set_interval_index(true);
+    check_container(_container);
+    for (std::uint32_t _step = 0; _step < 10; ++_step) {
+        project _next = move_entities(_container.get_project(), 231 + _step);
+        if (_step % 4 == 1) {
+            auto& _clips = std::next(_next.midi_sequencers.begin(), _step / 4)->second.clips;
+            _clips.erase(_clips.begin());
+            auto& _notes = _clips.begin()->second.notes;
+            if (_notes.size() > 1)
+                _notes.erase(_notes.begin());
+            _next.audio_sequencers.erase(_next.audio_sequencers.begin());
+        }
+        _container.commit("move", _next);
+        check_container(_container);
+    }
+    for (int _index = 0; _index < 4; ++_index) {
+        _container.undo();
+        check_container(_container);
+    }
+    _container.redo();
+    check_container(_container);
+    for (const std::size_t _index : { 0, 10, 1, 8, 4, 9, 2 }) {
+        _container.checkout(_index);
+        check_container(_container);
+    }
+    _container.commit("branch", move_entities(_container.get_project(), 250));
+    check_container(_container);
+    _container.set_interval_index(false);
+    FMTDXC_CHECK(_container.get_interval_index() == nullptr);
+}
+
+// edit sessions update the index of their container when they are committed or discarded
+static void sessions_update_index()
+{
+    const project _base = make_project(240);
+    project_container _container(_base);
+    _container.set_interval_index(true);
+    const std::uint32_t _sequencer = _base.midi_sequencers.begin()->first;
+    const auto& _clip = *_base.midi_sequencers.begin()->second.clips.begin();
+    const std::uint32_t _note = _clip.second.notes.begin()->first;
+    const std::uint32_t _audio = _base.audio_sequencers.begin()->first;
+    const std::uint32_t _audio_clip = _base.audio_sequencers.begin()->second.clips.begin()->first;
+    project::midi_note _added;
+    _added.start_tick = 20000;
+    _added.length_ticks = 0;
+    _added.pitch = 60;
+    _added.velocity = 1.0f;
+    _added.mpe = {};
+    for (const bool _committed : { false, true }) {
+        edit_session _session(_container);
+        _session.set_midi_clip_start(_sequencer, _clip.first, 50);
+        _session.set_midi_clip_length(_sequencer, _clip.first, 0);
+        _session.set_midi_note_start(_sequencer, _clip.first, _note, 7000);
+        _session.set_midi_note_length(_sequencer, _clip.first, _note, 0);
+        _session.set_audio_clip_start(_audio, _audio_clip, 90000);
+        _session.set_audio_clip_length(_audio, _audio_clip, 20000);
+        _session.add_midi_note(_sequencer, _clip.first, 100001, _added);
+        if (_committed)
+            _session.commit("session");
+        else
+            _session.discard();
+        check_container(_container);
+    }
+    FMTDXC_CHECK(_container.get_commit_count() == 1);
+    _container.undo();
+    check_container(_container);
+    _container.redo();
+    check_container(_container);
+}
+
+// operations shift the notes they select without naming them
+static void operations_update_index()
+{
+    project _value = make_project(260);
+    interval_index _index(_value);
+    const std::uint32_t _sequencer = _value.midi_sequencers.begin()->first;
+    const std::uint32_t _clip = _value.midi_sequencers.begin()->second.clips.begin()->first;
+    sparse_project _forward;
+    _forward.midi_sequencers[_sequencer].clips[_clip].operations.push_back({ 10, 80, 30000, 0 });
+    _forward.midi_sequencers[_sequencer].clips[_clip].operations.push_back({ 0, 20, 12, 5 });
+    apply(_value, _forward, _index);
+    check_index(_index, _value);
+
+    project_container _container(make_project(261));
+    _container.set_interval_index(true);
+    {
+        edit_session _session(_container);
+        _session.shift_midi_notes(_sequencer, _clip, 0, 5000, 20000);
+        _session.transpose_midi_notes(_sequencer, _clip, 0, 100000, 1);
+        _session.commit("shift");
+    }
+    check_container(_container);
+    _container.undo();
+    check_container(_container);
+    _container.redo();
+    check_container(_container);
+    {
+        edit_session _session(_container);
+        _session.shift_midi_notes(_sequencer, _clip, 20000, 30000, -15000);
+    }
+    check_container(_container);
+}
+
+int main()
+{
+    queries_match_scan();
+    apply_updates_index();
+    spans_are_clamped();
+    container_index_follows_history(backward_mode::full);
+    container_index_follows_history(backward_mode::overwritten);
+    sessions_update_index();
+    operations_update_index();
+    return 0;
+}
@@ -0,0 +1,159 @@
+#include "fmtdxc_test.hpp"
+
+#include <vector>
+
+using namespace fmtdxc_test;
+
+static void disjoint_changes_combine()
+{
+    const project _base = make_project(100);
+    project _ours = _base, _theirs = _base;
+    auto& _our_clip = _ours.midi_sequencers.begin()->second.clips.begin()->second;
+    _our_clip.name = "ours";
+    _our_clip.notes.begin()->second.pitch = 1;
+    auto& _their_clip = _theirs.midi_sequencers.begin()->second.clips.begin()->second;
+    _their_clip.start_tick = 7;
+    _their_clip.notes.begin()->second.velocity = 0.25f;
+    _theirs.audio_sequencers[1000].name = "new";
+    _theirs.audio_sequencers[1000].clips[3].name = "take";
+    // the same change on both sides is not a conflict
+    _ours.mixer_tracks.begin()->second.pan = 0.5;
+    _theirs.mixer_tracks.begin()->second.pan = 0.5;
+
+    sparse_project _our_patch, _their_patch, _merged;
+    diff(_base, _ours, _our_patch);
+    diff(_base, _theirs, _their_patch);
+    std::vector<merge_conflict> _conflicts;
+    merge(_base, _our_patch, _their_patch, _merged, _conflicts);
+    FMTDXC_CHECK(_conflicts.empty());
+
+    project _expected = _ours;
+    auto& _clip = _expected.midi_sequencers.begin()->second.clips.begin()->second;
+    _clip.start_tick = 7;
+    _clip.notes.begin()->second.velocity = 0.25f;
+    _expected.audio_sequencers[1000] = _theirs.audio_sequencers.at(1000);
+    project _result = _base;
+    apply(_result, _merged);
+    FMTDXC_CHECK(same(_result, _expected));
+}
+
+static void conflicts_take_ours()
+{
+    const project _base = make_project(101);
+    project _ours = _base, _theirs = _base;
+    const std::uint32_t _track = std::prev(_ours.mixer_tracks.end())->first;
+    _ours.mixer_tracks.at(_track).db = -3;
+    _theirs.mixer_tracks.at(_track).db = -6;
+    const std::uint32_t _sequencer = _ours.midi_sequencers.begin()->first;
+    const std::uint32_t _clip = _ours.midi_sequencers.begin()->second.clips.begin()->first;
+    const std::uint32_t _note = std::next(_ours.midi_sequencers.begin()->second.clips.begin()->second.notes.begin())->first;
+    _ours.midi_sequencers.at(_sequencer).clips.at(_clip).notes.at(_note).start_tick = 1;
+    _theirs.midi_sequencers.at(_sequencer).clips.at(_clip).notes.at(_note).start_tick = 2;
+    _theirs.name = "renamed";
+
+    sparse_project _our_patch, _their_patch, _merged;
+    diff(_base, _ours, _our_patch);
+    diff(_base, _theirs, _their_patch);
+    // a value equal to the base is not a change
+    _our_patch.name = _base.name;
+    std::vector<merge_conflict> _conflicts;
+    merge(_base, _our_patch, _their_patch, _merged, _conflicts);
+
+    FMTDXC_CHECK(_conflicts.size() == 2);
+    FMTDXC_CHECK(_conflicts[0].entity == merge_entity::midi_note);
+    FMTDXC_CHECK((_conflicts[0].ids == std::vector<std::uint32_t> { _sequencer, _clip, _note }));
+    FMTDXC_CHECK(_conflicts[0].field == "start_tick");
+    FMTDXC_CHECK(_conflicts[1].entity == merge_entity::mixer_track);
+    FMTDXC_CHECK((_conflicts[1].ids == std::vector<std::uint32_t> { _track }));
+    FMTDXC_CHECK(_conflicts[1].field == "db");
+
+    project _result = _base;
+    apply(_result, _merged);
+    FMTDXC_CHECK(_result.mixer_tracks.at(_track).db == -3);
+    FMTDXC_CHECK(_result.midi_sequencers.at(_sequencer).clips.at(_clip).notes.at(_note).start_tick == 1u);
+    FMTDXC_CHECK(_result.name == "renamed");
+}
+
+static void merge_with_empty_side()
+{
+    const project _base = make_project(102);
+    const project _ours = edit_project(_base, 103, 20);
+    sparse_project _our_patch, _their_patch, _merged;
+    diff(_base, _ours, _our_patch);
+    std::vector<merge_conflict> _conflicts;
+    merge(_base, _our_patch, _their_patch, _merged, _conflicts);
+    FMTDXC_CHECK(_conflicts.empty());
+    project _result = _base;
+    apply(_result, _merged);
+    FMTDXC_CHECK(same(_result, _ours));
+}
+
+// entries of entities that only one side changed are checked against base like the others
+static void one_sided_entries_are_checked_against_base()
+{
+    const project _base = make_project(104);
+    const auto& _sequencer = *_base.midi_sequencers.begin();
+    const auto& _clip = *_sequencer.second.clips.begin();
+    const auto& _restated = *_clip.second.notes.begin();
+    const auto& _changed = *std::next(_clip.second.notes.begin());
+    const auto& _track = *_base.mixer_tracks.begin();
+
+    sparse_project _our_patch, _their_patch, _merged;
+    auto& _notes = _our_patch.midi_sequencers[_sequencer.first].clips[_clip.first].notes;
+    _notes[_restated.first].pitch = _restated.second.pitch;
+    _notes[_changed.first].pitch = static_cast<std::uint16_t>(_changed.second.pitch + 1);
+    _notes[_changed.first].velocity = _changed.second.velocity;
+    _their_patch.mixer_tracks[_track.first].db = _track.second.db;
+    _their_patch.audio_sequencers[1000].clips[3].name = "take";
+    std::vector<merge_conflict> _conflicts;
+    merge(_base, _our_patch, _their_patch, _merged, _conflicts);
+    FMTDXC_CHECK(_conflicts.empty());
+
+    const auto& _merged_notes = _merged.midi_sequencers.at(_sequencer.first).clips.at(_clip.first).notes;
+    FMTDXC_CHECK(_merged_notes.size() == 1 && _merged_notes.count(_changed.first) == 1);
+    FMTDXC_CHECK(_merged_notes.at(_changed.first).pitch && !_merged_notes.at(_changed.first).velocity);
+    FMTDXC_CHECK(_merged.mixer_tracks.empty());
+    // entities that base does not hold are taken as they are
+    FMTDXC_CHECK(_merged.audio_sequencers.at(1000).clips.at(3).name == std::string("take"));
+
+    project _result = _base;
+    apply(_result, _merged);
+    FMTDXC_CHECK(_result.midi_sequencers.at(_sequencer.first).clips.at(_clip.first).notes.at(_changed.first).pitch == _changed.second.pitch + 1);
+    FMTDXC_CHECK(_result.audio_sequencers.count(1000) == 1);
+}
+
+// routings of mixer tracks are merged field by field and conflict like other entities
+static void routing_conflicts_are_reported()
+{
+    const project _base = make_project(104);
+    project _ours = _base, _theirs = _base;
+    const std::uint32_t _track = _base.mixer_tracks.begin()->first;
+    _ours.mixer_tracks.at(_track).routings.at(1).db = -3;
+    _theirs.mixer_tracks.at(_track).routings.at(1).db = -9;
+    _theirs.mixer_tracks.at(_track).effects.at(0).name = "limiter";
+
+    sparse_project _our_patch, _their_patch, _merged;
+    diff(_base, _ours, _our_patch);
+    diff(_base, _theirs, _their_patch);
+    std::vector<merge_conflict> _conflicts;
+    merge(_base, _our_patch, _their_patch, _merged, _conflicts);
+    FMTDXC_CHECK(_conflicts.size() == 1);
+    FMTDXC_CHECK(_conflicts[0].entity == merge_entity::mixer_routing);
+    FMTDXC_CHECK((_conflicts[0].ids == std::vector<std::uint32_t> { _track, 1 }));
+    FMTDXC_CHECK(_conflicts[0].field == "db");
+
+    project _result = _base;
+    apply(_result, _merged);
+    FMTDXC_CHECK(_result.mixer_tracks.at(_track).routings.at(1).db == -3);
+    FMTDXC_CHECK(_result.mixer_tracks.at(_track).effects.at(0).name == "limiter");
+}
+
+int main()
+{
+    disjoint_changes_combine();
+    conflicts_take_ours();
+    merge_with_empty_side();
+    one_sided_entries_are_checked_against_base();
+    routing_conflicts_are_reported();
+    return 0;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <ios>
+#include <streambuf>
+
+// counts the bytes written through it for the throughput report
+struct counting_streambuf : std::streambuf {
+    counting_streambuf(std::streambuf* target)
+        : _target(target)
+    {
+    }
+
+    std::size_t get_count() const { return _count; }
+
+protected:
+    int_type overflow(int_type value) override
+    {
+        if (traits_type::eq_int_type(value, traits_type::eof()))
+            return traits_type::not_eof(value);
+        ++_count;
+        return _target->sputc(traits_type::to_char_type(value));
+    }
+
+    std::streamsize xsputn(const char* data, std::streamsize size) override
+    {
+        const std::streamsize _written = _target->sputn(data, size);
+        _count += static_cast<std::size_t>(_written);
+        return _written;
+    }
+
+    int sync() override { return _target->pubsync(); }
+
+    // files stay seekable so that containers record their snapshot size
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override { return _target->pubseekoff(offset, direction, which); }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override { return _target->pubseekpos(position, which); }
+
+private:
+    std::streambuf* _target;
+    std::size_t _count = 0;
+};
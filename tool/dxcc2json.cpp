@@ -1,25 +1,130 @@
+#include "counting_streambuf.hpp"
+
 #include <fmtdxc/fmtdxc.hpp>
 
+#include <chrono>
 #include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#endif
+
+static int usage()
+{
+    std::cerr << "Usage: dxcc2json [--project-only | --metadata-only] [--commits FIRST:LAST] [--report] input.dxcc|- [output.json|-]\n"
+              << "  --project-only   writes the project without its commits\n"
+              << "  --metadata-only  writes the message and timestamp of the commits without the project and patches\n"
+              << "  --commits        writes the commits from FIRST up to LAST excluded\n"
+              << "  --report         prints the commit count and the throughput to stderr\n"
+              << "  -                reads from stdin or writes to stdout\n";
+    return 1;
+}
 
 int main(int argc, char* argv[])
 {
-    if (argc < 2) {
-        std::cerr << "Usage: drag a .dxcc file onto the executable\n";
-        return 1;
-    }
-    std::filesystem::path _input_path(argv[1]);
-    if (!std::filesystem::exists(_input_path)) {
-        std::cerr << "Error: File does not exist\n";
-        return 2;
+    bool _project_only = false;
+    bool _metadata_only = false;
+    bool _report = false;
+    std::optional<std::pair<std::size_t, std::size_t>> _range;
+    std::vector<std::string> _paths;
+    for (int _arg = 1; _arg < argc; ++_arg) {
+        const std::string _option = argv[_arg];
+        if (_option == "--project-only") {
+            _project_only = true;
+        } else if (_option == "--metadata-only") {
+            _metadata_only = true;
+        } else if (_option == "--report") {
+            _report = true;
+        } else if (_option == "--commits" && _arg + 1 < argc) {
+            const std::string _value = argv[++_arg];
+            const std::size_t _colon = _value.find(':');
+            if (_colon == std::string::npos)
+                return usage();
+            try {
+                _range.emplace(std::stoull(_value.substr(0, _colon)), std::stoull(_value.substr(_colon + 1)));
+            } catch (const std::exception&) {
+                return usage();
+            }
+        } else if (_option.size() > 1 && _option[0] == '-') {
+            return usage();
+        } else {
+            _paths.push_back(_option);
+        }
     }
-    if (_input_path.extension() != ".dxcc") {
-        std::cerr << "Error: File is not an dawxchange project container\n";
-        return 3;
+    if (_paths.empty() || _paths.size() > 2 || (_project_only && (_metadata_only || _range)))
+        return usage();
+
+    const bool _from_stdin = _paths[0] == "-";
+    std::filesystem::path _input_path(_paths[0]);
+    if (!_from_stdin) {
+        if (!std::filesystem::exists(_input_path)) {
+            std::cerr << "Error: File does not exist\n";
+            return 2;
+        }
+        if (_input_path.extension() != ".dxcc") {
+            std::cerr << "Error: File is not an dawxchange project container\n";
+            return 3;
+        }
     }
-    std::ifstream _input_stream(_input_path, std::ios::binary);
-    
-    // TODO
+    // a single file argument converts next to it, a piped input converts to stdout
+    std::string _output_name = _paths.size() == 2 ? _paths[1] : _from_stdin ? "-" : std::filesystem::path(_input_path).replace_extension(".json").string();
+
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    try {
+        const auto _start = std::chrono::steady_clock::now();
+        std::unique_ptr<fmtdxc::container_reader> _reader = _from_stdin ? std::make_unique<fmtdxc::container_reader>(std::cin) : std::make_unique<fmtdxc::container_reader>(_input_path);
+        std::ofstream _output_file;
+        if (_output_name != "-") {
+            _output_file.open(_output_name, std::ios::binary | std::ios::trunc);
+            if (!_output_file) {
+                std::cerr << "Error: Failed to open " << _output_name << "\n";
+                return 2;
+            }
+        }
+        counting_streambuf _counter(_output_name == "-" ? std::cout.rdbuf() : _output_file.rdbuf());
+        std::ostream _output(&_counter);
+
+        fmtdxc::container_info _info;
+        _info.ver = _reader->get_version();
+        _info.applied = _reader->get_applied_count();
+        _info.commit_count = _reader->get_commit_count();
+        _info.first_commit = _range ? std::min(_range->first, _info.commit_count) : 0;
+        _info.last_commit = _project_only ? _info.first_commit : _range ? std::min(std::max(_range->second, _info.first_commit), _info.commit_count) : _info.commit_count;
+        _info.has_project = !_metadata_only;
+        _info.has_patches = !_metadata_only;
+        fmtdxc::export_json_line(_output, _info);
+        if (_info.has_project)
+            fmtdxc::export_json_line(_output, _reader->get_project());
 
+        // commits before the range are skipped without decoding their patches when the container allows it
+        std::size_t _converted = 0;
+        while (_reader->get_commit_index() < _info.last_commit) {
+            const bool _selected = _reader->get_commit_index() >= _info.first_commit;
+            std::shared_ptr<const fmtdxc::project_commit> _commit = _reader->read_commit(_selected && _info.has_patches);
+            if (_selected) {
+                fmtdxc::export_json_line(_output, *_commit);
+                ++_converted;
+            }
+        }
+        _output.flush();
+        if (!_output) {
+            std::cerr << "Error: Failed to write " << _output_name << "\n";
+            return 4;
+        }
+
+        if (_report) {
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            std::cerr << "converted " << _converted << " commits, " << _counter.get_count() << " bytes in " << _seconds << " s ("
+                      << (_seconds > 0 ? _counter.get_count() / _seconds / (1024 * 1024) : 0) << " MB/s)\n";
+        }
+    } catch (const std::exception& _exception) {
+        std::cerr << "Error: " << _exception.what() << "\n";
+        return 4;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -1,25 +1,139 @@
+#include "counting_streambuf.hpp"
+
 #include <fmtdxc/fmtdxc.hpp>
 
+#include <chrono>
 #include <fstream>
+#include <string>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <stdio.h>
+#endif
+
+static int usage()
+{
+    std::cerr << "Usage: json2dxcc [--version alpha|alpha_indexed|alpha_columnar|alpha_interned] [--report] input.json|- [output.dxcc|-]\n"
+              << "  --version  writes the container with this version instead of the one it was converted from\n"
+              << "  --report   prints the commit count and the throughput to stderr\n"
+              << "  -          reads from stdin or writes to stdout\n";
+    return 1;
+}
+
+static std::optional<fmtdxc::version> parse_version(const std::string& name)
+{
+    if (name == "alpha")
+        return fmtdxc::version::alpha;
+    if (name == "alpha_indexed")
+        return fmtdxc::version::alpha_indexed;
+    if (name == "alpha_columnar")
+        return fmtdxc::version::alpha_columnar;
+    if (name == "alpha_interned")
+        return fmtdxc::version::alpha_interned;
+    return std::nullopt;
+}
 
 int main(int argc, char* argv[])
 {
-    if (argc < 2) {
-        std::cerr << "Usage: drag a .json file onto the executable\n";
-        return 1;
-    }
-    std::filesystem::path _input_path(argv[1]);
-    if (!std::filesystem::exists(_input_path)) {
-        std::cerr << "Error: File does not exist\n";
-        return 2;
+    bool _report = false;
+    std::optional<fmtdxc::version> _version;
+    std::vector<std::string> _paths;
+    for (int _arg = 1; _arg < argc; ++_arg) {
+        const std::string _option = argv[_arg];
+        if (_option == "--report") {
+            _report = true;
+        } else if (_option == "--version" && _arg + 1 < argc) {
+            _version = parse_version(argv[++_arg]);
+            if (!_version)
+                return usage();
+        } else if (_option.size() > 1 && _option[0] == '-') {
+            return usage();
+        } else {
+            _paths.push_back(_option);
+        }
     }
-    if (_input_path.extension() != ".json") {
-        std::cerr << "Error: File is not json\n";
-        return 3;
+    if (_paths.empty() || _paths.size() > 2)
+        return usage();
+
+    const bool _from_stdin = _paths[0] == "-";
+    std::filesystem::path _input_path(_paths[0]);
+    if (!_from_stdin) {
+        if (!std::filesystem::exists(_input_path)) {
+            std::cerr << "Error: File does not exist\n";
+            return 2;
+        }
+        if (_input_path.extension() != ".json") {
+            std::cerr << "Error: File is not json\n";
+            return 3;
+        }
     }
-    std::ifstream _input_stream(_input_path, std::ios::binary);
-    
-    // TODO
+    // a single file argument converts next to it, a piped input converts to stdout
+    std::string _output_name = _paths.size() == 2 ? _paths[1] : _from_stdin ? "-" : std::filesystem::path(_input_path).replace_extension(".dxcc").string();
+
+#if defined(_WIN32)
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    try {
+        const auto _start = std::chrono::steady_clock::now();
+        std::ifstream _input_file;
+        if (!_from_stdin) {
+            _input_file.open(_input_path, std::ios::binary);
+            if (!_input_file) {
+                std::cerr << "Error: Failed to open " << _input_path.string() << "\n";
+                return 2;
+            }
+        }
+        std::istream& _input = _from_stdin ? std::cin : _input_file;
+
+        // only complete conversions can be written back, a container needs its project and every commit
+        fmtdxc::json_line _line;
+        if (!fmtdxc::import_json_line(_input, _line) || !std::holds_alternative<fmtdxc::container_info>(_line)) {
+            std::cerr << "Error: Missing container info line\n";
+            return 4;
+        }
+        const fmtdxc::container_info _info = std::get<fmtdxc::container_info>(_line);
+        if (!_info.has_project || !_info.has_patches || _info.first_commit != 0 || _info.last_commit != _info.commit_count) {
+            std::cerr << "Error: File holds a partial conversion\n";
+            return 4;
+        }
+        if (!fmtdxc::import_json_line(_input, _line) || !std::holds_alternative<fmtdxc::project>(_line)) {
+            std::cerr << "Error: Missing project line\n";
+            return 4;
+        }
 
+        std::ofstream _output_file;
+        if (_output_name != "-") {
+            _output_file.open(_output_name, std::ios::binary | std::ios::trunc);
+            if (!_output_file) {
+                std::cerr << "Error: Failed to open " << _output_name << "\n";
+                return 2;
+            }
+        }
+        counting_streambuf _counter(_output_name == "-" ? std::cout.rdbuf() : _output_file.rdbuf());
+        std::ostream _output(&_counter);
+        fmtdxc::container_writer _writer(_output, _version.value_or(_info.ver), std::get<fmtdxc::project>(_line), _info.applied, _info.commit_count);
+        _line = fmtdxc::container_info {};
+
+        std::size_t _converted = 0;
+        while (fmtdxc::import_json_line(_input, _line)) {
+            if (!std::holds_alternative<fmtdxc::project_commit>(_line)) {
+                std::cerr << "Error: Expected a commit line\n";
+                return 4;
+            }
+            _writer.write_commit(std::get<fmtdxc::project_commit>(_line));
+            ++_converted;
+        }
+        _writer.finish();
+
+        if (_report) {
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            std::cerr << "converted " << _converted << " commits, " << _counter.get_count() << " bytes in " << _seconds << " s ("
+                      << (_seconds > 0 ? _counter.get_count() / _seconds / (1024 * 1024) : 0) << " MB/s)\n";
+        }
+    } catch (const std::exception& _exception) {
+        std::cerr << "Error: " << _exception.what() << "\n";
+        return 4;
+    }
     return 0;
-}
\ No newline at end of file
+}